@@ -5,10 +5,14 @@
 #include <Framework/IRenderer.h>
 #include <Framework/GUI.h>
 #include <Framework/Input.h>
+#include <Framework/FrameQueue.h>
 
 #include <Windows.h>
 
+#include <functional>
+#include <future>
 #include <map>
+#include <string>
 
 class Application
 {
@@ -27,10 +31,11 @@ public:
 	~Application();
 
 	//public methods
-	void RenderFrame() const;
+	void RenderFrame(FramePacket & packet) const;
 	int Run();
 
-	std::string OpenFile(char const * filter);
+	//the dialog runs on its own thread, the chosen file is handed to the render thread, only one dialog is open at a time
+	void OpenFile(char const * filter, std::function<void(std::string const &)> const & opened);
 
 	float dt() const;
 
@@ -49,6 +54,8 @@ private:
 	static std::map<HWND, Application*> s_applicationDictionary;
 
 	LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	void RenderLoop(std::promise<bool> & initialized);
+	void CompleteOpenFileRequest();
 
 	Window * m_window;
 	Scene * m_scene;
@@ -62,4 +69,11 @@ private:
 	int m_width;
 	int m_height;
 
+	//the window thread prepares the frames the render thread submits, the scene is edited on the render thread and gathered from its snapshots
+	FrameQueue m_frames;
+
+	//render thread only
+	std::future<std::string> m_openFileRequest;
+	std::function<void(std::string const &)> m_fileOpened;
+
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class Program;
+
+//draw packets are recorded on any thread without touching the graphics api and replayed in order by the thread owning the context
+class CommandBuffer
+{
+public:
+
+	typedef enum CommandKind
+	{
+		USE_PROGRAM = 0,
+		BIND_VERTEX_ARRAY = 1,
+		BIND_TEXTURE = 2,
+		SET_UNIFORM_INT = 3,
+		SET_UNIFORM_BOOL = 4,
+		SET_UNIFORM_FLOAT = 5,
+		SET_UNIFORM_VEC3 = 6,
+		DRAW_INDEXED = 7
+	} CommandKindType;
+
+	//constructors/destructor
+	CommandBuffer();
+	~CommandBuffer();
+
+	//recording, uniform names have to outlive the buffer
+	void Clear();
+	void UseProgram(Program const & program);
+	void BindVertexArray(unsigned int const & vao);
+	void BindTexture(unsigned int const & unit, unsigned int const & texture);
+	void SetUniform(char const * name, int const & value);
+	void SetUniform(char const * name, bool const & value);
+	void SetUniform(char const * name, float const & value);
+	void SetUniform(char const * name, glm::vec3 const & vector);
+	void DrawIndexed(unsigned int const & indexCount, unsigned int const & firstIndex, unsigned int const & instanceCount);
+
+	//replaying
+	void Replay() const;
+
+	//statistical information
+	unsigned int GetCommandsCount() const;
+	unsigned int const & GetDrawsCount() const;
+	unsigned int const & GetTrianglesCount() const;
+
+private:
+
+	//uniforms are set on the program of the last USE_PROGRAM command
+	struct Command
+	{
+		Command(CommandKindType const & commandKind, char const * uniformName) : kind(commandKind), name(uniformName), arguments() {}
+
+		CommandKindType kind;
+		char const * name;
+		union
+		{
+			Program const * program;
+			int integer;
+			bool boolean;
+			float scalar;
+			float vector[3];
+			unsigned int arguments[3];
+		};
+	};
+
+	std::vector<Command> m_commands;
+	unsigned int m_drawsCount;
+	unsigned int m_trianglesCount;
+
+};
@@ -2,9 +2,37 @@
 
 #define DEFAULT_WINDOW_WIDTH			800
 #define DEFAULT_WINDOW_HEIGHT			600
+#define FRAME_QUEUE_SIZE				2
 
 #define DEFAULT_SHADOW_WIDTH			1024
 #define DEFAULT_SHADOW_HEIGHT			1024
+#define SHADOW_ATLAS_SIZE				4096
+#define MIN_SHADOW_TILE_SIZE			128
+#define SHADOW_CASCADE_COUNT			4
+//the splits travel in a vec4 and the uniform names and the shader are written for four cascades
+static_assert(SHADOW_CASCADE_COUNT == 4, "the cascade splits are packed in a vec4, GlobalLightPass.frag and the cascade uniform names assume 4 cascades");
+#define MAX_SHADOWED_GLOBAL_LIGHTS		8
+#define MAX_SHADOW_BLUR_RADIUS			16
+#define LOCAL_SHADOW_TILE_SIZE			256
+#define MIN_LOCAL_SHADOW_TILE_SIZE		64
+#define MAX_LOCAL_SHADOW_FACE_BUDGET	24
+#define MAX_SHADOW_VIEWS				(MAX_SHADOWED_GLOBAL_LIGHTS * SHADOW_CASCADE_COUNT + MAX_LOCAL_SHADOW_FACE_BUDGET)
+
+#define MAX_MESH_LEVELS_OF_DETAIL		5
+#define MIN_LOD_TRIANGLE_COUNT			64
+
+#define JOB_CHUNKS_PER_WORKER			4
+#define TRAVERSAL_SUBTREES_PER_CHUNK	64
+#define INSTANCE_GROUPS_PER_CHUNK		16
+#define SHADOW_CASTERS_PER_CHUNK		256
+#define CASTER_BATCHES_PER_CHUNK		64
+#define LOCAL_SHADOWS_PER_CHUNK			16
+
+#define SNAPSHOT_CHUNK_SIZE				256
+#define SNAPSHOT_PAGE_SIZE				64
+#define NODE_POOL_ARRAY_SIZE			1024
+
+#define QUERY_RING_SIZE					3
 
 #define IMGUI_TEXTURE_UNIT				0x84C0
 
@@ -21,3 +49,19 @@
 #define DIFFUSE_MAP_TEXTURE_UNIT		0x84C9
 #define NORMAL_MAP_TEXTURE_UNIT			0x84CA
 #define SPECULAR_MAP_TEXTURE_UNIT		0x84CB
+#define SHADOW_MOMENTS_TEXTURE_UNIT		0x84CD
+#define DEPTH_PYRAMID_TEXTURE_UNIT		0x84CE
+
+#define REDUCED_COLOR_BUFFER0_UNIT		0x84CF
+#define REDUCED_COLOR_BUFFER1_UNIT		0x84D0
+#define REDUCED_COLOR_BUFFER2_UNIT		0x84D1
+#define REDUCED_COLOR_BUFFER3_UNIT		0x84D2
+#define REDUCED_DEPTH_BUFFER_UNIT		0x84D3
+#define REDUCED_LIGHTING_BUFFER_UNIT	0x84D4
+
+#define LOCAL_LIGHTING_BUFFER_UNIT		0x84D5
+#define HISTORY_BUFFER0_UNIT			0x84D6
+#define HISTORY_BUFFER1_UNIT			0x84D7
+#define HISTORY_NORMALS0_UNIT			0x84D8
+#define HISTORY_NORMALS1_UNIT			0x84D9
+#define REFERENCE_ACCUMULATION_UNIT		0x84DA
@@ -3,18 +3,27 @@
 #include "IRenderPass.h"
 #include "Program.h"
 #include "LocalLight.h"
+#include "Object.h"
+#include "CommandBuffer.h"
 
+#include <atomic>
 #include <vector>
+#include <map>
+#include <tuple>
 
 class Object;
+class Mesh;
+class Material;
 class GlobalLight;
 class LocalLight;
-
+class SceneSnapshot;
 
 class DeferredPass : public IRenderPass
 {
 public:
 
+	friend class DeferredRenderer;
+
 	//constructors/destructor
 	DeferredPass(IRenderer const * renderer);
 	~DeferredPass();
@@ -22,19 +31,58 @@ public:
 	//public methods
 	void Initialize();
 	void Prepare(Scene const & scene) const;
-	void ProcessScene(Scene const & scene, std::vector<std::pair<GlobalLight const *, glm::vec3>> * globalLights, std::vector<struct LocalLightInformation> * localLights, std::vector<Object const *> * reflectiveObjects) const;
-	void ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix) const;
+	void ProcessScene(SceneSnapshot const & snapshot, std::vector<std::pair<GlobalLight const *, glm::vec3>> * globalLights, std::vector<struct LocalLightInformation> * localLights, std::vector<std::pair<LocalLight const *, unsigned int>> * shadowedLocalLights, std::vector<Object const *> * reflectiveObjects, std::vector<struct InstanceGroup> * instanceGroups, std::vector<glm::mat4> * instanceTransforms) const;
+	void PrepareTraversal(unsigned int const & bucketsCount) const;
+	void ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix, unsigned int const & bucket) const;
+	void ProcessInstanceGroups(std::vector<struct InstanceGroup> const & instanceGroups) const;
 	void Finalize();
 
 	//getters
 	Program const & GetProgram() const;
 
+	//statistical information
+	unsigned int const & GetObjectsCount() const;
+	unsigned int const & GetDrawCallsCount() const;
+	unsigned int const & GetTrianglesCount() const;
+
 private:
 
+	//private methods
+	unsigned int SelectLevelOfDetail(Object const * object, glm::mat4 const & modelMatrix) const;
+
+	//what one traversal chunk gathered, shadowed lights index into the local lights of the same bucket
+	struct GatherBucket
+	{
+		std::vector<std::pair<GlobalLight const *, glm::vec3>> globalLights;
+		std::vector<struct LocalLightInformation> localLights;
+		std::vector<std::pair<LocalLight const *, unsigned int>> shadowedLocalLights;
+		std::vector<struct InstanceGroup> instanceGroups;
+		std::map<std::tuple<Mesh const *, Material const *, unsigned int>, unsigned int> instanceGroupIndices;
+		unsigned int objectsCount;
+	};
+
 	//private state
-	mutable std::vector<std::pair<GlobalLight const *, glm::vec3>> * m_globalLights;
-	mutable std::vector<struct LocalLightInformation> * m_localLights;
 	mutable std::vector<Object const *> * m_reflectiveObjects;
+	mutable std::vector<GatherBucket> m_buckets;
+	mutable std::map<std::tuple<Mesh const *, Material const *, unsigned int>, unsigned int> m_instanceGroupIndices;
+
+	//level of detail selection
+	mutable glm::mat4 m_viewMatrix;
+	mutable float m_projectionScale;
+
+	//current level of every object by slot, the published copies of the objects are replaced whenever they change
+	mutable std::vector<unsigned char> m_levelsOfDetail;
+
+	//edited by the render thread while the window thread gathers
+	std::atomic<float> m_lodScreenSize;
+	std::atomic<float> m_lodHysteresis;
+
+	mutable unsigned int m_objectsCount;
+	mutable unsigned int m_drawCallsCount;
+	mutable unsigned int m_trianglesCount;
+
+	//one buffer per recording worker
+	mutable std::vector<CommandBuffer> m_commandBuffers;
 
 	Program m_deferredProgram;
 
@@ -9,14 +9,28 @@
 #include <Framework/Texture.h>
 #include <Framework/UniformBuffer.h>
 #include <Framework/ShaderStorageBuffer.h>
+#include <Framework/Query.h>
+#include <Framework/RenderGraph.h>
 
 #include <vector>
+#include <map>
+#include <memory>
 
 class Light;
+class GlobalLight;
+class LocalLight;
+class SceneSnapshot;
 
 class DeferredRenderer : public IRenderer
 {
 public:
+
+	typedef enum AccumulationFormat
+	{
+		R11G11B10F_FORMAT = 0,
+		RGBA16F_FORMAT = 1,
+		RGBA32F_FORMAT = 2
+	} AccumulationFormatType;
 	
 	//constructors/destructor
 	DeferredRenderer();
@@ -25,24 +39,39 @@ public:
 	//public methods
 	bool Initialize();
 	void Finalize();
-	void RenderScene(Scene const & scene) const;
+	void PrepareFrame(Scene const & scene, FramePacket & packet) const;
+	void RenderScene(Scene const & scene, FramePacket & packet) const;
 	void Resize(int const & width, int const & height);
 	void GenerateGUI();
 
 	void BindGBuffer() const;
 	void BindShadowBuffer(Texture const & shadowTexture) const;
 	void BindLightAccumulationBuffer() const;
+	void BindLocalLightingBuffer() const;
+	void BindTemporalResolveBuffer(unsigned int const & history) const;
+	void BindReducedGBuffer() const;
+	void BindReducedLightingBuffer() const;
 	void BindDefaultFramebuffer() const;
 	void BlitDepthBuffers() const;
 
+	unsigned int const & GetRenderWidth() const;
+	unsigned int const & GetRenderHeight() const;
+
 private:
 	
+	void UpdateResolutionScale() const;
+	void ValidateAccumulationPrecision(Scene const & scene, std::vector<std::pair<GlobalLight const *, glm::vec3>> const & globalLights) const;
 	void CreateGBuffer(int const & width, int const & height);
 	void FreeGBuffer();
 	void CreateShadowBuffer(int const & width, int const & height);
 	void FreeShadowBuffer();
 	void CreateLightAccumulationBuffer(int const & width, int const & height);
 	void FreeLightAccumulationBuffer();
+	void CreateReducedLightingBuffer();
+	void FreeReducedLightingBuffer();
+	void SetDrawBuffers(unsigned int const & framebuffer, unsigned int const & count, unsigned int const * drawBuffers) const;
+	void AttachTexture(unsigned int const & framebuffer, unsigned int const & attachment, unsigned int const & texture) const;
+	void ForgetFramebuffer(unsigned int const & framebuffer);
 
 	struct gBuffer
 	{
@@ -60,21 +89,85 @@ private:
 	struct ShadowBuffer
 	{
 		unsigned int framebuffer;
-		unsigned int depthBuffer;
 		unsigned int width;
 		unsigned int height;
-		unsigned int drawBuffers;
 	} m_shadowBuffer;
 
 	struct LightAccumulationBuffer
 	{
 		unsigned int framebuffer;
 		Texture colorBuffer;
+		//local lights are accumulated separately into a transient target when their shading is spread over two frames
+		Texture historyBuffers[2];
+		Texture historyNormals[2];
 		unsigned int width;
 		unsigned int height;
 		unsigned int drawBuffers;
+		int format;
 	} m_lightAccumulationBuffer;
 
+	//the lighting is rendered a second time into a full precision transient target while validating the accumulation format
+	struct ReferenceAccumulationBuffer
+	{
+		unsigned int framebuffer;
+	} m_referenceAccumulationBuffer;
+
+	//the cheapest accumulation format whose tone mapped error stays below the thresholds is searched for every scene
+	struct AccumulationPrecision
+	{
+		int format;
+		bool validate;
+		bool automatic;
+		bool searching;
+		float maxErrorThreshold;
+		float meanErrorThreshold;
+		float maxError;
+		float meanError;
+		unsigned int frames;
+		Scene const * scene;
+	};
+
+	mutable AccumulationPrecision m_accumulationPrecision;
+	mutable bool m_renderingReference;
+	mutable ShaderStorageBuffer<glm::vec2> m_errorBuffer;
+	Program m_errorProgram;
+
+	//downsampled copy of the g-buffer and the local lights accumulated at that resolution, all of them transient targets
+	struct ReducedLightingBuffer
+	{
+		unsigned int framebuffer;
+		unsigned int drawBuffers[5];
+	} m_reducedLightingBuffer;
+
+	//the g-buffer and lighting render into the lower left corner of the window sized targets, scaled to meet a gpu time budget
+	struct DynamicResolution
+	{
+		bool enabled;
+		float targetFrameTime;
+		float minScale;
+		float maxScale;
+		float scale;
+		float frameTime;
+		unsigned int cooldown;
+		unsigned int width;
+		unsigned int height;
+	};
+
+	mutable DynamicResolution m_dynamicResolution;
+
+	//the passes of a frame are declared with the resources they use, the graph owns the transient targets
+	mutable RenderGraph m_renderGraph;
+
+	//the draw buffers and attachments are remembered per framebuffer object, so they are only set when they change
+	struct FramebufferState
+	{
+		std::map<unsigned int, std::vector<unsigned int>> drawBuffers;
+		std::map<std::pair<unsigned int, unsigned int>, unsigned int> attachments;
+		unsigned int drawBufferChanges;
+	};
+
+	mutable FramebufferState m_framebufferState;
+
 	struct DefaultFramebuffer
 	{
 		unsigned int framebuffer;
@@ -85,6 +178,14 @@ private:
 
 	mutable UniformBuffer										m_sceneUniformBuffer;
 	mutable ShaderStorageBuffer<struct LocalLightInformation>	m_localLightsBuffer;
+	mutable ShaderStorageBuffer<glm::mat4>						m_instanceBuffer;
+
+	//lists of the frame being rendered, taken over from its packet along with the snapshot they point into
+	mutable std::shared_ptr<SceneSnapshot const>							m_snapshot;
+	mutable std::vector<std::pair<GlobalLight const *, glm::vec3>>			m_globalLights;
+	mutable std::vector<std::pair<LocalLight const *, unsigned int>>		m_shadowedLocalLights;
+	mutable std::vector<struct InstanceGroup>								m_instanceGroups;
+	mutable unsigned int													m_objectsCount;
 
 	Program m_debugProgram;
 
@@ -93,6 +194,14 @@ private:
 	LightingPass m_lightingPass;
 	ToneMappingPass m_toneMappingPass;
 
+	//gpu time of the passes, only measured while statistics are gathered
+	Query m_geometryTimer;
+	Query m_shadowTimer;
+	Query m_globalLightingTimer;
+	Query m_localLightingTimer;
+
+	//last local lighting time measured at every resolution, to compare them side by side
+	double m_localLightingTimes[3];
 
 	bool m_gatherStatistics;
 	bool m_displayLightVolumes;
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Framework/Input.h>
+#include <Framework/LocalLight.h>
+#include <Framework/Object.h>
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class GlobalLight;
+class SceneSnapshot;
+
+//what the window thread gathers for a frame, the render thread only consumes it
+struct FramePacket
+{
+	unsigned long long index;
+	int width;
+	int height;
+
+	//input
+	std::vector<InputEvent> inputEvents;
+	bool hasInput;
+	std::chrono::steady_clock::time_point inputTime;
+	std::chrono::steady_clock::time_point preparationStart;
+
+	//the lists point into the snapshot they were gathered from
+	std::shared_ptr<SceneSnapshot const> snapshot;
+
+	//visible lists
+	std::vector<std::pair<GlobalLight const *, glm::vec3>> globalLights;
+	std::vector<LocalLightInformation> localLights;
+	std::vector<std::pair<LocalLight const *, unsigned int>> shadowedLocalLights;
+	std::vector<InstanceGroup> instanceGroups;
+	std::vector<glm::mat4> instanceTransforms;
+	unsigned int objectsCount;
+};
+
+//a bounded ring of packets, the producer blocks once every packet is in flight so it never runs further ahead than the queue
+class FrameQueue
+{
+public:
+
+	//constructors/destructor
+	FrameQueue(unsigned int const & capacity);
+	~FrameQueue();
+
+	//window thread, a null packet means the queue was closed
+	FramePacket * BeginPacket();
+	void SubmitPacket(FramePacket * packet);
+	void Close();
+
+	//render thread
+	FramePacket * AcquirePacket();
+	void ReleasePacket(FramePacket * packet);
+
+	//holds the window thread outside of frame preparation, for work that must not overlap it
+	void SuspendProducer();
+	void ResumeProducer();
+
+	//statistical information
+	unsigned int const & GetCapacity() const;
+	unsigned int GetQueuedPacketsCount() const;
+	float GetFrameTime() const;
+	float GetPreparationTime() const;
+	float GetLatency() const;
+	float GetMaxLatency() const;
+
+private:
+
+	unsigned int m_capacity;
+	std::vector<std::unique_ptr<FramePacket>> m_packets;
+	std::deque<FramePacket *> m_freePackets;
+	std::deque<FramePacket *> m_submittedPackets;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_changed;
+	bool m_closed;
+	bool m_suspended;
+	bool m_preparing;
+	unsigned long long m_submittedCount;
+
+	//times in milliseconds, smoothed over the last frames
+	std::chrono::steady_clock::time_point m_lastRelease;
+	float m_frameTime;
+	float m_preparationTime;
+	float m_latency;
+	float m_maxLatency;
+
+};
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <utility>
+#include <vector>
+
 class Window;
+class FrameQueue;
 class Scene;
 class Node;
 class Material;
@@ -17,7 +21,7 @@ public:
 
 	void Initialize(Window const & window);
 	void NewFrame(int const & width, int const & height);
-	void GenerateGUI(Scene & scene);
+	void GenerateGUI(Scene & scene, FrameQueue & frames);
 	void EndFrame();
 	void Finalize();
 
@@ -25,5 +29,15 @@ private:
 
 	void TraverseNode(Node * node, Scene & scene);
 	void MaterialEditor(Material * material, Scene & scene);
+	void BenchmarkTraversal(Scene & scene);
+
+	//workers and average gathering time of the last benchmark
+	std::vector<std::pair<unsigned int, double>> m_benchmarkResults;
+
+	//building and publishing the benchmark scene, and how many of its scene and snapshot nodes follow their predecessor in memory
+	double m_benchmarkBuildTime;
+	float m_benchmarkPublishTime;
+	float m_benchmarkSequentialSceneNodes;
+	float m_benchmarkSequentialSnapshotNodes;
 };
 
@@ -1,7 +1,17 @@
 #pragma once
 
 #include <Framework/Node.h>
-#include <Framework/Texture.h>
+#include <Framework/Defaults.h>
+
+//one entry per light of the batched lighting pass, shadow tiles hold atlas offset (xy) and scale (z)
+struct GlobalLightInformation
+{
+	glm::vec4 position;
+	glm::vec4 intensity;
+	glm::mat4 shadowMatrices[SHADOW_CASCADE_COUNT];
+	glm::vec4 shadowTiles[SHADOW_CASCADE_COUNT];
+	glm::vec4 cascadeSplits;
+};
 
 class GlobalLight : public Node
 {
@@ -15,10 +25,19 @@ public:
 	GlobalLight(std::string const & name, glm::vec3 const & intensity);
 	~GlobalLight();
 
+	static void * operator new(std::size_t size);
+	static void operator delete(void * pointer, std::size_t size);
+
+	//public methods
+	Node * Clone() const;
+
 	//getters
 	glm::vec3 const &		GetIntensity() const;
-	glm::mat4 const &		GetShadowMatrix() const;
-	Texture const &			GetShadowMap() const;
+	glm::mat4 const &		GetShadowMatrix(unsigned int const & cascade) const;
+	glm::vec4 const &		GetCascadeSplits() const;
+	glm::vec3 const &		GetShadowTile(unsigned int const & cascade) const;
+	unsigned int const &	GetShadowResolution() const;
+	float					GetShadowCacheHitRate() const;
 	NodeType				GetNodeType() const;
 
 	//setters
@@ -27,11 +46,18 @@ public:
 private:
 
 	//private methods
-	void CreateHandle();
-	void DestroyHandle();
+	void ResetShadowState() const;
 
 	glm::vec3			m_intensity;
-	mutable glm::mat4	m_shadowMatrix;
-	Texture				m_shadowMap;
+	mutable glm::mat4	m_shadowMatrices[SHADOW_CASCADE_COUNT];
+	mutable glm::vec4	m_cascadeSplits;
+
+	//atlas offset (xy) and scale (z) of every cascade, resolution is zero when the light casts no shadows
+	mutable glm::vec3		m_shadowTiles[SHADOW_CASCADE_COUNT];
+	mutable unsigned int	m_shadowResolution;
+
+	//cache statistics of the shadow pass, published every frame
+	mutable unsigned int		m_shadowCacheHits;
+	mutable unsigned int		m_shadowCacheLookups;
 };
 
@@ -12,7 +12,9 @@ public:
 	IRenderPass(IRenderer const * renderer) : m_renderer(renderer) {}
 	virtual ~IRenderPass() {}
 	virtual void Initialize() = 0;
-	virtual void ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix) const = 0;
+	//traversal runs on several workers, each writes only to the bucket it is given
+	virtual void PrepareTraversal(unsigned int const & /*bucketsCount*/) const {}
+	virtual void ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix, unsigned int const & bucket) const = 0;
 	virtual void Finalize() = 0;
 protected:
 	IRenderer const * m_renderer;
@@ -1,9 +1,8 @@
 #pragma once
 
-#include <vector>
-
 class Scene;
 class Node;
+struct FramePacket;
 
 class IRenderer
 {
@@ -12,13 +11,16 @@ public:
 	virtual ~IRenderer() {}
 	virtual bool Initialize() = 0;
 	virtual void Finalize() = 0;
-	virtual void RenderScene(Scene const & scene) const = 0;
+	//gathering runs on the window thread, everything touching the context on the render thread
+	virtual void PrepareFrame(Scene const & scene, FramePacket & packet) const = 0;
+	virtual void RenderScene(Scene const & scene, FramePacket & packet) const = 0;
 	virtual void Resize(int const & width, int const & height) = 0;
 	virtual void GenerateGUI() = 0;
 
 protected:
 
 	Node const * const & GetRootNode(Scene const & scene) const;
-	std::vector<Node *> const & GetChildren(Node const * const & node) const;
+	Node const * GetFirstChild(Node const * const & node) const;
+	Node const * GetNextSibling(Node const * const & node) const;
 
 };
\ No newline at end of file
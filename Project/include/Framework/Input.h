@@ -2,8 +2,29 @@
 
 #include <imgui/imgui.h>
 
+#include <chrono>
+#include <vector>
+
 class Application;
 
+//window messages arrive on the window thread, they are recorded and replayed into the gui by the render thread
+struct InputEvent
+{
+	typedef enum InputEventType {
+		KEY_DOWN,
+		KEY_UP,
+		MOUSE_MOVE,
+		MOUSE_DOWN,
+		MOUSE_UP,
+		MOUSE_SCROLL,
+		CHARACTER_INPUT
+	} InputEventType;
+
+	InputEventType type;
+	int x;
+	int y;
+};
+
 class Input
 {
 
@@ -16,6 +37,7 @@ public:
 	void Update();
 	void Finalize();
 
+	//window thread
 	void KeyDown(unsigned char key);
 	void KeyUp(unsigned char key);
 	void MouseMove(int x, int y);
@@ -23,12 +45,20 @@ public:
 	void MouseUp(char button);
 	void MouseScroll(int value);
 	void CharInput(int character);
+	bool TakeEvents(std::vector<InputEvent> & events, std::chrono::steady_clock::time_point & firstEventTime);
+
+	//render thread
+	void ApplyEvents(std::vector<InputEvent> const & events);
 
 private:
 
+	void RecordEvent(InputEvent::InputEventType type, int x, int y);
+
 	Application * m_application;
 
 	ImGuiIO * m_io;
 
-};
+	std::vector<InputEvent> m_events;
+	std::chrono::steady_clock::time_point m_firstEventTime;
 
+};
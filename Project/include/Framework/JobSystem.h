@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct Job;
+
+//counts the jobs that have not finished yet, continuations attached to it are scheduled once it drops to zero
+class JobCounter
+{
+public:
+
+	friend class JobSystem;
+
+	//constructors/destructor
+	JobCounter();
+	~JobCounter();
+
+	//getters
+	bool IsDone() const;
+
+private:
+
+	struct Continuation
+	{
+		std::function<void()> work;
+		JobCounter * counter;
+	};
+
+	std::atomic<unsigned int> m_pending;
+	std::mutex m_mutex;
+	std::vector<Continuation> m_continuations;
+
+};
+
+class JobSystem
+{
+public:
+
+	//static methods
+	static void Initialize(unsigned int const & workersCount = 0);
+	static void Finalize();
+
+	//jobs are counted on the given counter, a continuation runs once its dependency has finished
+	static void Run(std::function<void()> const & work, JobCounter & counter);
+	static void Then(JobCounter & dependency, std::function<void()> const & work, JobCounter & counter);
+
+	//the waiting thread executes queued jobs until the counter drops to zero
+	static void Wait(JobCounter & counter);
+
+	//splits the items into contiguous chunks of at least grainSize items, the body receives the chunk index and its range
+	static void ParallelFor(unsigned int const & itemsCount, unsigned int const & grainSize, std::function<void(unsigned int, unsigned int, unsigned int)> const & body);
+	static unsigned int GetChunksCount(unsigned int const & itemsCount, unsigned int const & grainSize);
+	static unsigned int const & GetWorkersCount();
+
+	//statistical information
+	static void ResetStatistics();
+	static unsigned int GetExecutedJobsCount();
+	static unsigned int GetStolenJobsCount();
+
+private:
+
+	static void WorkerLoop(unsigned int const index);
+	static void Execute(Job & job);
+	static void Finish(JobCounter & counter);
+
+};
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <Framework/Program.h>
+#include <Framework/Query.h>
+#include <Framework/ShaderStorageBuffer.h>
+#include <Framework/Texture.h>
 #include <vector>
 
 class IRenderer;
@@ -8,11 +11,23 @@ class Scene;
 class GlobalLight;
 class LocalLight;
 class Shape;
+class ShadowPass;
+struct LocalLightInformation;
+struct GlobalLightInformation;
 
 class LightingPass
 {
 public:
 
+	friend class DeferredRenderer;
+
+	typedef enum LightingResolution
+	{
+		FULL_RESOLUTION = 0,
+		HALF_RESOLUTION = 1,
+		QUARTER_RESOLUTION = 2
+	} LightingResolutionType;
+
 	//constructors/destructor
 	LightingPass(IRenderer const * renderer);
 	~LightingPass();
@@ -20,14 +35,24 @@ public:
 	//public methods
 	void Initialize();
 	void Prepare(Scene const & scene) const;
+	void SelectLightProxies(Scene const & scene, std::vector<struct LocalLightInformation> & localLights) const;
+	void CullLocalLights(Scene const & scene, unsigned int const & lightsCount, Texture const & depthBuffer) const;
 	void ProcessAmbientLight() const;
-	void ProcessGlobalLights(std::vector<std::pair<GlobalLight const *,glm::vec3>> const & globalLights) const;
-	void ProcessLocalLights(unsigned int const & lightsCount) const;
+	void ProcessGlobalLights(std::vector<std::pair<GlobalLight const *,glm::vec3>> const & globalLights, ShadowPass const & shadowPass) const;
+	void ProcessLocalLights(unsigned int const & lightsCount, Texture const & shadowAtlas) const;
 	void Finalize();
 
+	//the renderer declares the targets of the local lights from the same configuration
+	int GetLocalLightingScale() const;
+	bool IsCheckerboarding() const;
+
 	//statistical information
 	unsigned int const & GetGlobalLightsCount() const;
 	unsigned int const & GetLocalLightsCount() const;
+	unsigned long long const & GetLocalLightInvocationsCount() const;
+	unsigned int const & GetSphereProxiesCount() const;
+	unsigned int GetQuadProxiesCount() const;
+	unsigned int const & GetVisibleLightsCount() const;
 
 protected:
 
@@ -35,12 +60,71 @@ protected:
 
 private:
 
+	struct DrawCommand
+	{
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		unsigned int baseVertex;
+		unsigned int baseInstance;
+	};
+
+	//private methods
+	void BuildDepthPyramid(Texture const & depthBuffer) const;
+
 	mutable std::vector<std::pair<GlobalLight const *, glm::vec3>> const * m_globalLights;
 	mutable unsigned int m_localLightsCount;
 
+	//lights are sorted so the ones drawn as spheres come first, the rest are drawn as screen space quads
+	mutable unsigned int m_sphereLightsCount;
+	float m_quadProxySize;
+
+	//ambient and global lights shaded in a single full screen pass
+	mutable ShaderStorageBuffer<struct GlobalLightInformation> m_globalLightsBuffer;
+	bool m_batchGlobalLights;
+
+	//local lights can be accumulated at a reduced resolution and upsampled guided by the full resolution depth and normals
+	int m_localLightingResolution;
+	//set while the accumulation precision is validated, both renders then shade every pixel at full resolution
+	mutable bool m_directLocalLighting;
+
+	//local lights shaded on a checkerboard alternating every frame, the other half is reprojected from the previous frame
+	bool m_checkerboardLocalLights;
+	mutable bool m_historyValid;
+	mutable unsigned int m_frameIndex;
+	mutable glm::mat4 m_viewMatrix;
+	mutable glm::mat4 m_projectionMatrix;
+	mutable glm::mat4 m_previousViewMatrix;
+	mutable glm::mat4 m_previousProjectionMatrix;
+	mutable glm::vec2 m_previousRenderSize;
+
+	//fragment shader invocations of the local lights, only counted when pipeline statistics are supported
+	Query m_localLightInvocations;
+	bool m_stencilVolumes;
+
+	//lights are culled against the frustum and the farthest depth of the screen, the survivors feed indirect draws
+	mutable ShaderStorageBuffer<DrawCommand> m_drawCommandBuffer;
+	mutable ShaderStorageBuffer<unsigned int> m_visibleLightsBuffer;
+	mutable Texture m_depthPyramid;
+	mutable unsigned int m_depthPyramidLevels;
+	bool m_gpuCulling;
+	bool m_occlusionCulling;
+
+	//the draw commands are copied aside and read back once the gpu is done with them, so the count never stalls
+	GLuint m_visibleCountBuffer;
+	mutable GLsync m_visibleCountFence;
+	mutable unsigned int m_visibleLightsCount;
+
 	Program m_ambientLightProgram;
 	Program m_globalLightProgram;
+	Program m_batchedLightProgram;
 	Program m_localLightProgram;
+	Program m_localLightStencilProgram;
+	Program m_depthPyramidProgram;
+	Program m_lightCullingProgram;
+	Program m_downsampleProgram;
+	Program m_upsampleProgram;
+	Program m_temporalResolveProgram;
 
 };
 
@@ -7,6 +7,15 @@ struct LocalLightInformation
 	float position[4];
 	float intensity[3];
 	float radius;
+	int shadowIndex;
+	float padding[3];
+};
+
+//one atlas tile per cube face, +x -x +y -y +z -z
+struct LocalShadowInformation
+{
+	glm::mat4 matrices[6];
+	glm::vec4 tiles[6];
 };
 
 class LocalLight : public Node
@@ -20,18 +29,27 @@ public:
 	LocalLight(std::string const & name, glm::vec3 const & intensity, float const & radius);
 	~LocalLight();
 
+	static void * operator new(std::size_t size);
+	static void operator delete(void * pointer, std::size_t size);
+
+	//public methods
+	Node * Clone() const;
+
 	//getters
 	glm::vec3 const & GetIntensity() const;
 	float const & GetRadius() const;
+	bool const & GetCastShadows() const;
 	NodeType GetNodeType() const;
 
 	//setters
 	void SetIntensity(glm::vec3 const & intensity);
 	void SetRadius(float const & radius);
+	void SetCastShadows(bool const & castShadows);
 
 private:
 
 	glm::vec3	m_intensity;
 	float		m_radius;
+	bool		m_castShadows;
 
 };
\ No newline at end of file
@@ -1,22 +1,48 @@
 #pragma once
 
 #include <assimp/mesh.h>
+#include <glm/glm.hpp>
+#include <vector>
 
 class Mesh
 {
 public:
 
-	Mesh(unsigned const & numberOfFaces, aiFace * faces, aiVector3t<float> * positions, aiVector3t<float> * normals, aiVector3t<float> * tangents, aiVector3t<float> * textureCoords[8]);
+	Mesh(unsigned const & numberOfVertices, unsigned const & numberOfFaces, aiFace * faces, aiVector3t<float> * positions, aiVector3t<float> * normals, aiVector3t<float> * tangents, aiVector3t<float> * textureCoords[8]);
 	~Mesh();
 
 	unsigned const & GetVAO() const;
 	unsigned const & GetVertexCount() const;
 
+	//level of detail
+	unsigned GetLevelCount() const;
+	unsigned const & GetIndexCount(unsigned const & level) const;
+	unsigned const & GetIndexOffset(unsigned const & level) const;
+	unsigned GetTriangleCount(unsigned const & level) const;
+
+	//bounds
+	glm::vec3 const & GetBoundingSphereCenter() const;
+	float const & GetBoundingSphereRadius() const;
+
 private:
 
+	void GenerateLevelsOfDetail(std::vector<glm::vec3> const & positions, std::vector<bool> const & lockedVertices, std::vector<unsigned> & indices);
+
+	struct LevelOfDetail
+	{
+		unsigned indexOffset;
+		unsigned indexCount;
+	};
+
 	unsigned m_vao;
 	unsigned m_vbo;
+	unsigned m_ibo;
 	unsigned m_vertexCount;
 
+	std::vector<struct LevelOfDetail> m_levels;
+
+	glm::vec3 m_boundingSphereCenter;
+	float m_boundingSphereRadius;
+
 };
 
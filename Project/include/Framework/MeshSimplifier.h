@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <queue>
+
+class MeshSimplifier
+{
+public:
+
+	//constructors/destructor
+	MeshSimplifier(std::vector<glm::vec3> const & positions, std::vector<unsigned int> const & indices, std::vector<bool> const & lockedVertices);
+	~MeshSimplifier();
+
+	//public methods
+	bool Simplify(unsigned int const & targetTriangleCount);
+
+	//getters
+	unsigned int const & GetTriangleCount() const;
+	void GetIndices(std::vector<unsigned int> & indices) const;
+
+private:
+
+	struct Quadric
+	{
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	};
+
+	struct Collapse
+	{
+		double cost;
+		unsigned int from;
+		unsigned int to;
+		unsigned int fromVersion;
+		unsigned int toVersion;
+
+		bool operator<(Collapse const & other) const { return cost > other.cost; }
+	};
+
+	//private methods
+	static Quadric PlaneQuadric(glm::dvec3 const & normal, double const & d, double const & weight);
+	static void AddQuadric(Quadric & target, Quadric const & source);
+	static double EvaluateQuadric(Quadric const & q, glm::dvec3 const & p);
+
+	void PushEdge(unsigned int const & a, unsigned int const & b);
+	bool IsCollapseValid(unsigned int const & from, unsigned int const & to) const;
+	void CollapseEdge(unsigned int const & from, unsigned int const & to);
+	void GatherNeighbours(unsigned int const & vertex, std::vector<unsigned int> & neighbours) const;
+
+	std::vector<glm::dvec3> m_positions;
+	std::vector<unsigned int> m_triangles;
+	std::vector<bool> m_triangleAlive;
+	std::vector<std::vector<unsigned int>> m_vertexTriangles;
+	std::vector<Quadric> m_quadrics;
+	std::vector<unsigned int> m_versions;
+	std::vector<bool> m_vertexAlive;
+	std::vector<bool> m_locked;
+
+	std::priority_queue<Collapse> m_collapses;
+	unsigned int m_triangleCount;
+
+};
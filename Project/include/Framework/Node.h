@@ -1,10 +1,12 @@
 #pragma once
 
-#include <vector>
+#include <cstddef>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <string>
 
+class Scene;
+
 class Node
 {
 
@@ -13,15 +15,24 @@ public:
 	friend class IRenderer;
 	friend class Scene;
 	friend class GUI;
+	friend class SceneSnapshot;
 
 	//constructors/destructor
 	Node(std::string const & name);
 	Node(std::string const & name, glm::vec3 const & translation, glm::quat const & orientation);
+	Node(Node const & node);
 	virtual ~Node();
 
+	//every node type is carved out of its own pool
+	static void * operator new(std::size_t size);
+	static void operator delete(void * pointer, std::size_t size);
+
 	//public methods
 	void AddChild(Node * node);
 
+	//copy for the render side, without children and outside of any scene
+	virtual Node * Clone() const;
+
 	//getters
 	glm::vec3 const & GetTranslation() const;
 	glm::vec3 const & GetScale() const;
@@ -29,6 +40,7 @@ public:
 	glm::mat4 GetTransformMatrix() const;
 	glm::mat4 GetTransformMatrixWithScale() const;
 	std::string const & GetName() const;
+	unsigned int const & GetSlot() const;
 
 	//setters
 	void SetTranslation(glm::vec3 const & translation);
@@ -48,12 +60,28 @@ public:
 
 	virtual NodeType GetNodeType() const;
 
+protected:
+
+	//queues the node for the next snapshot of its scene
+	void Changed();
+
 private:
 
-	std::string m_name;
+	//names are interned, nodes sharing one point to the same string
+	std::string const * m_name;
 	glm::vec3 m_translation;
 	glm::vec3 m_scale;
 	glm::quat m_orientation;
-	std::vector<Node *> m_children;
+
+	//children are chained through their sibling links, without a list of their own
+	Node * m_firstChild;
+	Node * m_lastChild;
+	Node * m_nextSibling;
+
+	//set once the node is part of a scene, the slot is its place in the snapshots
+	Scene * m_scene;
+	unsigned int m_slot;
+	bool m_contentChanged;
+	bool m_linksChanged;
 
 };
\ No newline at end of file
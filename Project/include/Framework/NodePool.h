@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Framework/Defaults.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//fixed size blocks carved out of large arrays, one pool per type, freed blocks are handed out again first
+template<class T>
+class NodePool
+{
+public:
+
+	static void * Allocate()
+	{
+		NodePool & pool = Instance();
+		std::lock_guard<std::mutex> lock(pool.m_mutex);
+		if (!pool.m_freeList)
+			pool.Grow();
+
+		Block * block = pool.m_freeList;
+		pool.m_freeList = block->next;
+		pool.m_usedCount++;
+		return block;
+	}
+
+	static void Free(void * pointer)
+	{
+		if (!pointer)
+			return;
+
+		NodePool & pool = Instance();
+		std::lock_guard<std::mutex> lock(pool.m_mutex);
+		Block * block = static_cast<Block *>(pointer);
+		block->next = pool.m_freeList;
+		pool.m_freeList = block;
+		pool.m_usedCount--;
+	}
+
+	//statistical information
+	static unsigned int GetUsedCount()
+	{
+		NodePool & pool = Instance();
+		std::lock_guard<std::mutex> lock(pool.m_mutex);
+		return pool.m_usedCount;
+	}
+
+	static unsigned int GetCapacity()
+	{
+		NodePool & pool = Instance();
+		std::lock_guard<std::mutex> lock(pool.m_mutex);
+		return (unsigned int)pool.m_arrays.size() * NODE_POOL_ARRAY_SIZE;
+	}
+
+private:
+
+	union Block
+	{
+		Block * next;
+		typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+	};
+
+	NodePool() : m_mutex(), m_arrays(), m_freeList(nullptr), m_usedCount(0)
+	{
+
+	}
+
+	//never destroyed, snapshots may still release nodes while statics are torn down
+	static NodePool & Instance()
+	{
+		static NodePool * pool = new NodePool();
+		return *pool;
+	}
+
+	void Grow()
+	{
+		//the blocks are listed in address order, nodes created one after the other end up next to each other
+		Block * blocks = new Block[NODE_POOL_ARRAY_SIZE];
+		m_arrays.push_back(std::unique_ptr<Block[]>(blocks));
+		for (unsigned int i = 0; i < NODE_POOL_ARRAY_SIZE - 1; ++i)
+			blocks[i].next = &blocks[i + 1];
+		blocks[NODE_POOL_ARRAY_SIZE - 1].next = m_freeList;
+		m_freeList = blocks;
+	}
+
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<Block[]>> m_arrays;
+	Block * m_freeList;
+	unsigned int m_usedCount;
+
+};
+
+//hands single objects out of their type's pool, for the bookkeeping allocated along with the nodes
+template<class T>
+class NodeAllocator
+{
+public:
+
+	typedef T value_type;
+
+	NodeAllocator()
+	{
+
+	}
+
+	template<class U>
+	NodeAllocator(NodeAllocator<U> const &)
+	{
+
+	}
+
+	T * allocate(std::size_t count)
+	{
+		return count == 1 ? static_cast<T *>(NodePool<T>::Allocate()) : static_cast<T *>(::operator new(count * sizeof(T)));
+	}
+
+	void deallocate(T * pointer, std::size_t count)
+	{
+		if (count == 1)
+			NodePool<T>::Free(pointer);
+		else
+			::operator delete(pointer);
+	}
+
+	template<class U>
+	bool operator==(NodeAllocator<U> const &) const
+	{
+		return true;
+	}
+
+	template<class U>
+	bool operator!=(NodeAllocator<U> const &) const
+	{
+		return false;
+	}
+
+};
@@ -2,19 +2,37 @@
 
 #include "Node.h"
 
+#include <vector>
+
 class Mesh;
 class Material;
 
+struct InstanceGroup
+{
+	Mesh const * mesh;
+	Material const * material;
+	unsigned int lod;
+	std::vector<glm::mat4> modelMatrices;
+	unsigned int offset;
+};
+
 class Object : public Node
 {
 public:
 
 	friend class GUI;
+	friend class DeferredPass;
 
 	//constructors/destructor
 	Object(std::string const & name, Mesh * mesh, Material * material);
 	~Object();
 
+	static void * operator new(std::size_t size);
+	static void operator delete(void * pointer, std::size_t size);
+
+	//public methods
+	Node * Clone() const;
+
 	//getters
 	Mesh const * const & GetMesh() const;
 	Material const * const & GetMaterial() const;
@@ -8,7 +8,8 @@ public:
 
 	typedef enum ShaderType {
 		VERTEX_SHADER_TYPE = 0x8B31,
-		FRAGMENT_SHADER_TYPE = 0x8B30
+		FRAGMENT_SHADER_TYPE = 0x8B30,
+		COMPUTE_SHADER_TYPE = 0x91B9
 	} ShaderType;
 
 	//constructors/destructor
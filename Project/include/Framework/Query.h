@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Framework/Defaults.h>
+
+class Query
+{
+public:
+
+	//constructors/destructor
+	Query(unsigned int const & target);
+	~Query();
+
+	//public methods
+	void Initialize();
+	void Begin() const;
+	void End() const;
+	void Update() const;
+	void AcknowledgeResult() const;
+	void Free();
+
+	//getters
+	unsigned long long const & GetResult() const;
+	bool const & HasNewResult() const;
+
+private:
+
+	//queries cycle through a ring and are only read once available, the last result is kept until then
+	unsigned int m_target;
+	unsigned int m_handles[QUERY_RING_SIZE];
+	mutable unsigned int m_current;
+	mutable unsigned int m_oldest;
+	mutable bool m_pending[QUERY_RING_SIZE];
+	mutable unsigned long long m_result;
+	mutable bool m_newResult;
+
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Framework/Texture.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class RenderGraph
+{
+public:
+
+	friend class DeferredRenderer;
+
+	typedef unsigned int Resource;
+
+	struct TextureDescription
+	{
+		unsigned int width;
+		unsigned int height;
+		unsigned int internalFormat;
+		unsigned int format;
+		unsigned int type;
+
+		bool operator==(TextureDescription const & other) const
+		{
+			return width == other.width && height == other.height && internalFormat == other.internalFormat && format == other.format && type == other.type;
+		}
+	};
+
+	//constructors/destructor
+	RenderGraph();
+	~RenderGraph();
+
+	//public methods
+	void Reset();
+	Resource CreateTexture(std::string const & name, TextureDescription const & description, unsigned int const & unit);
+	Resource ImportResource(std::string const & name);
+	void AddPass(std::string const & name, std::vector<Resource> const & reads, std::vector<Resource> const & writes, std::function<void()> const & execute);
+	void MarkOutput(Resource const & resource);
+	void Compile();
+	void Execute() const;
+	void Free();
+
+	//getters
+	bool IsUsed(Resource const & resource) const;
+	unsigned int GetTextureHandle(Resource const & resource) const;
+	unsigned int GetExecutedPassesCount() const;
+	unsigned long long GetTransientMemory() const;
+	unsigned long long GetPooledMemory() const;
+
+private:
+
+	static unsigned long long GetTextureSize(TextureDescription const & description);
+
+	//textures owned elsewhere and buffers are imported, only transient textures are allocated by the graph
+	struct ResourceNode
+	{
+		std::string name;
+		bool transient;
+		bool output;
+		TextureDescription description;
+		unsigned int unit;
+		int firstPass;
+		int lastPass;
+		int physical;
+	};
+
+	struct PassNode
+	{
+		std::string name;
+		std::vector<Resource> reads;
+		std::vector<Resource> writes;
+		std::function<void()> execute;
+		bool culled;
+	};
+
+	//pooled textures outlive the frame, a transient target takes one whose previous user has finished
+	struct PhysicalTexture
+	{
+		Texture texture;
+		TextureDescription description;
+		bool available;
+		bool used;
+	};
+
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	std::vector<PhysicalTexture> m_pool;
+	std::vector<unsigned int> m_executionOrder;
+
+};
@@ -3,15 +3,19 @@
 #include "Camera.h"
 #include "Node.h"
 #include <glm/glm.hpp>
+#include <functional>
 #include <map>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 class Application;
 class Mesh;
 class Material;
 class IRenderPass;
 class Texture;
+class SceneSnapshot;
 
 class Scene
 {
@@ -40,6 +44,7 @@ public:
 
 	friend class IRenderer;
 	friend class GUI;
+	friend class Node;
 
 	//constructors/destructor
 	Scene(Application & application, unsigned const & windowWidth, unsigned const & windowHeight);
@@ -50,6 +55,8 @@ public:
 	Camera & GetCamera();
 	glm::mat4 const & GetProjectionMatrix() const;
 	glm::mat4 const & GetViewMatrix() const;
+	float const & GetFrontPlane() const;
+	float const & GetBackPlane() const;
 	glm::vec3 const & GetSceneSize() const;
 	glm::vec3 const & GetAmbientIntensity() const;
 
@@ -65,10 +72,9 @@ public:
 	Material * CreateMaterial(std::string const & name, glm::vec3 const & kd, glm::vec3 const & ks, float const & alpha);
 	Texture * CreateTexture(std::string const & name, std::string const & path, bool gamma = true);
 
-	std::string OpenFile(char const * filter);
+	void OpenFile(char const * filter, std::function<void(std::string const &)> const & opened);
 
 	void AddNode(Node * node);
-	void Traverse(IRenderPass const & pass) const;
 	void Resize(int const & width, int const & height);
 	void FreeMemory();
 
@@ -80,10 +86,15 @@ public:
 	void IncrementReference(Texture const * texture);
 	void DecrementReference(Texture const * texture);
 
+	//snapshots, published by the thread editing the scene and read by any other
+	std::shared_ptr<SceneSnapshot const> GetSnapshot() const;
+	void PublishSnapshot();
+
 private:
 
 	//private methods
-	void TraverseNode(Node * const & node, IRenderPass const & pass, glm::mat4 const & modelMatrix) const;
+	void Register(Node * node);
+	void MarkChanged(Node * node, bool const & content);
 
 	Application & m_application;
 
@@ -98,11 +109,18 @@ private:
 
 	glm::mat4 m_projectionMatrix;
 	glm::mat4 m_viewMatrix;
+	float m_frontPlane;
+	float m_backPlane;
 	glm::vec3 m_sceneSize;
 	glm::vec3 m_ambientIntensity;
 
 	unsigned m_windowWidth;
 	unsigned m_windowHeight;
 
+	//only accessed through std::atomic_load and std::atomic_store
+	std::shared_ptr<SceneSnapshot const> m_snapshot;
+	std::vector<Node *> m_changedNodes;
+	unsigned int m_slotsCount;
+
 };
 
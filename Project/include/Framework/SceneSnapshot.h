@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Framework/Defaults.h>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+class Node;
+class IRenderPass;
+
+//immutable render side copy of a scene, rendering and gathering read it without locks while the scene is edited
+class SceneSnapshot
+{
+public:
+
+	friend class Scene;
+
+	static unsigned int const NO_NODE = 0xFFFFFFFF;
+
+	//nodes are linked by slot, a changed node only replaces its own record
+	struct NodeRecord
+	{
+		std::shared_ptr<Node const> node;
+		unsigned int firstChild;
+		unsigned int nextSibling;
+	};
+
+	//chunks and pages are shared between versions, publishing copies only those on the way to a changed record
+	struct Chunk
+	{
+		NodeRecord records[SNAPSHOT_CHUNK_SIZE];
+	};
+
+	struct Page
+	{
+		std::shared_ptr<Chunk const> chunks[SNAPSHOT_PAGE_SIZE];
+	};
+
+	//constructors/destructor
+	SceneSnapshot();
+	~SceneSnapshot();
+
+	//public methods
+	void Traverse(IRenderPass const & pass) const;
+
+	//getters
+	Node const * GetNode(unsigned int const & slot) const;
+	unsigned long long const & GetVersion() const;
+	unsigned int const & GetNodesCount() const;
+	glm::mat4 const & GetViewMatrix() const;
+	glm::mat4 const & GetProjectionMatrix() const;
+
+	//statistical information about the publish that produced this version
+	unsigned int const & GetChangedNodesCount() const;
+	unsigned int const & GetCopiedChunksCount() const;
+	float const & GetPublishTime() const;
+
+private:
+
+	NodeRecord const & GetRecord(unsigned int const & slot) const;
+	void TraverseNode(unsigned int const & slot, IRenderPass const & pass, glm::mat4 const & modelMatrix, unsigned int const & bucket) const;
+
+	std::vector<std::shared_ptr<Page const>> m_pages;
+	unsigned int m_nodesCount;
+	unsigned long long m_version;
+
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+
+	unsigned int m_changedNodesCount;
+	unsigned int m_copiedChunksCount;
+	float m_publishTime;
+
+};
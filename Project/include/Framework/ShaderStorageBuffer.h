@@ -9,6 +9,8 @@ class ShaderStorageBuffer
 public:
 
 	friend class DeferredRenderer;
+	friend class ShadowPass;
+	friend class LightingPass;
 
 	//constructors/destructor
 	ShaderStorageBuffer(unsigned int const & binding, unsigned int sizeHint) : m_index(binding), m_buffer(sizeHint), m_bufferSize(sizeHint), m_handle(0)
@@ -30,6 +32,9 @@ public:
 
 	void Upload()
 	{
+		if (m_buffer.empty())
+			return;
+
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_handle);
 		if (m_buffer.size() > m_bufferSize)
 		{
@@ -41,6 +46,16 @@ public:
 		}
 	}
 
+	void Reserve(unsigned int const & size)
+	{
+		//grows the storage without uploading anything, for buffers that are only written on the gpu
+		if (size <= m_bufferSize)
+			return;
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_handle);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(T)*(m_bufferSize = size), 0, GL_DYNAMIC_DRAW);
+	}
+
 	void Free()
 	{
 		glDeleteBuffers(1, &m_handle);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+class ShadowAtlas
+{
+public:
+
+	struct Tile
+	{
+		unsigned int x;
+		unsigned int y;
+		unsigned int size;
+	};
+
+	//constructors/destructor
+	ShadowAtlas(unsigned int const & size, unsigned int const & minTileSize);
+	~ShadowAtlas();
+
+	//public methods
+	bool Allocate(unsigned int const & size, Tile & tile);
+	void Free(Tile const & tile);
+	void Clear();
+
+	//getters
+	unsigned int const & GetSize() const;
+	unsigned int const & GetMinTileSize() const;
+	unsigned int const & GetUsedArea() const;
+
+private:
+
+	typedef enum NodeState
+	{
+		FREE = 0,
+		SPLIT = 1,
+		USED = 2
+	} NodeState;
+
+	//private methods
+	unsigned int GetNodeIndex(unsigned int const & level, unsigned int const & x, unsigned int const & y) const;
+	bool AllocateNode(unsigned int const & level, unsigned int const & x, unsigned int const & y, unsigned int const & targetLevel, Tile & tile);
+
+	unsigned int m_size;
+	unsigned int m_minTileSize;
+	unsigned int m_levels;
+	unsigned int m_usedArea;
+
+	//complete quadtree stored level by level, level 0 is the whole atlas
+	std::vector<unsigned char> m_nodes;
+	std::vector<unsigned int> m_levelOffsets;
+
+};
@@ -2,13 +2,33 @@
 
 #include <Framework/IRenderPass.h>
 #include <Framework/Program.h>
+#include <Framework/ShaderStorageBuffer.h>
+#include <Framework/UniformBuffer.h>
+#include <Framework/Texture.h>
+#include <Framework/ShadowAtlas.h>
+#include <Framework/CommandBuffer.h>
+#include <Framework/Defaults.h>
 #include <vector>
+#include <unordered_map>
 
 class GlobalLight;
+class LocalLight;
+class Mesh;
+struct InstanceGroup;
+struct LocalLightInformation;
+struct LocalShadowInformation;
 
 class ShadowPass : public IRenderPass
 {
 public:
+
+	friend class DeferredRenderer;
+
+	typedef enum ShadowFilter
+	{
+		HARDWARE_FILTER = 0,
+		MOMENTS_FILTER = 1
+	} ShadowFilterType;
 	
 	//constructors/destructor
 	ShadowPass(IRenderer const * renderer);
@@ -17,18 +37,164 @@ public:
 	//public methods
 	void Initialize();
 	void Prepare(Scene const & scene) const;
-	void ProcessScene(Scene const & scene, std::vector<std::pair<GlobalLight const *,glm::vec3>> const & globalLights) const;
-	void ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix) const;
+	void ProcessScene(Scene const & scene, std::vector<std::pair<GlobalLight const *,glm::vec3>> const & globalLights, std::vector<struct LocalLightInformation> & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights, std::vector<struct InstanceGroup> const & instanceGroups) const;
+	void ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix, unsigned int const & bucket) const;
 	void Finalize();
 
 	//statistical information
 	unsigned int const & GetNumberOfProcessedLights() const;
+	unsigned int const & GetDrawCallsCount() const;
+	unsigned int const & GetTrianglesCount() const;
+	unsigned int const & GetCulledCastersCount() const;
+	unsigned int const & GetRenderedCascadesCount() const;
+	unsigned int const & GetCascadesCount() const;
+	unsigned int const & GetShadowedLocalLightsCount() const;
+	unsigned int const & GetDroppedLocalLightsCount() const;
+	unsigned int const & GetRenderedFacesCount() const;
+	unsigned int const & GetPendingFacesCount() const;
+
+	//getters
+	Texture const & GetShadowAtlas() const;
+	Texture const & GetMomentsAtlas() const;
+	int const & GetShadowFilter() const;
+	glm::vec2 const & GetMomentsExponents() const;
+	float const & GetLightBleedingReduction() const;
 
 private:
 
+	//a cascade of a global light or a cube face of a local light
+	struct ShadowView
+	{
+		GlobalLight const * light;
+		LocalLight const * localLight;
+		unsigned int index;
+		glm::mat4 viewMatrix;
+		glm::mat4 shadowMatrix;
+		glm::vec3 center;
+		float halfSize;
+		float extent;
+		ShadowAtlas::Tile tile;
+		glm::vec4 clipTile;
+		unsigned long long signature;
+		bool dirty;
+	};
+
+	struct CasterBatch
+	{
+		Mesh const * mesh;
+		unsigned int lod;
+		unsigned int offset;
+		unsigned int count;
+	};
+
+	//casters found by one worker, signatures are order independent sums of caster hashes per view
+	struct CasterChunk
+	{
+		std::vector<glm::uvec2> casters;
+		std::vector<CasterBatch> batches;
+		std::vector<unsigned long long> signatures;
+		unsigned int culledCount;
+	};
+
+	//signature of what was last rendered into each cascade, a cascade is only re-rendered when it changes
+	struct LightAllocation
+	{
+		ShadowAtlas::Tile tiles[SHADOW_CASCADE_COUNT];
+		unsigned int resolution;
+		unsigned long long signatures[SHADOW_CASCADE_COUNT];
+		unsigned int cacheHits;
+		unsigned int cacheLookups;
+		bool active;
+	};
+
+	//cache state of a shadowed local light, faces are rendered with the matrix they are sampled with
+	struct LocalShadow
+	{
+		ShadowAtlas::Tile tiles[6];
+		glm::mat4 faceMatrices[6];
+		unsigned long long signature;
+		unsigned int pendingFaces;
+		bool complete;
+		bool active;
+	};
+
+	//bounding sphere and hash of a caster, sorted by the grid cell its center lies in
+	struct LocalCaster
+	{
+		glm::vec3 center;
+		float radius;
+		unsigned long long hash;
+		unsigned long long cell;
+	};
+
+	//private methods
+	void AllocateTiles(std::vector<std::pair<GlobalLight const *, glm::vec3>> const & globalLights) const;
+	void ComputeCascadeSplits(Scene const & scene, float splits[SHADOW_CASCADE_COUNT + 1]) const;
+	ShadowView FitCascade(Scene const & scene, glm::mat4 const & cameraMatrix, glm::mat4 const & lightViewMatrix, float const & nearSplit, float const & farSplit, ShadowAtlas::Tile const & tile) const;
+	void AllocateLocalTiles(glm::vec3 const & eyePosition, std::vector<struct LocalLightInformation> const & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights) const;
+	void GatherLocalCasters(std::vector<struct InstanceGroup> const & instanceGroups, float const & cellSize) const;
+	void ScheduleLocalFaces(std::vector<struct LocalLightInformation> & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights, std::vector<struct InstanceGroup> const & instanceGroups) const;
+	void PublishLocalShadows(std::vector<struct LocalLightInformation> & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights) const;
+	void GatherCasters(std::vector<struct InstanceGroup> const & instanceGroups) const;
+	void DiscardCleanCasters() const;
+	void FilterMoments() const;
+
 	mutable std::vector<std::pair<GlobalLight const *, glm::vec3>> const * m_globalLights;
+	mutable unsigned int m_drawCallsCount;
+	mutable unsigned int m_trianglesCount;
+	mutable unsigned int m_culledCastersCount;
+	mutable unsigned int m_renderedCascadesCount;
+	mutable unsigned int m_cascadesCount;
+	mutable unsigned int m_shadowedLocalLightsCount;
+	mutable unsigned int m_droppedLocalLightsCount;
+	mutable unsigned int m_renderedFacesCount;
+	mutable unsigned int m_pendingFacesCount;
+
+	//every cascade and cube face of every shadowed light is one tile of the same depth texture
+	Texture m_shadowAtlas;
+	Texture m_atlasView;
+	mutable ShadowAtlas m_atlas;
+	//kept by slot, the lights are new copies whenever they are edited or moved
+	mutable std::unordered_map<unsigned int, LightAllocation> m_allocations;
+	mutable std::vector<std::pair<float, GlobalLight const *>> m_lightRanking;
+	mutable std::unordered_map<unsigned int, LocalShadow> m_localShadows;
+	mutable std::vector<std::pair<float, unsigned int>> m_localRanking;
+	mutable std::vector<unsigned int> m_localTileSizes;
+	mutable ShaderStorageBuffer<struct LocalShadowInformation> m_localShadowBuffer;
+
+	//prefiltered exponential variance moments of the cascades at half the atlas resolution
+	Texture m_momentsAtlas;
+	Texture m_blurTarget;
+
+	std::string m_viewMatrixNames[MAX_SHADOW_VIEWS];
+	std::string m_viewTileNames[MAX_SHADOW_VIEWS];
+
+	//(instance transform, view) pairs, each caster is submitted once for all the views it overlaps
+	mutable UniformBuffer m_viewUniformBuffer;
+	mutable ShaderStorageBuffer<glm::uvec2> m_casterBuffer;
+	mutable std::vector<CasterBatch> m_casterBatches;
+	mutable std::vector<CasterChunk> m_casterChunks;
+	mutable std::vector<unsigned long long> m_localSignatures;
+	mutable std::vector<LocalCaster> m_localCasters;
+	mutable std::unordered_map<unsigned long long, glm::uvec2> m_localCasterCells;
+	mutable std::vector<CommandBuffer> m_commandBuffers;
+	mutable std::vector<ShadowView> m_views;
+
+	int m_lodBias;
+	float m_shadowDistance;
+	float m_splitLambda;
+	float m_slopeBias;
+	float m_constantBias;
+	float m_atlasBudget;
+	int m_localFaceBudget;
+	int m_shadowFilter;
+	int m_blurRadius;
+	glm::vec2 m_momentsExponents;
+	float m_lightBleedingReduction;
 
 	Program m_shadowProgram;
+	Program m_momentsProgram;
+	Program m_blurProgram;
 
 };
 
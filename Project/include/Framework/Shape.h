@@ -17,6 +17,7 @@ public:
 	//static methods
 	static Shape * GetFullScreenQuad();
 	static Shape * GetIcosahedron();
+	static Shape * GetSphere();
 	static Shape * GetWireCircle();
 	static void FreeMemory();
 	
@@ -31,6 +32,7 @@ private:
 
 	static void GenerateScreenQuad(Shape * & shape);
 	static void GenerateIcosahedron(Shape * & shape);
+	static void GenerateSphere(Shape * & shape);
 	static void GenerateWireCircle(Shape * & shape);
 
 	struct Vertex {
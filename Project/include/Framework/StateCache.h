@@ -0,0 +1,33 @@
+#pragma once
+
+class StateCache
+{
+public:
+
+	//static methods
+	static void UseProgram(unsigned int const & program);
+	static void BindVertexArray(unsigned int const & vao);
+	static void BindTexture(unsigned int const & unit, unsigned int const & texture);
+	static void SelectTexture(unsigned int const & unit, unsigned int const & texture);
+	static void BindFramebuffer(unsigned int const & framebuffer);
+	static void BindReadFramebuffer(unsigned int const & framebuffer);
+	static void BindDrawFramebuffer(unsigned int const & framebuffer);
+	static void Enable(unsigned int const & capability);
+	static void Disable(unsigned int const & capability);
+	static void Disable(unsigned int const & capability, unsigned int const & index);
+	static void SetDepthMask(bool const & mask);
+	static void SetDepthFunc(unsigned int const & function);
+	static void SetCullFace(unsigned int const & face);
+
+	//deleted objects may be bound somewhere, and their names are reused
+	static void ForgetProgram(unsigned int const & program);
+	static void ForgetVertexArray(unsigned int const & vao);
+	static void ForgetTexture(unsigned int const & texture);
+	static void ForgetFramebuffer(unsigned int const & framebuffer);
+
+	//statistical information
+	static void ResetStatistics();
+	static unsigned int const & GetIssuedCallsCount();
+	static unsigned int const & GetFilteredCallsCount();
+
+};
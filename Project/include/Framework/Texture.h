@@ -21,7 +21,10 @@ public:
 
 	//public methods
 	void Initialize(unsigned int width, unsigned int height, unsigned int internalFormat, unsigned int format, unsigned int type, void * pixels);
+	void InitializeStorage(unsigned int width, unsigned int height, unsigned int internalFormat, unsigned int levels = 1);
+	void InitializeView(Texture const & source, unsigned int internalFormat);
 	void Bind() const;
+	void GenerateMipmaps() const;
 	void Free();
 
 	//getters
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Program.h"
+#include "ShaderStorageBuffer.h"
+#include <glm/glm.hpp>
+#include <chrono>
 
 class IRenderer;
 
@@ -16,7 +19,7 @@ public:
 
 	//public methods
 	void Initialize();
-	void Prepare() const;
+	void Prepare(glm::vec2 const & renderScale) const;
 	void ProcessFrame() const;
 	void Finalize();
 
@@ -35,5 +38,20 @@ private:
 	float m_gamma;
 	float m_exposure;
 
+	//frames rendered below the window resolution are upscaled bilinearly and sharpened
+	float m_sharpness;
+
+	//the exposure adapts to a log luminance histogram of the frame, built and reduced without leaving the gpu
+	mutable ShaderStorageBuffer<unsigned int> m_histogramBuffer;
+	mutable ShaderStorageBuffer<float> m_exposureBuffer;
+	Program m_histogramProgram;
+	Program m_adaptationProgram;
+	bool m_autoExposure;
+	float m_exposureKey;
+	float m_adaptationRate;
+	float m_minLogLuminance;
+	float m_maxLogLuminance;
+	mutable std::chrono::steady_clock::time_point m_lastAdaptation;
+
 };
 
@@ -22,6 +22,7 @@ public:
 
 	void SetUniform(std::string const & name, glm::mat4 const & matrix);
 	void SetUniform(std::string const & name, glm::mat3 const & matrix);
+	void SetUniform(std::string const & name, glm::vec4 const & vector);
 	void SetUniform(std::string const & name, glm::vec3 const & vector);
 	void SetUniform(std::string const & name, glm::vec2 const & vector);
 	void SetUniform(std::string const & name, float const & value);
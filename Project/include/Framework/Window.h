@@ -15,6 +15,7 @@ public:
 
 	//public methods
 	void MakeCurrent() const;
+	void ReleaseCurrent() const;
 	void SwapBuffers() const;
 	bool Create(int width, int height, char const * title);
 	void Destroy();
@@ -5,9 +5,11 @@
 #include <Framework/Shape.h>
 #include <Framework/Material.h>
 #include <Framework/Defaults.h>
+#include <Framework/JobSystem.h>
 #include <GL/glew.h>
 #include <Windows.h>
 #include <iostream>
+#include <thread>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl.h>
@@ -22,7 +24,7 @@ std::map<HWND, Application*> Application::s_applicationDictionary;
 
 #pragma region "Constructors/Destructor"
 
-Application::Application(IRenderer * renderer) : m_window(new Window(WndProcRouter)), m_scene(new Scene(*this, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT)), m_renderer(renderer), m_gui(new GUI()), m_input(new Input(this)), m_running(false), m_isPaused(false), m_width(DEFAULT_WINDOW_WIDTH), m_height(DEFAULT_WINDOW_HEIGHT)
+Application::Application(IRenderer * renderer) : m_window(new Window(WndProcRouter)), m_scene(new Scene(*this, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT)), m_renderer(renderer), m_gui(new GUI()), m_input(new Input(this)), m_running(false), m_isPaused(false), m_width(DEFAULT_WINDOW_WIDTH), m_height(DEFAULT_WINDOW_HEIGHT), m_frames(FRAME_QUEUE_SIZE), m_openFileRequest(), m_fileOpened()
 {
 
 }
@@ -41,9 +43,9 @@ Application::~Application()
 
 #pragma region "Public Methods"
 
-void Application::RenderFrame() const
+void Application::RenderFrame(FramePacket & packet) const
 {
-	m_renderer->RenderScene(*m_scene);
+	m_renderer->RenderScene(*m_scene, packet);
 }
 
 int Application::Run()
@@ -54,6 +56,9 @@ int Application::Run()
 
 	int retValue = 0;
 	m_running = true;
+
+	//one worker per core, the window and render threads both help with the jobs they wait for
+	JobSystem::Initialize();
 	
 	if (!m_window->Create(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT, "Deferred Rendering"))
 	{
@@ -64,29 +69,22 @@ int Application::Run()
 	else {
 		//register this application instance to handle m_window's WndProc
 		s_applicationDictionary[m_window->GetHandle()] = this;
-		m_window->MakeCurrent();
-	}
-	
-	//load opengl functions
-	if (m_running && glewInit() != GLEW_OK)
-	{
-		MessageBox(NULL, "Failed to initialize glew32", "Error!", MB_OK | MB_ICONHAND);
-		m_running = false;
-		retValue = 1;
 	}
 
-	//initialize the renderer
-	if (m_running && !m_renderer->Initialize())
+	//the render thread owns the context, the scene is loaded there before the first frame is gathered
+	std::thread renderThread;
+	if (m_running)
 	{
-		MessageBox(NULL, "Failed to initialize renderer", "Error!", MB_OK | MB_ICONHAND);
-		m_running = false;
-		retValue = 1;
-	}
+		std::promise<bool> initialized;
+		std::future<bool> initializedResult = initialized.get_future();
+		renderThread = std::thread(&Application::RenderLoop, this, std::ref(initialized));
 
-	m_gui->Initialize(*m_window);
-	m_input->Initialize();
-	
-	Initialize();
+		if (!initializedResult.get())
+		{
+			m_running = false;
+			retValue = 1;
+		}
+	}
 
 	MSG msg;
 	std::memset(&msg, 0, sizeof(MSG));
@@ -99,64 +97,65 @@ int Application::Run()
 			DispatchMessage(&msg);
 		}
 
-		m_input->Update();
+		if (m_isPaused || !m_running)
+			continue;
 
-		if (!m_isPaused)
-		{
-			m_gui->NewFrame(m_width, m_height);
+		//blocks while every packet is in flight, which bounds how far input runs ahead of the display
+		FramePacket * packet = m_frames.BeginPacket();
+		if (!packet)
+			break;
 
-			//render a frame
-			RenderFrame();
+		packet->width = m_width;
+		packet->height = m_height;
+		packet->hasInput = m_input->TakeEvents(packet->inputEvents, packet->inputTime);
 
-			//render gui
-			m_gui->GenerateGUI(*m_scene);
-			m_renderer->GenerateGUI();
-			m_gui->EndFrame();
+		//gathers from the last published snapshot, the render thread keeps editing the scene meanwhile
+		m_renderer->PrepareFrame(*m_scene, *packet);
 
-			//swap window's back and front buffers
-			m_window->SwapBuffers();
-		}
+		m_frames.SubmitPacket(packet);
 	}
 
-	//finalize renderer and destroy window
-	Shape::FreeMemory();
-	m_input->Finalize();
-	m_gui->Finalize();
-	m_scene->FreeMemory();
-	m_renderer->Finalize();
+	m_frames.Close();
+	if (renderThread.joinable())
+		renderThread.join();
+
 	m_window->Destroy();
+	JobSystem::Finalize();
 
 	return retValue;
 }
 
-std::string Application::OpenFile(char const * filter)
+void Application::OpenFile(char const * filter, std::function<void(std::string const &)> const & opened)
 {
-	m_isPaused = true;
-
-	char szFile[100];
-
-	OPENFILENAME ofn;
-	ZeroMemory(&ofn, sizeof(ofn));
-	ofn.lStructSize = sizeof(ofn);
-	ofn.hwndOwner = NULL;
-	ofn.lpstrFile = szFile;
-	ofn.lpstrFile[0] = '\0';
-	ofn.nMaxFile = sizeof(szFile);
-	ofn.lpstrFilter = filter;
-	ofn.nFilterIndex = 1;
-	ofn.lpstrFileTitle = NULL;
-	ofn.nMaxFileTitle = 0;
-	ofn.lpstrInitialDir = NULL;
-	ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
-
-	if (GetOpenFileName(&ofn))
-	{
-		m_isPaused = false;
-		return std::string(szFile);
-	}
+	if (m_openFileRequest.valid())
+		return;
 
-	m_isPaused = false;
-	return "";
+	//the dialog blocks until it is closed, frames keep going meanwhile, destroying its owner window closes it
+	HWND const owner = m_window->GetHandle();
+	m_openFileRequest = std::async(std::launch::async, [filter, owner]()
+	{
+		char szFile[100];
+
+		OPENFILENAME ofn;
+		ZeroMemory(&ofn, sizeof(ofn));
+		ofn.lStructSize = sizeof(ofn);
+		ofn.hwndOwner = owner;
+		ofn.lpstrFile = szFile;
+		ofn.lpstrFile[0] = '\0';
+		ofn.nMaxFile = sizeof(szFile);
+		ofn.lpstrFilter = filter;
+		ofn.nFilterIndex = 1;
+		ofn.lpstrFileTitle = NULL;
+		ofn.nMaxFileTitle = 0;
+		ofn.lpstrInitialDir = NULL;
+		ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
+
+		if (GetOpenFileName(&ofn))
+			return std::string(szFile);
+		return std::string();
+	});
+
+	m_fileOpened = opened;
 }
 
 float Application::dt() const
@@ -227,6 +226,7 @@ void Application::Initialize()
 
 	LocalLight * localLight1 = new LocalLight("local1", glm::vec3(4, 0, 0), 1.0f);
 	localLight1->SetTranslation(glm::vec3(-2.0f, 1.0f, 0));
+	localLight1->SetCastShadows(true);
 	m_scene->AddNode(localLight1);
 
 	LocalLight * localLight2 = new LocalLight("local2", glm::vec3(0, 4, 0), 1.0f);
@@ -285,7 +285,6 @@ void Application::MouseScrolled(int delta)
 
 LRESULT Application::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
-	ImGuiIO & io = ImGui::GetIO();
 	switch (msg)
 	{
 	case WM_CLOSE:
@@ -321,18 +320,11 @@ LRESULT Application::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		break;
 	case WM_EXITSIZEMOVE:
 		m_isPaused = false;
-		m_renderer->Resize(m_width, m_height);
-		m_scene->Resize(m_width, m_height);
 		break;
 	case WM_SIZE:
+		//the render thread resizes once a packet carries the new size
 		m_width = LOWORD(lParam);
 		m_height = HIWORD(lParam);
-
-		if (wParam == SIZE_MAXIMIZED || wParam == SIZE_RESTORED)
-		{
-			m_renderer->Resize(m_width, m_height);
-			m_scene->Resize(m_width, m_height);
-		}
 		break;
 	case WM_CHAR:
 		m_input->CharInput(wParam);
@@ -344,6 +336,92 @@ LRESULT Application::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	return 0;
 }
 
+void Application::RenderLoop(std::promise<bool> & initialized)
+{
+	m_window->MakeCurrent();
+
+	//load opengl functions
+	if (glewInit() != GLEW_OK)
+	{
+		MessageBox(NULL, "Failed to initialize glew32", "Error!", MB_OK | MB_ICONHAND);
+		m_window->ReleaseCurrent();
+		initialized.set_value(false);
+		return;
+	}
+
+	//initialize the renderer
+	if (!m_renderer->Initialize())
+	{
+		MessageBox(NULL, "Failed to initialize renderer", "Error!", MB_OK | MB_ICONHAND);
+		m_window->ReleaseCurrent();
+		initialized.set_value(false);
+		return;
+	}
+
+	m_gui->Initialize(*m_window);
+	m_input->Initialize();
+
+	Initialize();
+	m_scene->PublishSnapshot();
+	initialized.set_value(true);
+
+	int width = DEFAULT_WINDOW_WIDTH;
+	int height = DEFAULT_WINDOW_HEIGHT;
+
+	while (FramePacket * packet = m_frames.AcquirePacket())
+	{
+		//a minimized window reports no size, the last one is kept
+		if ((packet->width != width || packet->height != height) && packet->width > 0 && packet->height > 0)
+		{
+			width = packet->width;
+			height = packet->height;
+			m_renderer->Resize(width, height);
+			m_scene->Resize(width, height);
+		}
+
+		m_input->ApplyEvents(packet->inputEvents);
+		m_input->Update();
+		m_gui->NewFrame(width, height);
+
+		//render a frame
+		RenderFrame(*packet);
+
+		//render gui
+		CompleteOpenFileRequest();
+		m_gui->GenerateGUI(*m_scene, m_frames);
+		m_renderer->GenerateGUI();
+		m_gui->EndFrame();
+
+		//the edits of this frame become visible to the window thread at once
+		m_scene->PublishSnapshot();
+
+		//swap window's back and front buffers
+		m_window->SwapBuffers();
+		m_frames.ReleasePacket(packet);
+	}
+
+	//finalize renderer and release the context for the window to destroy it
+	Shape::FreeMemory();
+	m_input->Finalize();
+	m_gui->Finalize();
+	m_scene->FreeMemory();
+	m_renderer->Finalize();
+	m_window->ReleaseCurrent();
+}
+
+void Application::CompleteOpenFileRequest()
+{
+	if (!m_openFileRequest.valid() || m_openFileRequest.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	//get leaves the future empty, the next dialog may be opened from the callback
+	std::string const path = m_openFileRequest.get();
+	std::function<void(std::string const &)> const opened = m_fileOpened;
+	m_fileOpened = nullptr;
+	if (path != "")
+		opened(path);
+}
+
 #pragma endregion
 
 #pragma region "Static Functions"
@@ -0,0 +1,150 @@
+#include <Framework/CommandBuffer.h>
+#include <Framework/Program.h>
+#include <Framework/StateCache.h>
+
+#include <GL/glew.h>
+
+#pragma region "Constructors/Destructor"
+
+CommandBuffer::CommandBuffer() : m_commands(), m_drawsCount(0), m_trianglesCount(0)
+{
+
+}
+
+CommandBuffer::~CommandBuffer()
+{
+
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+void CommandBuffer::Clear()
+{
+	//the storage is kept, buffers are recorded again every frame
+	m_commands.clear();
+	m_drawsCount = 0;
+	m_trianglesCount = 0;
+}
+
+void CommandBuffer::UseProgram(Program const & program)
+{
+	Command command(USE_PROGRAM, nullptr);
+	command.program = &program;
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::BindVertexArray(unsigned int const & vao)
+{
+	Command command(BIND_VERTEX_ARRAY, nullptr);
+	command.arguments[0] = vao;
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::BindTexture(unsigned int const & unit, unsigned int const & texture)
+{
+	Command command(BIND_TEXTURE, nullptr);
+	command.arguments[0] = unit;
+	command.arguments[1] = texture;
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::SetUniform(char const * name, int const & value)
+{
+	Command command(SET_UNIFORM_INT, name);
+	command.integer = value;
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::SetUniform(char const * name, bool const & value)
+{
+	Command command(SET_UNIFORM_BOOL, name);
+	command.boolean = value;
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::SetUniform(char const * name, float const & value)
+{
+	Command command(SET_UNIFORM_FLOAT, name);
+	command.scalar = value;
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::SetUniform(char const * name, glm::vec3 const & vector)
+{
+	Command command(SET_UNIFORM_VEC3, name);
+	command.vector[0] = vector.x;
+	command.vector[1] = vector.y;
+	command.vector[2] = vector.z;
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::DrawIndexed(unsigned int const & indexCount, unsigned int const & firstIndex, unsigned int const & instanceCount)
+{
+	Command command(DRAW_INDEXED, nullptr);
+	command.arguments[0] = indexCount;
+	command.arguments[1] = firstIndex;
+	command.arguments[2] = instanceCount;
+	m_commands.push_back(command);
+
+	m_drawsCount++;
+	m_trianglesCount += indexCount / 3 * instanceCount;
+}
+
+void CommandBuffer::Replay() const
+{
+	Program const * program = nullptr;
+	for (auto const & command : m_commands)
+	{
+		switch (command.kind)
+		{
+		case USE_PROGRAM:
+			program = command.program;
+			program->Use();
+			break;
+		case BIND_VERTEX_ARRAY:
+			StateCache::BindVertexArray(command.arguments[0]);
+			break;
+		case BIND_TEXTURE:
+			StateCache::BindTexture(command.arguments[0], command.arguments[1]);
+			break;
+		case SET_UNIFORM_INT:
+			program->SetUniform(command.name, command.integer);
+			break;
+		case SET_UNIFORM_BOOL:
+			program->SetUniform(command.name, command.boolean);
+			break;
+		case SET_UNIFORM_FLOAT:
+			program->SetUniform(command.name, command.scalar);
+			break;
+		case SET_UNIFORM_VEC3:
+			program->SetUniform(command.name, glm::vec3(command.vector[0], command.vector[1], command.vector[2]));
+			break;
+		case DRAW_INDEXED:
+			glDrawElementsInstanced(GL_TRIANGLES, command.arguments[0], GL_UNSIGNED_INT, (GLvoid*)(sizeof(unsigned int) * command.arguments[1]), command.arguments[2]);
+			break;
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region "Statistical Information"
+
+unsigned int CommandBuffer::GetCommandsCount() const
+{
+	return (unsigned int)m_commands.size();
+}
+
+unsigned int const & CommandBuffer::GetDrawsCount() const
+{
+	return m_drawsCount;
+}
+
+unsigned int const & CommandBuffer::GetTrianglesCount() const
+{
+	return m_trianglesCount;
+}
+
+#pragma endregion
@@ -1,19 +1,23 @@
 #include <Framework/DeferredPass.h>
 #include <Framework/DeferredRenderer.h>
 #include <Framework/Scene.h>
+#include <Framework/SceneSnapshot.h>
 #include <Framework/Object.h>
 #include <Framework/GlobalLight.h>
 #include <Framework/LocalLight.h>
 #include <Framework/Material.h>
 #include <Framework/Mesh.h>
+#include <Framework/StateCache.h>
+#include <Framework/JobSystem.h>
 
 #include <Framework/Defaults.h>
 
 #include <GL/glew.h>
+#include <cmath>
 
 #pragma region "Constructors/Destructor"
 
-DeferredPass::DeferredPass(IRenderer const * renderer) : IRenderPass(renderer), m_globalLights(nullptr), m_localLights(nullptr), m_reflectiveObjects(nullptr), m_deferredProgram()
+DeferredPass::DeferredPass(IRenderer const * renderer) : IRenderPass(renderer), m_reflectiveObjects(nullptr), m_buckets(), m_instanceGroupIndices(), m_viewMatrix(), m_projectionScale(1.0f), m_levelsOfDetail(), m_lodScreenSize(0.5f), m_lodHysteresis(0.25f), m_objectsCount(0), m_drawCallsCount(0), m_trianglesCount(0), m_commandBuffers(), m_deferredProgram()
 {
 }
 
@@ -41,24 +45,84 @@ void DeferredPass::Prepare(Scene const & scene) const
 {
 	//bind g-buffer;
 	dynamic_cast<DeferredRenderer const *>(m_renderer)->BindGBuffer();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	StateCache::Disable(GL_BLEND);
+	StateCache::Enable(GL_DEPTH_TEST);
 
 	m_deferredProgram.Use();
 }
 
-void DeferredPass::ProcessScene(Scene const & scene, std::vector<std::pair<GlobalLight const *, glm::vec3>> * globalLights, std::vector<struct LocalLightInformation> * localLights, std::vector<Object const *> * reflectiveObjects) const
+void DeferredPass::ProcessScene(SceneSnapshot const & snapshot, std::vector<std::pair<GlobalLight const *, glm::vec3>> * globalLights, std::vector<struct LocalLightInformation> * localLights, std::vector<std::pair<LocalLight const *, unsigned int>> * shadowedLocalLights, std::vector<Object const *> * reflectiveObjects, std::vector<struct InstanceGroup> * instanceGroups, std::vector<glm::mat4> * instanceTransforms) const
 {
-	m_globalLights = globalLights;
-	m_localLights = localLights;
 	m_reflectiveObjects = reflectiveObjects;
-	scene.Traverse(*this);
+	m_instanceGroupIndices.clear();
+	m_objectsCount = 0;
+
+	m_viewMatrix = snapshot.GetViewMatrix();
+	m_projectionScale = snapshot.GetProjectionMatrix()[1][1];
+
+	//slots are never reused, new objects start at the finest level
+	if (m_levelsOfDetail.size() < snapshot.GetNodesCount())
+		m_levelsOfDetail.resize(snapshot.GetNodesCount(), 0);
+
+	snapshot.Traverse(*this);
+
+	//buckets are merged in traversal order, which keeps the order of the lights and groups stable from frame to frame
+	for (auto & bucket : m_buckets)
+	{
+		unsigned int const localLightsOffset = localLights->size();
+		globalLights->insert(globalLights->end(), bucket.globalLights.begin(), bucket.globalLights.end());
+		localLights->insert(localLights->end(), bucket.localLights.begin(), bucket.localLights.end());
+		for (auto const & lightPair : bucket.shadowedLocalLights)
+			shadowedLocalLights->push_back(std::make_pair(lightPair.first, lightPair.second + localLightsOffset));
+
+		//groups found by several chunks are joined
+		for (auto & group : bucket.instanceGroups)
+		{
+			std::tuple<Mesh const *, Material const *, unsigned int> key(group.mesh, group.material, group.lod);
+			auto groupIndex = m_instanceGroupIndices.find(key);
+			if (groupIndex == m_instanceGroupIndices.end())
+			{
+				m_instanceGroupIndices.insert(std::make_pair(key, instanceGroups->size()));
+				instanceGroups->push_back(std::move(group));
+			}
+			else
+			{
+				std::vector<glm::mat4> & modelMatrices = (*instanceGroups)[groupIndex->second].modelMatrices;
+				modelMatrices.insert(modelMatrices.end(), group.modelMatrices.begin(), group.modelMatrices.end());
+			}
+		}
+
+		m_objectsCount += bucket.objectsCount;
+	}
+
+	//lay out the transforms of every group contiguously in the instance buffer
+	for (auto & group : *instanceGroups)
+	{
+		group.offset = instanceTransforms->size();
+		instanceTransforms->insert(instanceTransforms->end(), group.modelMatrices.begin(), group.modelMatrices.end());
+	}
 }
 
-void DeferredPass::ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix) const
+void DeferredPass::PrepareTraversal(unsigned int const & bucketsCount) const
 {
+	m_buckets.resize(bucketsCount);
+	for (auto & bucket : m_buckets)
+	{
+		bucket.globalLights.clear();
+		bucket.localLights.clear();
+		bucket.shadowedLocalLights.clear();
+		bucket.instanceGroups.clear();
+		bucket.instanceGroupIndices.clear();
+		bucket.objectsCount = 0;
+	}
+}
+
+void DeferredPass::ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix, unsigned int const & bucket) const
+{
+	GatherBucket & gathered = m_buckets[bucket];
+
 	if (node->GetNodeType() == Node::OBJECT_NODE)
 	{
 		Object const * object = dynamic_cast<Object const *>(node);
@@ -69,56 +133,24 @@ void DeferredPass::ProcessNode(Node const * const & node, glm::mat4 const & mode
 			m_reflectiveObjects->push_back(object);
 		*/
 
-		m_deferredProgram.SetUniform("uModelMatrix", modelMatrix);
-		m_deferredProgram.SetUniform("uMaterial.kd", object->GetMaterial()->GetKd());
-		m_deferredProgram.SetUniform("uMaterial.ks", object->GetMaterial()->GetKs());
-		m_deferredProgram.SetUniform("uMaterial.alpha", object->GetMaterial()->GetAlpha());
-
-		if (object->GetMaterial()->HasDiffuseMap())
-		{
-			m_deferredProgram.SetUniform("uMaterial.hasDiffuseMap", true);
-			glActiveTexture(DIFFUSE_MAP_TEXTURE_UNIT);
-			glBindTexture(GL_TEXTURE_2D, object->GetMaterial()->GetDiffuseMap()->GetHandle());
-		}
-		else
-			m_deferredProgram.SetUniform("uMaterial.hasDiffuseMap", false);
-
-		if (object->GetMaterial()->HasNormalMap())
-		{
-			m_deferredProgram.SetUniform("uMaterial.hasNormalMap", true);
-			glActiveTexture(NORMAL_MAP_TEXTURE_UNIT);
-			glBindTexture(GL_TEXTURE_2D, object->GetMaterial()->GetNormalMap()->GetHandle());
-		}
-		else
-			m_deferredProgram.SetUniform("uMaterial.hasNormalMap", false);
-
-		if (object->GetMaterial()->HasSpecularMap())
+		//objects sharing a mesh, a material and a level of detail are drawn together in a single instanced call
+		unsigned int const lod = SelectLevelOfDetail(object, modelMatrix);
+		std::tuple<Mesh const *, Material const *, unsigned int> key(object->GetMesh(), object->GetMaterial(), lod);
+		auto groupIndex = gathered.instanceGroupIndices.find(key);
+		if (groupIndex == gathered.instanceGroupIndices.end())
 		{
-			m_deferredProgram.SetUniform("uMaterial.hasSpecularMap", true);
-			glActiveTexture(SPECULAR_MAP_TEXTURE_UNIT);
-			glBindTexture(GL_TEXTURE_2D, object->GetMaterial()->GetSpecularMap()->GetHandle());
+			groupIndex = gathered.instanceGroupIndices.insert(std::make_pair(key, gathered.instanceGroups.size())).first;
+			gathered.instanceGroups.push_back({ object->GetMesh(), object->GetMaterial(), lod, std::vector<glm::mat4>(), 0 });
 		}
-		else
-			m_deferredProgram.SetUniform("uMaterial.hasSpecularMap", false);
-
-
-		glBindVertexArray(object->GetMesh()->GetVAO());
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
-		glEnableVertexAttribArray(3);
-		glDrawArrays(GL_TRIANGLES, 0, object->GetMesh()->GetVertexCount());
-		glDisableVertexAttribArray(3);
-		glDisableVertexAttribArray(2);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(0);
 
+		gathered.instanceGroups[groupIndex->second].modelMatrices.push_back(modelMatrix);
+		gathered.objectsCount++;
 	}
 	else if (node->GetNodeType() == Node::GLOBAL_LIGHT_NODE)
 	{
 		GlobalLight const * light = dynamic_cast<GlobalLight const *>(node);
 		glm::vec3 position(modelMatrix[3][0], modelMatrix[3][1], modelMatrix[3][2]);
-		m_globalLights->push_back(std::make_pair(light, position));
+		gathered.globalLights.push_back(std::make_pair(light, position));
 			
 	}
 	else if (node->GetNodeType() == Node::LOCAL_LIGHT_NODE)
@@ -126,7 +158,57 @@ void DeferredPass::ProcessNode(Node const * const & node, glm::mat4 const & mode
 		LocalLight const * light = dynamic_cast<LocalLight const*>(node);
 		glm::vec3 position(modelMatrix[3][0], modelMatrix[3][1], modelMatrix[3][2]);
 		glm::vec3 const & intensity = light->GetIntensity();
-		m_localLights->push_back({ {position.x, position.y, position.z, 0.0f}, {intensity.x, intensity.y, intensity.z}, light->GetRadius() });
+		//the shadow pass fills in the shadow index of the lights that get shadows this frame
+		if (light->GetCastShadows())
+			gathered.shadowedLocalLights.push_back(std::make_pair(light, (unsigned int)gathered.localLights.size()));
+		gathered.localLights.push_back({ {position.x, position.y, position.z, 0.0f}, {intensity.x, intensity.y, intensity.z}, light->GetRadius(), -1, {0.0f, 0.0f, 0.0f} });
+	}
+}
+
+void DeferredPass::ProcessInstanceGroups(std::vector<struct InstanceGroup> const & instanceGroups) const
+{
+	//workers record the draws of disjoint ranges of groups, replaying the buffers in order keeps the submission order
+	m_commandBuffers.resize(JobSystem::GetChunksCount(instanceGroups.size(), INSTANCE_GROUPS_PER_CHUNK));
+	JobSystem::ParallelFor(instanceGroups.size(), INSTANCE_GROUPS_PER_CHUNK, [this, &instanceGroups](unsigned int chunk, unsigned int begin, unsigned int end)
+	{
+		CommandBuffer & commands = m_commandBuffers[chunk];
+		commands.Clear();
+		commands.UseProgram(m_deferredProgram);
+
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			InstanceGroup const & group = instanceGroups[i];
+			Material const * material = group.material;
+
+			commands.SetUniform("uInstanceOffset", (int)group.offset);
+			commands.SetUniform("uMaterial.kd", material->GetKd());
+			commands.SetUniform("uMaterial.ks", material->GetKs());
+			commands.SetUniform("uMaterial.alpha", material->GetAlpha());
+
+			commands.SetUniform("uMaterial.hasDiffuseMap", material->HasDiffuseMap());
+			if (material->HasDiffuseMap())
+				commands.BindTexture(DIFFUSE_MAP_TEXTURE_UNIT, material->GetDiffuseMap()->GetHandle());
+
+			commands.SetUniform("uMaterial.hasNormalMap", material->HasNormalMap());
+			if (material->HasNormalMap())
+				commands.BindTexture(NORMAL_MAP_TEXTURE_UNIT, material->GetNormalMap()->GetHandle());
+
+			commands.SetUniform("uMaterial.hasSpecularMap", material->HasSpecularMap());
+			if (material->HasSpecularMap())
+				commands.BindTexture(SPECULAR_MAP_TEXTURE_UNIT, material->GetSpecularMap()->GetHandle());
+
+			commands.BindVertexArray(group.mesh->GetVAO());
+			commands.DrawIndexed(group.mesh->GetIndexCount(group.lod), group.mesh->GetIndexOffset(group.lod), group.modelMatrices.size());
+		}
+	});
+
+	m_drawCallsCount = 0;
+	m_trianglesCount = 0;
+	for (auto const & commands : m_commandBuffers)
+	{
+		commands.Replay();
+		m_drawCallsCount += commands.GetDrawsCount();
+		m_trianglesCount += commands.GetTrianglesCount();
 	}
 }
 
@@ -137,6 +219,38 @@ void DeferredPass::Finalize()
 
 #pragma endregion
 
+#pragma region "Private Methods"
+
+unsigned int DeferredPass::SelectLevelOfDetail(Object const * object, glm::mat4 const & modelMatrix) const
+{
+	Mesh const * mesh = object->GetMesh();
+	unsigned int const levels = mesh->GetLevelCount();
+	if (levels <= 1)
+		return 0;
+
+	//project the world-space bounding sphere to get its size relative to the viewport height
+	glm::vec3 const center(modelMatrix * glm::vec4(mesh->GetBoundingSphereCenter(), 1.0f));
+	float const scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	float const radius = mesh->GetBoundingSphereRadius() * scale;
+	float const distance = -(m_viewMatrix * glm::vec4(center, 1.0f)).z;
+
+	float level = 0.0f;
+	if (distance > radius)
+		level = std::log2(m_lodScreenSize / (radius * m_projectionScale / distance));
+
+	//only switch once the ideal level leaves the current one by more than the hysteresis margin
+	//every node is visited by a single worker, so each slot has only one writer
+	unsigned char & lod = m_levelsOfDetail[object->GetSlot()];
+	unsigned int current = glm::min((unsigned int)lod, levels - 1);
+	if (level < (float)current - m_lodHysteresis || level > (float)current + 1.0f + m_lodHysteresis)
+		current = (unsigned int)glm::clamp((int)std::floor(level), 0, (int)levels - 1);
+
+	lod = (unsigned char)current;
+	return current;
+}
+
+#pragma endregion
+
 #pragma region "Getters"
 
 Program const & DeferredPass::GetProgram() const
@@ -144,4 +258,23 @@ Program const & DeferredPass::GetProgram() const
 	return m_deferredProgram;
 }
 
+#pragma endregion
+
+#pragma region "Statistical Information"
+
+unsigned int const & DeferredPass::GetObjectsCount() const
+{
+	return m_objectsCount;
+}
+
+unsigned int const & DeferredPass::GetDrawCallsCount() const
+{
+	return m_drawCallsCount;
+}
+
+unsigned int const & DeferredPass::GetTrianglesCount() const
+{
+	return m_trianglesCount;
+}
+
 #pragma endregion
\ No newline at end of file
@@ -6,13 +6,22 @@
 #include <Framework/Object.h>
 #include <Framework/Material.h>
 #include <Framework/Shape.h>
+#include <Framework/StateCache.h>
+#include <Framework/JobSystem.h>
+#include <Framework/FrameQueue.h>
+#include <Framework/SceneSnapshot.h>
 #include <Framework/LocalLight.h>
+#include <Framework/GlobalLight.h>
 
 #include <imgui/imgui.h>
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 
 #include <Framework/Defaults.h>
 
+static GLenum const g_accumulationFormats[3] = { GL_R11F_G11F_B10F, GL_RGBA16F, GL_RGBA32F };
+
 #pragma region "Constructors/Destructor"
 
 DeferredRenderer::DeferredRenderer() : m_gBuffer({ 0, Texture(GBUFFER_COLOR_BUFFER0_UNIT, Texture::POSITIONS), 
@@ -20,16 +29,38 @@ DeferredRenderer::DeferredRenderer() : m_gBuffer({ 0, Texture(GBUFFER_COLOR_BUFF
 														Texture(GBUFFER_COLOR_BUFFER2_UNIT), 
 														Texture(GBUFFER_COLOR_BUFFER3_UNIT),
 														Texture(GBUFFER_DEPTH_BUFFER_UNIT), 0, 0, {0, 0, 0, 0} }), 
-										m_shadowBuffer({ 0, 0, 0, 0, 0 }), 
-										m_lightAccumulationBuffer({0, Texture(LIGHT_ACCUMULATION_BUFFER_UNIT), 0, 0, 0}),
+										m_shadowBuffer({ 0, 0, 0 }), 
+										m_lightAccumulationBuffer({0, Texture(LIGHT_ACCUMULATION_BUFFER_UNIT),
+																	{ Texture(HISTORY_BUFFER0_UNIT), Texture(HISTORY_BUFFER1_UNIT) },
+																	{ Texture(HISTORY_NORMALS0_UNIT), Texture(HISTORY_NORMALS1_UNIT) }, 0, 0, 0, RGBA32F_FORMAT }),
+										m_referenceAccumulationBuffer({ 0 }),
+										m_accumulationPrecision({ R11G11B10F_FORMAT, false, true, false, 1.0f, 0.1f, 0.0f, 0.0f, 0, nullptr }),
+										m_renderingReference(false),
+										m_errorBuffer(9, 1),
+										m_errorProgram(),
+										m_reducedLightingBuffer({ 0, {0, 0, 0, 0, 0} }),
+										m_dynamicResolution({ false, 16.6f, 0.5f, 1.0f, 1.0f, 0.0f, 0, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT }),
+										m_renderGraph(),
+										m_framebufferState({ {}, {}, 0 }),
 										m_defaultFramebuffer({ 0, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT, GL_BACK_LEFT }), 
 										m_sceneUniformBuffer(0), 
 										m_localLightsBuffer(1, 1000), 
+										m_instanceBuffer(2, 1000), 
+										m_snapshot(), 
+										m_globalLights(), 
+										m_shadowedLocalLights(), 
+										m_instanceGroups(), 
+										m_objectsCount(0), 
 										m_debugProgram(), 
 										m_deferredPass(this), 
 										m_shadowPass(this), 
 										m_lightingPass(this),
 										m_toneMappingPass(this),
+										m_geometryTimer(GL_TIME_ELAPSED),
+										m_shadowTimer(GL_TIME_ELAPSED),
+										m_globalLightingTimer(GL_TIME_ELAPSED),
+										m_localLightingTimer(GL_TIME_ELAPSED),
+										m_localLightingTimes{ 0.0, 0.0, 0.0 },
 										m_gatherStatistics(false), 
 										m_displayLightVolumes(false)
 {
@@ -48,14 +79,23 @@ bool DeferredRenderer::Initialize()
 {
 	//generate framebuffers
 	CreateGBuffer(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
-	CreateShadowBuffer(DEFAULT_SHADOW_WIDTH, DEFAULT_SHADOW_HEIGHT);
+	CreateShadowBuffer(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE);
 	CreateLightAccumulationBuffer(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+	CreateReducedLightingBuffer();
 	
 	m_debugProgram.CreateHandle();
 	m_debugProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/DebugPass.vert");
 	m_debugProgram.AttachShader(Program::FRAGMENT_SHADER_TYPE, "src/Shaders/DebugPass.frag");
 	m_debugProgram.Link();
 
+	m_errorProgram.CreateHandle();
+	m_errorProgram.AttachShader(Program::COMPUTE_SHADER_TYPE, "src/Shaders/AccumulationError.comp");
+	m_errorProgram.Link();
+
+	m_errorProgram.SetUniform("uAccumulation", 6);
+	m_errorProgram.SetUniform("uReference", 26);
+	m_errorBuffer.Initialize();
+
 	//initialize uniform buffer
 	m_sceneUniformBuffer.AddUniform("uScene.ProjectionMatrix", GL_FLOAT_MAT4);
 	m_sceneUniformBuffer.AddUniform("uScene.ViewMatrix", GL_FLOAT_MAT4);
@@ -67,27 +107,70 @@ bool DeferredRenderer::Initialize()
 	//initialize local lights buffer
 	m_localLightsBuffer.Initialize();
 
+	//initialize instance transforms buffer
+	m_instanceBuffer.Initialize();
+
 	//initialize passes
 	m_deferredPass.Initialize();
 	m_shadowPass.Initialize();
 	m_lightingPass.Initialize();
 	m_toneMappingPass.Initialize();
 
+	//initialize timers
+	m_geometryTimer.Initialize();
+	m_shadowTimer.Initialize();
+	m_globalLightingTimer.Initialize();
+	m_localLightingTimer.Initialize();
+
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-	glEnable(GL_CULL_FACE);
+	StateCache::Enable(GL_CULL_FACE);
 	return true;
 }
 
-void DeferredRenderer::RenderScene(Scene const & scene) const
+void DeferredRenderer::PrepareFrame(Scene const & scene, FramePacket & packet) const
 {
-	static std::vector<std::pair<GlobalLight const *, glm::vec3>> globalLights(100);
-	static std::vector<Object const *> reflectiveObjects(1000);
+	//the packet keeps the snapshot alive while it is in flight
+	packet.snapshot = scene.GetSnapshot();
+	m_deferredPass.ProcessScene(*packet.snapshot, &packet.globalLights, &packet.localLights, &packet.shadowedLocalLights, nullptr, &packet.instanceGroups, &packet.instanceTransforms);
+	packet.objectsCount = m_deferredPass.GetObjectsCount();
+}
 
-	globalLights.clear();
-	m_localLightsBuffer.m_buffer.clear();
+void DeferredRenderer::RenderScene(Scene const & scene, FramePacket & packet) const
+{
+	static std::vector<Object const *> reflectiveObjects(1000);
 	reflectiveObjects.clear();
 
+	//the lists are swapped out of the packet, the window thread clears what it gets back before gathering into it again
+	m_snapshot.swap(packet.snapshot);
+	m_globalLights.swap(packet.globalLights);
+	m_shadowedLocalLights.swap(packet.shadowedLocalLights);
+	m_instanceGroups.swap(packet.instanceGroups);
+	m_localLightsBuffer.m_buffer.swap(packet.localLights);
+	m_instanceBuffer.m_buffer.swap(packet.instanceTransforms);
+	m_objectsCount = packet.objectsCount;
+
+	std::vector<std::pair<GlobalLight const *, glm::vec3>> const & globalLights = m_globalLights;
+	std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights = m_shadowedLocalLights;
+	std::vector<InstanceGroup> const & instanceGroups = m_instanceGroups;
+
+	//the pass timers also measure the frame for the dynamic resolution
+	bool const timePasses = m_gatherStatistics || m_dynamicResolution.enabled;
+	UpdateResolutionScale();
+
+	//a new scene searches again, starting from the cheapest format
+	if (m_accumulationPrecision.automatic && m_accumulationPrecision.scene != &scene)
+	{
+		m_accumulationPrecision.scene = &scene;
+		m_accumulationPrecision.format = R11G11B10F_FORMAT;
+		m_accumulationPrecision.searching = true;
+		m_accumulationPrecision.frames = 0;
+	}
+
+	//both renders take the same path so only the format differs
+	bool const validatePrecision = m_accumulationPrecision.validate || m_accumulationPrecision.searching;
+	m_lightingPass.m_directLocalLighting = validatePrecision;
+
 	//upload global uniform data
 	m_sceneUniformBuffer.SetUniform("uScene.ProjectionMatrix", scene.GetProjectionMatrix());
 	m_sceneUniformBuffer.SetUniform("uScene.ViewMatrix", scene.GetViewMatrix());
@@ -96,53 +179,160 @@ void DeferredRenderer::RenderScene(Scene const & scene) const
 	m_sceneUniformBuffer.SetUniform("uScene.EyePosition", glm::vec3(glm::inverse(scene.GetViewMatrix()) * glm::vec4(0, 0, 0, 1)));
 	m_sceneUniformBuffer.UploadBuffer();
 
+	//the frame is declared as a graph, passes nothing reads are culled and the transient targets are placed in a pool
+	RenderGraph & graph = m_renderGraph;
+	graph.Reset();
+
+	StateCache::ResetStatistics();
+	m_framebufferState.drawBufferChanges = 0;
+
+	RenderGraph::Resource const gBuffer = graph.ImportResource("G-Buffer");
+	RenderGraph::Resource const depthBuffer = graph.ImportResource("Depth Buffer");
+	RenderGraph::Resource const shadowAtlas = graph.ImportResource("Shadow Atlas");
+	RenderGraph::Resource const visibleLights = graph.ImportResource("Visible Lights");
+	RenderGraph::Resource const lightAccumulation = graph.ImportResource("Light Accumulation");
+	RenderGraph::Resource const localLightingHistory = graph.ImportResource("Local Lighting History");
+	RenderGraph::Resource const accumulationError = graph.ImportResource("Accumulation Error");
+	RenderGraph::Resource const backBuffer = graph.ImportResource("Back Buffer");
+	graph.MarkOutput(backBuffer);
+	graph.MarkOutput(accumulationError);
+
+	//transient targets are sized like the window, the dynamic resolution renders into their lower left corner
+	GLenum const accumulationFormat = g_accumulationFormats[m_lightAccumulationBuffer.format];
+	int const scale = m_lightingPass.GetLocalLightingScale();
+	RenderGraph::TextureDescription const reducedColor = { (m_gBuffer.width + scale - 1) / scale, (m_gBuffer.height + scale - 1) / scale, GL_RGBA32F, GL_RGBA, GL_FLOAT };
+	RenderGraph::TextureDescription const reducedLighting = { reducedColor.width, reducedColor.height, accumulationFormat, GL_RGBA, GL_FLOAT };
+	RenderGraph::TextureDescription const reducedDepth = { reducedColor.width, reducedColor.height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 };
+
+	std::vector<RenderGraph::Resource> lightingReads = { gBuffer, depthBuffer, shadowAtlas, lightAccumulation };
+	std::vector<RenderGraph::Resource> lightingWrites = { lightAccumulation };
+	std::vector<RenderGraph::Resource> reducedTargets;
+	std::vector<RenderGraph::Resource> localLightingTargets;
+
+	if (m_lightingPass.m_gpuCulling)
+		lightingReads.push_back(visibleLights);
+
+	if (scale > 1)
+	{
+		reducedTargets.push_back(graph.CreateTexture("Reduced Lighting", reducedLighting, REDUCED_LIGHTING_BUFFER_UNIT));
+		reducedTargets.push_back(graph.CreateTexture("Reduced Color 0", reducedColor, REDUCED_COLOR_BUFFER0_UNIT));
+		reducedTargets.push_back(graph.CreateTexture("Reduced Color 1", reducedColor, REDUCED_COLOR_BUFFER1_UNIT));
+		reducedTargets.push_back(graph.CreateTexture("Reduced Color 2", reducedColor, REDUCED_COLOR_BUFFER2_UNIT));
+		reducedTargets.push_back(graph.CreateTexture("Reduced Color 3", reducedColor, REDUCED_COLOR_BUFFER3_UNIT));
+		reducedTargets.push_back(graph.CreateTexture("Reduced Depth", reducedDepth, REDUCED_DEPTH_BUFFER_UNIT));
+		lightingWrites.insert(lightingWrites.end(), reducedTargets.begin(), reducedTargets.end());
+	}
+
+	if (m_lightingPass.IsCheckerboarding())
+	{
+		localLightingTargets.push_back(graph.CreateTexture("Local Lighting", { m_gBuffer.width, m_gBuffer.height, accumulationFormat, GL_RGBA, GL_FLOAT }, LOCAL_LIGHTING_BUFFER_UNIT));
+		lightingReads.push_back(localLightingHistory);
+		lightingWrites.push_back(localLightingHistory);
+		lightingWrites.push_back(localLightingTargets[0]);
+	}
+
 //-------------------------------------------------------------------------------------------------------
 //DEFERRED PASS
 //-------------------------------------------------------------------------------------------------------
 
-	m_deferredPass.Prepare(scene);
-	m_deferredPass.ProcessScene(scene, &globalLights, &m_localLightsBuffer.m_buffer, nullptr);
+	graph.AddPass("Geometry", {}, { gBuffer, depthBuffer }, [&]()
+	{
+		if (timePasses)
+			m_geometryTimer.Begin();
+
+		m_deferredPass.Prepare(scene);
+
+		//upload instance transforms and draw the instance groups
+		m_instanceBuffer.Upload();
+		m_deferredPass.ProcessInstanceGroups(instanceGroups);
 
-	//upload local light information
-	m_localLightsBuffer.Upload();
+		if (timePasses)
+			m_geometryTimer.End();
+	});
 
 //-------------------------------------------------------------------------------------------------------
 //SHADOW MAP PASS
 //-------------------------------------------------------------------------------------------------------
 
-	m_shadowPass.Prepare(scene);
-	m_shadowPass.ProcessScene(scene, globalLights);
+	//the shadow pass works on the lights the geometry pass gathered, reading the g-buffer keeps it behind
+	graph.AddPass("Shadows", { gBuffer }, { shadowAtlas }, [&]()
+	{
+		if (timePasses)
+			m_shadowTimer.Begin();
+
+		m_shadowPass.Prepare(scene);
+		m_shadowPass.ProcessScene(scene, globalLights, m_localLightsBuffer.m_buffer, shadowedLocalLights, instanceGroups);
+
+		if (timePasses)
+			m_shadowTimer.End();
+
+		//upload local light information, the shadow pass assigns the shadows of local lights
+		m_lightingPass.SelectLightProxies(scene, m_localLightsBuffer.m_buffer);
+		m_localLightsBuffer.Upload();
+	});
+
+	graph.AddPass("Light Culling", { depthBuffer }, { visibleLights }, [&]()
+	{
+		m_lightingPass.CullLocalLights(scene, m_localLightsBuffer.m_buffer.size(), m_gBuffer.depthBuffer);
+	});
 
 //-------------------------------------------------------------------------------------------------------
 //REFLECTION PASS
 //-------------------------------------------------------------------------------------------------------
 
-	//m_reflectionPass.Prepare(scene);
-	//m_reflectionPass.ProcessScene(scene, reflectiveObjects);
+	//graph.AddPass("Reflections", { gBuffer, depthBuffer }, { reflections }, [&]() { m_reflectionPass.ProcessScene(scene, reflectiveObjects); });
 
 //-------------------------------------------------------------------------------------------------------
 //LIGHTING PASS
 //-------------------------------------------------------------------------------------------------------
 
-	m_lightingPass.Prepare(scene);
+	graph.AddPass("Lighting", lightingReads, lightingWrites, [&]()
+	{
+		if (timePasses)
+			m_globalLightingTimer.Begin();
 
-	m_lightingPass.ProcessAmbientLight();
-	m_lightingPass.ProcessGlobalLights(globalLights);
-	m_lightingPass.ProcessLocalLights(m_localLightsBuffer.m_buffer.size());
-	
+		m_lightingPass.Prepare(scene);
+
+		m_lightingPass.ProcessAmbientLight();
+		m_lightingPass.ProcessGlobalLights(globalLights, m_shadowPass);
+
+		if (timePasses)
+		{
+			m_globalLightingTimer.End();
+			m_localLightingTimer.Begin();
+		}
+
+		m_lightingPass.ProcessLocalLights(m_localLightsBuffer.m_buffer.size(), m_shadowPass.GetShadowAtlas());
+
+		if (timePasses)
+			m_localLightingTimer.End();
+	});
+
+	RenderGraph::Resource referenceAccumulation = 0;
+	if (validatePrecision)
+	{
+		referenceAccumulation = graph.CreateTexture("Reference Accumulation", { m_gBuffer.width, m_gBuffer.height, GL_RGBA32F, GL_RGBA, GL_FLOAT }, REFERENCE_ACCUMULATION_UNIT);
+		graph.AddPass("Precision Validation", { gBuffer, depthBuffer, shadowAtlas, lightAccumulation }, { referenceAccumulation, accumulationError }, [&]()
+		{
+			ValidateAccumulationPrecision(scene, globalLights);
+		});
+	}
 	
 //-------------------------------------------------------------------------------------------------------
 //FORWARD PASS (skydome, transparent objects)
 //-------------------------------------------------------------------------------------------------------
 
-
+	//graph.AddPass("Forward", { depthBuffer, lightAccumulation }, { lightAccumulation }, [&]() { m_forwardPass.ProcessScene(scene); });
 
 //-------------------------------------------------------------------------------------------------------
 //GAMMA CORRECTION\TONE MAPPING PASS
 //-------------------------------------------------------------------------------------------------------
 
-	m_toneMappingPass.Prepare();
-	m_toneMappingPass.ProcessFrame();
+	graph.AddPass("Tone Mapping", { lightAccumulation }, { backBuffer }, [&]()
+	{
+		m_toneMappingPass.Prepare(glm::vec2((float)m_dynamicResolution.width / (float)m_gBuffer.width, (float)m_dynamicResolution.height / (float)m_gBuffer.height));
+		m_toneMappingPass.ProcessFrame();
+	});
 
 //-------------------------------------------------------------------------------------------------------
 //DEBUG DRAWING
@@ -150,21 +340,31 @@ void DeferredRenderer::RenderScene(Scene const & scene) const
 	
 	if (m_displayLightVolumes)
 	{
-		BlitDepthBuffers();
-
-		glDisable(GL_BLEND);
-		glEnable(GL_DEPTH_TEST);
+		graph.AddPass("Light Volumes", { depthBuffer, backBuffer }, { backBuffer }, [&]()
+		{
+			BlitDepthBuffers();
 
-		m_debugProgram.Use();
+			StateCache::Disable(GL_BLEND);
+			StateCache::Enable(GL_DEPTH_TEST);
 
-		glBindVertexArray(Shape::GetWireCircle()->GetVAO());
-		glEnableVertexAttribArray(0);
+			m_debugProgram.Use();
 
-		glDrawElementsInstanced(GL_LINE_LOOP, Shape::GetWireCircle()->GetIndexCount(), GL_UNSIGNED_INT, 0, m_localLightsBuffer.m_buffer.size());
+			StateCache::BindVertexArray(Shape::GetWireCircle()->GetVAO());
 
-		glDisableVertexAttribArray(0);
-		glBindVertexArray(0);
+			glDrawElementsInstanced(GL_LINE_LOOP, Shape::GetWireCircle()->GetIndexCount(), GL_UNSIGNED_INT, 0, m_localLightsBuffer.m_buffer.size());
+		});
 	}
+
+	graph.Compile();
+
+	//attach the textures the graph placed the transient targets in, detached targets give their memory back
+	GLenum const reducedAttachments[6] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4, GL_DEPTH_STENCIL_ATTACHMENT };
+	for (unsigned int i = 0; i < 6; ++i)
+		AttachTexture(m_reducedLightingBuffer.framebuffer, reducedAttachments[i], reducedTargets.empty() ? 0 : graph.GetTextureHandle(reducedTargets[i]));
+	AttachTexture(m_lightAccumulationBuffer.framebuffer, GL_COLOR_ATTACHMENT1, localLightingTargets.empty() ? 0 : graph.GetTextureHandle(localLightingTargets[0]));
+	AttachTexture(m_referenceAccumulationBuffer.framebuffer, GL_COLOR_ATTACHMENT0, validatePrecision ? graph.GetTextureHandle(referenceAccumulation) : 0);
+
+	graph.Execute();
 }
 
 void DeferredRenderer::Resize(int const & width, int const & height)
@@ -175,10 +375,19 @@ void DeferredRenderer::Resize(int const & width, int const & height)
 	CreateGBuffer(width, height);
 	FreeLightAccumulationBuffer();
 	CreateLightAccumulationBuffer(width, height);
+	m_lightingPass.m_historyValid = false;
 }
 
 void DeferredRenderer::GenerateGUI()
 {
+	//accumulation formats chosen while rendering are applied between frames
+	if (m_accumulationPrecision.format != m_lightAccumulationBuffer.format)
+	{
+		FreeLightAccumulationBuffer();
+		CreateLightAccumulationBuffer(m_gBuffer.width, m_gBuffer.height);
+		m_lightingPass.m_historyValid = false;
+	}
+
 	if (!ImGui::Begin("Deferred Renderer", 0, ImGuiWindowFlags_ShowBorders))
 	{
 		ImGui::End();
@@ -191,6 +400,16 @@ void DeferredRenderer::GenerateGUI()
 		ImGui::Checkbox("Display Light Volumes", &m_displayLightVolumes);
 	}
 
+	if (ImGui::CollapsingHeader("Render Graph"))
+	{
+		ImGui::Text("Passes: %i / %i", m_renderGraph.GetExecutedPassesCount(), (unsigned int)m_renderGraph.m_passes.size());
+		for (auto const & pass : m_renderGraph.m_passes)
+			ImGui::Text("  %s%s", pass.name.c_str(), pass.culled ? " (culled)" : "");
+		ImGui::Text("Transient Targets: %.1f MB in %.1f MB", m_renderGraph.GetTransientMemory() / 1048576.0, m_renderGraph.GetPooledMemory() / 1048576.0);
+		ImGui::Text("GL State Calls: %i issued, %i filtered", StateCache::GetIssuedCallsCount(), StateCache::GetFilteredCallsCount());
+		ImGui::Text("Draw Buffer Changes: %i", m_framebufferState.drawBufferChanges);
+	}
+
 	if (ImGui::CollapsingHeader("Geometry Pass"))
 	{
 		ImGui::Text("Statistics:");
@@ -198,10 +417,26 @@ void DeferredRenderer::GenerateGUI()
 		ImGui::SameLine();
 		
 		if (m_gatherStatistics)
-			ImGui::Text("time");
+			ImGui::Text("%.3f ms", m_geometryTimer.GetResult() / 1000000.0);
 		else
 			ImGui::Text("N/A");
 
+		ImGui::Text("Objects: %i", m_objectsCount);
+		ImGui::Text("Draw Calls: %i", m_deferredPass.GetDrawCallsCount());
+		ImGui::Text("Triangles: %i", m_deferredPass.GetTrianglesCount());
+		ImGui::Text("Command Buffers: %i (%i workers)", (int)m_deferredPass.m_commandBuffers.size(), JobSystem::GetWorkersCount());
+
+		ImGui::Separator();
+
+		ImGui::Text("Level of Detail:");
+		float lodScreenSize = m_deferredPass.m_lodScreenSize;
+		if (ImGui::DragFloat("Screen Size", &lodScreenSize, 0.01f, 0.01f, 4.0f))
+			m_deferredPass.m_lodScreenSize = lodScreenSize;
+
+		float lodHysteresis = m_deferredPass.m_lodHysteresis;
+		if (ImGui::DragFloat("Hysteresis", &lodHysteresis, 0.01f, 0.0f, 1.0f))
+			m_deferredPass.m_lodHysteresis = lodHysteresis;
+
 		ImGui::Separator();
 		
 		ImGui::Text("Intermediate Results:");
@@ -263,13 +498,61 @@ void DeferredRenderer::GenerateGUI()
 		ImGui::SameLine();
 
 		if (m_gatherStatistics)
-			ImGui::Text("time");
+			ImGui::Text("%.3f ms", m_shadowTimer.GetResult() / 1000000.0);
 		else
 			ImGui::Text("N/A");
 
 		ImGui::Text("Lights Processed: %i", m_shadowPass.GetNumberOfProcessedLights());
+		ImGui::Text("Draw Calls: %i", m_shadowPass.GetDrawCallsCount());
+		ImGui::Text("Triangles: %i", m_shadowPass.GetTrianglesCount());
+		ImGui::Text("Culled Casters: %i", m_shadowPass.GetCulledCastersCount());
+		ImGui::Text("Rendered Cascades: %i / %i", m_shadowPass.GetRenderedCascadesCount(), m_shadowPass.GetCascadesCount());
+		ImGui::Text("Shadowed Local Lights: %i (%i dropped)", m_shadowPass.GetShadowedLocalLightsCount(), m_shadowPass.GetDroppedLocalLightsCount());
+		ImGui::Text("Rendered Faces: %i / %i", m_shadowPass.GetRenderedFacesCount(), m_shadowPass.m_localFaceBudget);
+		ImGui::Text("Pending Faces: %i", m_shadowPass.GetPendingFacesCount());
+		ImGui::Text("Atlas Usage: %.1f%%", 100.0f * (float)m_shadowPass.m_atlas.GetUsedArea() / (float)(SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE));
+
+		if (m_shadowPass.m_globalLights && ImGui::TreeNode("Cache Hit Rate"))
+		{
+			for (auto const & lightPair : *m_shadowPass.m_globalLights)
+				ImGui::Text("%s (%i px): %.1f%%", lightPair.first->GetName().c_str(), lightPair.first->GetShadowResolution(), 100.0f * lightPair.first->GetShadowCacheHitRate());
+			ImGui::TreePop();
+		}
+
+		ImGui::Separator();
+
+		ImGui::Text("Cascades:");
+		ImGui::Combo("Filter", &m_shadowPass.m_shadowFilter, "Hardware PCF\0Exponential Variance\0");
+		ImGui::DragFloat("Shadow Distance", &m_shadowPass.m_shadowDistance, 0.5f, 1.0f, 1000.0f);
+		ImGui::SliderFloat("Split Lambda", &m_shadowPass.m_splitLambda, 0.0f, 1.0f);
+		ImGui::DragFloat("Slope Bias", &m_shadowPass.m_slopeBias, 0.05f, 0.0f, 10.0f);
+		ImGui::DragFloat("Constant Bias", &m_shadowPass.m_constantBias, 0.1f, 0.0f, 100.0f);
+		if (m_shadowPass.m_shadowFilter == ShadowPass::MOMENTS_FILTER)
+		{
+			ImGui::SliderInt("Blur Radius", &m_shadowPass.m_blurRadius, 0, MAX_SHADOW_BLUR_RADIUS);
+			ImGui::DragFloat("Positive Exponent", &m_shadowPass.m_momentsExponents.x, 0.5f, 1.0f, 42.0f);
+			ImGui::DragFloat("Negative Exponent", &m_shadowPass.m_momentsExponents.y, 0.5f, 1.0f, 42.0f);
+			ImGui::SliderFloat("Light Bleeding Reduction", &m_shadowPass.m_lightBleedingReduction, 0.0f, 0.95f);
+		}
+		ImGui::SliderInt("LOD Bias", &m_shadowPass.m_lodBias, 0, MAX_MESH_LEVELS_OF_DETAIL - 1);
+		ImGui::SliderFloat("Atlas Budget", &m_shadowPass.m_atlasBudget, 0.05f, 1.0f);
+		ImGui::SliderInt("Face Budget", &m_shadowPass.m_localFaceBudget, 0, MAX_LOCAL_SHADOW_FACE_BUDGET);
 
 		ImGui::Separator();
+
+		ImGui::Text("Intermediate Results:");
+		if (ImGui::TreeNode("Shadow Atlas"))
+		{
+			ImGui::Image((void*)&m_shadowPass.m_atlasView, ImVec2(300, 300), ImVec2(0, 1), ImVec2(1, 0));
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::BeginTooltip();
+				ImGui::Text("Format: (depth)");
+				ImGui::Text("Size: %i x %i", m_shadowPass.m_shadowAtlas.m_width, m_shadowPass.m_shadowAtlas.m_height);
+				ImGui::EndTooltip();
+			}
+			ImGui::TreePop();
+		}
 	}
 
 	if (ImGui::CollapsingHeader("Lighting Pass"))
@@ -279,12 +562,50 @@ void DeferredRenderer::GenerateGUI()
 		ImGui::SameLine();
 
 		if (m_gatherStatistics)
-			ImGui::Text("time");
+		{
+			ImGui::Text("%.3f ms", (m_globalLightingTimer.GetResult() + m_localLightingTimer.GetResult()) / 1000000.0);
+			ImGui::Text("Ambient & Global Lights: %.3f ms", m_globalLightingTimer.GetResult() / 1000000.0);
+			ImGui::Text("Local Lights: %.3f ms", m_localLightingTimer.GetResult() / 1000000.0);
+
+			m_localLightingTimes[m_lightingPass.m_localLightingResolution] = m_localLightingTimer.GetResult() / 1000000.0;
+			ImGui::Text("Local Lights (Full/Half/Quarter): %.3f / %.3f / %.3f ms", m_localLightingTimes[0], m_localLightingTimes[1], m_localLightingTimes[2]);
+		}
 		else
 			ImGui::Text("N/A");
 
 		ImGui::Text("Global Lights: %i", m_lightingPass.GetGlobalLightsCount());
 		ImGui::Text("Local Lights: %i", m_lightingPass.GetLocalLightsCount());
+		if (GLEW_ARB_pipeline_statistics_query)
+			ImGui::Text("Local Light Invocations: %llu", m_lightingPass.GetLocalLightInvocationsCount());
+		else
+			ImGui::Text("Local Light Invocations: N/A");
+		ImGui::Text("Sphere Proxies: %i", m_lightingPass.GetSphereProxiesCount());
+		ImGui::Text("Quad Proxies: %i", m_lightingPass.GetQuadProxiesCount());
+		if (m_lightingPass.m_gpuCulling)
+			ImGui::Text("Visible Lights: %i / %i", m_lightingPass.GetVisibleLightsCount(), m_lightingPass.GetLocalLightsCount());
+		else
+			ImGui::Text("Visible Lights: N/A");
+		ImGui::Checkbox("Batch Global Lights", &m_lightingPass.m_batchGlobalLights);
+		ImGui::Checkbox("Stencil Volumes", &m_lightingPass.m_stencilVolumes);
+		ImGui::Checkbox("GPU Light Culling", &m_lightingPass.m_gpuCulling);
+		ImGui::Checkbox("Hi-Z Light Culling", &m_lightingPass.m_occlusionCulling);
+		ImGui::Checkbox("Checkerboard Local Lights", &m_lightingPass.m_checkerboardLocalLights);
+		ImGui::SliderFloat("Quad Proxy Size", &m_lightingPass.m_quadProxySize, 0.0f, 2.0f);
+		if (ImGui::Combo("Accumulation Format", &m_accumulationPrecision.format, "R11G11B10F\0RGBA16F\0RGBA32F\0"))
+		{
+			m_accumulationPrecision.automatic = false;
+			m_accumulationPrecision.searching = false;
+		}
+		if (ImGui::Checkbox("Automatic Format", &m_accumulationPrecision.automatic))
+			m_accumulationPrecision.scene = nullptr;
+		ImGui::Checkbox("Validate Precision", &m_accumulationPrecision.validate);
+		if (m_accumulationPrecision.validate || m_accumulationPrecision.searching)
+			ImGui::Text("Tone Mapped Error: %.3f max, %.4f mean", m_accumulationPrecision.maxError, m_accumulationPrecision.meanError);
+		else
+			ImGui::Text("Tone Mapped Error: N/A");
+		ImGui::DragFloat("Max Error Threshold", &m_accumulationPrecision.maxErrorThreshold, 0.05f, 0.0f, 16.0f);
+		ImGui::DragFloat("Mean Error Threshold", &m_accumulationPrecision.meanErrorThreshold, 0.005f, 0.0f, 4.0f);
+		ImGui::Combo("Local Lighting Resolution", &m_lightingPass.m_localLightingResolution, "Full\0Half\0Quarter\0");
 		ImGui::Separator();
 	}
 
@@ -302,10 +623,30 @@ void DeferredRenderer::GenerateGUI()
 		ImGui::Separator();
 	}
 
+	if (ImGui::CollapsingHeader("Dynamic Resolution"))
+	{
+		ImGui::Text("Scale: %.3f (%i x %i)", m_dynamicResolution.scale, m_dynamicResolution.width, m_dynamicResolution.height);
+		if (m_dynamicResolution.enabled)
+			ImGui::Text("GPU Frame Time: %.3f ms", m_dynamicResolution.frameTime);
+		else
+			ImGui::Text("GPU Frame Time: N/A");
+
+		ImGui::Checkbox("Enabled", &m_dynamicResolution.enabled);
+		ImGui::SliderFloat("Target Frame Time", &m_dynamicResolution.targetFrameTime, 1.0f, 50.0f, "%.1f ms");
+		ImGui::SliderFloat("Min Scale", &m_dynamicResolution.minScale, 0.25f, m_dynamicResolution.maxScale);
+		ImGui::SliderFloat("Max Scale", &m_dynamicResolution.maxScale, m_dynamicResolution.minScale, 1.0f);
+		ImGui::SliderFloat("Sharpness", &m_toneMappingPass.m_sharpness, 0.0f, 1.0f);
+	}
+
 	if (ImGui::CollapsingHeader("Tone Mapping"))
 	{
 		ImGui::DragFloat("Gamma", &m_toneMappingPass.m_gamma, 0.01f, 0.0f, 10.0f);
 		ImGui::DragFloat("Expsoure", &m_toneMappingPass.m_exposure, 0.01f, 0.0f, 10.0f);
+		ImGui::Checkbox("Auto Exposure", &m_toneMappingPass.m_autoExposure);
+		ImGui::SliderFloat("Exposure Key", &m_toneMappingPass.m_exposureKey, 0.01f, 1.0f);
+		ImGui::SliderFloat("Adaptation Rate", &m_toneMappingPass.m_adaptationRate, 0.1f, 10.0f);
+		ImGui::DragFloat("Min Log Luminance", &m_toneMappingPass.m_minLogLuminance, 0.1f, -20.0f, m_toneMappingPass.m_maxLogLuminance);
+		ImGui::DragFloat("Max Log Luminance", &m_toneMappingPass.m_maxLogLuminance, 0.1f, m_toneMappingPass.m_minLogLuminance, 20.0f);
 	}
 
 	ImGui::End();
@@ -314,61 +655,229 @@ void DeferredRenderer::GenerateGUI()
 
 void DeferredRenderer::BindGBuffer() const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer.framebuffer);
-	glDrawBuffers(4, m_gBuffer.drawBuffers);
-	glViewport(0, 0, m_gBuffer.width, m_gBuffer.height);
+	StateCache::BindFramebuffer(m_gBuffer.framebuffer);
+	SetDrawBuffers(m_gBuffer.framebuffer, 4, m_gBuffer.drawBuffers);
+	glViewport(0, 0, m_dynamicResolution.width, m_dynamicResolution.height);
 }
 
 void DeferredRenderer::BindShadowBuffer(Texture const & shadowTexture) const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_shadowBuffer.framebuffer);
+	StateCache::BindFramebuffer(m_shadowBuffer.framebuffer);
 	shadowTexture.Bind();
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowTexture.m_handle, 0);
+	AttachTexture(m_shadowBuffer.framebuffer, GL_DEPTH_ATTACHMENT, shadowTexture.m_handle);
 
-	glDrawBuffers(1, &m_shadowBuffer.drawBuffers);
 	glViewport(0, 0, m_shadowBuffer.width, m_shadowBuffer.height);
 }
 
 void DeferredRenderer::BindLightAccumulationBuffer() const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_lightAccumulationBuffer.framebuffer);
-	glDrawBuffers(1, &m_lightAccumulationBuffer.drawBuffers);
-	glViewport(0, 0, m_lightAccumulationBuffer.width, m_lightAccumulationBuffer.height);
+	unsigned int const framebuffer = m_renderingReference ? m_referenceAccumulationBuffer.framebuffer : m_lightAccumulationBuffer.framebuffer;
+	StateCache::BindFramebuffer(framebuffer);
+	SetDrawBuffers(framebuffer, 1, &m_lightAccumulationBuffer.drawBuffers);
+	glViewport(0, 0, m_dynamicResolution.width, m_dynamicResolution.height);
+}
+
+void DeferredRenderer::BindLocalLightingBuffer() const
+{
+	GLenum const drawBuffer = GL_COLOR_ATTACHMENT1;
+	StateCache::BindFramebuffer(m_lightAccumulationBuffer.framebuffer);
+	SetDrawBuffers(m_lightAccumulationBuffer.framebuffer, 1, &drawBuffer);
+	glViewport(0, 0, m_dynamicResolution.width, m_dynamicResolution.height);
+}
+
+void DeferredRenderer::BindTemporalResolveBuffer(unsigned int const & history) const
+{
+	//adds the resolved local lighting to the accumulation and keeps it as the history of the next frame
+	GLenum const drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+	StateCache::BindFramebuffer(m_lightAccumulationBuffer.framebuffer);
+	AttachTexture(m_lightAccumulationBuffer.framebuffer, GL_COLOR_ATTACHMENT2, m_lightAccumulationBuffer.historyBuffers[history].GetHandle());
+	AttachTexture(m_lightAccumulationBuffer.framebuffer, GL_COLOR_ATTACHMENT3, m_lightAccumulationBuffer.historyNormals[history].GetHandle());
+	SetDrawBuffers(m_lightAccumulationBuffer.framebuffer, 3, drawBuffers);
+	glViewport(0, 0, m_dynamicResolution.width, m_dynamicResolution.height);
+}
+
+void DeferredRenderer::BindReducedGBuffer() const
+{
+	StateCache::BindFramebuffer(m_reducedLightingBuffer.framebuffer);
+	int const scale = m_lightingPass.GetLocalLightingScale();
+	SetDrawBuffers(m_reducedLightingBuffer.framebuffer, 4, &m_reducedLightingBuffer.drawBuffers[1]);
+	glViewport(0, 0, (m_dynamicResolution.width + scale - 1) / scale, (m_dynamicResolution.height + scale - 1) / scale);
+}
+
+void DeferredRenderer::BindReducedLightingBuffer() const
+{
+	StateCache::BindFramebuffer(m_reducedLightingBuffer.framebuffer);
+	int const scale = m_lightingPass.GetLocalLightingScale();
+	SetDrawBuffers(m_reducedLightingBuffer.framebuffer, 1, &m_reducedLightingBuffer.drawBuffers[0]);
+	glViewport(0, 0, (m_dynamicResolution.width + scale - 1) / scale, (m_dynamicResolution.height + scale - 1) / scale);
 }
 
 void DeferredRenderer::BindDefaultFramebuffer() const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glDrawBuffers(1, &m_defaultFramebuffer.drawBuffers);
+	StateCache::BindFramebuffer(0);
+	SetDrawBuffers(0, 1, &m_defaultFramebuffer.drawBuffers);
 	glViewport(0, 0, m_defaultFramebuffer.width, m_defaultFramebuffer.height);
 }
 
 void DeferredRenderer::BlitDepthBuffers() const
 {
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_gBuffer.framebuffer);
-	glBlitFramebuffer(0, 0, m_gBuffer.width, m_gBuffer.height, 0, 0, m_defaultFramebuffer.width, m_defaultFramebuffer.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	StateCache::BindReadFramebuffer(m_gBuffer.framebuffer);
+	glBlitFramebuffer(0, 0, m_dynamicResolution.width, m_dynamicResolution.height, 0, 0, m_defaultFramebuffer.width, m_defaultFramebuffer.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+}
+
+unsigned int const & DeferredRenderer::GetRenderWidth() const
+{
+	return m_dynamicResolution.width;
+}
+
+unsigned int const & DeferredRenderer::GetRenderHeight() const
+{
+	return m_dynamicResolution.height;
 }
 
 void DeferredRenderer::Finalize()
 {
 	FreeGBuffer();
 	FreeShadowBuffer();
+	FreeReducedLightingBuffer();
 
 	m_localLightsBuffer.Free();
+	m_instanceBuffer.Free();
+	m_errorBuffer.Free();
+	m_errorProgram.DestroyHandle();
+	m_renderGraph.Free();
 
 	m_lightingPass.Finalize();
 	m_shadowPass.Finalize();
 	m_deferredPass.Finalize();
+
+	m_geometryTimer.Free();
+	m_shadowTimer.Free();
+	m_globalLightingTimer.Free();
+	m_localLightingTimer.Free();
 }
 
 #pragma endregion
 
 #pragma region "Private Methods"
 
+void DeferredRenderer::ValidateAccumulationPrecision(Scene const & scene, std::vector<std::pair<GlobalLight const *, glm::vec3>> const & globalLights) const
+{
+	//light the frame a second time into the full precision reference
+	m_renderingReference = true;
+	m_lightingPass.Prepare(scene);
+	m_lightingPass.ProcessAmbientLight();
+	m_lightingPass.ProcessGlobalLights(globalLights, m_shadowPass);
+	m_lightingPass.ProcessLocalLights(m_localLightsBuffer.m_buffer.size(), m_shadowPass.GetShadowAtlas());
+	m_renderingReference = false;
+
+	//compare both after tone mapping, one value per group of 16x16 pixels
+	unsigned int const groupsX = (m_dynamicResolution.width + 15) / 16;
+	unsigned int const groupsY = (m_dynamicResolution.height + 15) / 16;
+	m_errorBuffer.Reserve(groupsX * groupsY);
+	m_errorBuffer.m_buffer.resize(groupsX * groupsY);
+
+	m_errorProgram.Use();
+	m_errorProgram.SetUniform("uRenderSize", glm::vec2(m_dynamicResolution.width, m_dynamicResolution.height));
+	m_errorProgram.SetUniform("uGamma", m_toneMappingPass.m_gamma);
+	m_errorProgram.SetUniform("uExposure", m_toneMappingPass.m_exposure);
+	m_errorProgram.SetUniform("uMethod", (int)m_toneMappingPass.m_method);
+	m_errorProgram.SetUniform("uAutoExposure", m_toneMappingPass.m_autoExposure);
+	m_errorProgram.SetUniform("uExposureKey", m_toneMappingPass.m_exposureKey);
+	glDispatchCompute(groupsX, groupsY, 1);
+
+	//validation is a diagnostic, so the result is read back right away
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_errorBuffer.m_handle);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::vec2) * m_errorBuffer.m_buffer.size(), &m_errorBuffer.m_buffer[0]);
+
+	float maxError = 0.0f;
+	double errorSum = 0.0;
+	for (auto const & group : m_errorBuffer.m_buffer)
+	{
+		maxError = glm::max(maxError, group.x);
+		errorSum += group.y;
+	}
+
+	AccumulationPrecision & precision = m_accumulationPrecision;
+	precision.maxError = maxError;
+	precision.meanError = (float)(errorSum / ((double)m_dynamicResolution.width * m_dynamicResolution.height));
+
+	//a format passes after a few frames within the thresholds, the first failure moves on to the next one
+	if (precision.searching && precision.format == m_lightAccumulationBuffer.format)
+	{
+		if (precision.format == RGBA32F_FORMAT)
+			precision.searching = false;
+		else if (precision.maxError > precision.maxErrorThreshold || precision.meanError > precision.meanErrorThreshold)
+		{
+			precision.format++;
+			precision.frames = 0;
+		}
+		else if (++precision.frames >= 4)
+			precision.searching = false;
+	}
+}
+
+void DeferredRenderer::UpdateResolutionScale() const
+{
+	DynamicResolution & resolution = m_dynamicResolution;
+
+	m_geometryTimer.Update();
+	m_shadowTimer.Update();
+	m_globalLightingTimer.Update();
+	m_localLightingTimer.Update();
+
+	bool const newFrameTime = m_geometryTimer.HasNewResult() && m_shadowTimer.HasNewResult() && m_globalLightingTimer.HasNewResult() && m_localLightingTimer.HasNewResult();
+
+	//without a new measurement the cooldown and the scale are held
+	if (!resolution.enabled)
+		resolution.scale = 1.0f;
+	else if (newFrameTime)
+	{
+		//gpu time of the last passes the timers finished, smoothed so single spikes do not change the scale
+		double const frameTime = (m_geometryTimer.GetResult() + m_shadowTimer.GetResult() + m_globalLightingTimer.GetResult() + m_localLightingTimer.GetResult()) / 1000000.0;
+		resolution.frameTime = glm::mix(resolution.frameTime, (float)frameTime, 0.2f);
+
+		if (resolution.cooldown > 0)
+			resolution.cooldown--;
+		else
+		{
+			//the pixel cost grows with the square of the scale, between the two thresholds the scale is held
+			float scale = resolution.scale;
+			if (resolution.frameTime > resolution.targetFrameTime)
+				scale = std::floor(scale * glm::max(std::sqrt(resolution.targetFrameTime / resolution.frameTime), 0.85f) * 40.0f) / 40.0f;
+			else if (resolution.frameTime < resolution.targetFrameTime * 0.8f)
+				scale = std::ceil(scale * glm::min(std::sqrt(resolution.targetFrameTime * 0.9f / resolution.frameTime), 1.05f) * 40.0f) / 40.0f;
+
+			scale = glm::clamp(scale, resolution.minScale, resolution.maxScale);
+			if (scale != resolution.scale)
+			{
+				//wait until the timers measure frames rendered at the new scale
+				resolution.scale = scale;
+				resolution.cooldown = 8;
+			}
+		}
+	}
+
+	if (resolution.enabled)
+		resolution.scale = glm::clamp(resolution.scale, resolution.minScale, resolution.maxScale);
+
+	if (newFrameTime)
+	{
+		m_geometryTimer.AcknowledgeResult();
+		m_shadowTimer.AcknowledgeResult();
+		m_globalLightingTimer.AcknowledgeResult();
+		m_localLightingTimer.AcknowledgeResult();
+	}
+
+	resolution.width = glm::max((unsigned int)(m_gBuffer.width * resolution.scale + 0.5f), 1u);
+	resolution.height = glm::max((unsigned int)(m_gBuffer.height * resolution.scale + 0.5f), 1u);
+}
+
 void DeferredRenderer::CreateGBuffer(int const & width, int const & height)
 {
 	glGenFramebuffers(1, &m_gBuffer.framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer.framebuffer);
+	StateCache::BindFramebuffer(m_gBuffer.framebuffer);
 
 	m_gBuffer.colorBuffer0.Initialize(width, height, GL_RGBA32F, GL_RGBA, GL_FLOAT, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_gBuffer.colorBuffer0.m_handle, 0);
@@ -379,15 +888,16 @@ void DeferredRenderer::CreateGBuffer(int const & width, int const & height)
 	m_gBuffer.colorBuffer3.Initialize(width, height, GL_RGBA32F, GL_RGBA, GL_FLOAT, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, m_gBuffer.colorBuffer3.m_handle, 0);
 
-	m_gBuffer.depthBuffer.Initialize(width, height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_gBuffer.depthBuffer.GetHandle(), 0);
+	//the stencil masks the pixels inside local light volumes in the lighting pass
+	m_gBuffer.depthBuffer.Initialize(width, height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_gBuffer.depthBuffer.GetHandle(), 0);
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 	{
 		int blah = 45;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	StateCache::BindFramebuffer(0);
 
 	m_gBuffer.width = width;
 	m_gBuffer.height = height;
@@ -401,7 +911,8 @@ void DeferredRenderer::CreateGBuffer(int const & width, int const & height)
 
 void DeferredRenderer::FreeGBuffer()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	ForgetFramebuffer(m_gBuffer.framebuffer);
+	StateCache::BindFramebuffer(0);
 	m_gBuffer.depthBuffer.Free();
 	m_gBuffer.colorBuffer0.Free();
 	m_gBuffer.colorBuffer1.Free();
@@ -413,51 +924,122 @@ void DeferredRenderer::FreeGBuffer()
 void DeferredRenderer::CreateShadowBuffer(int const & width, int const & height)
 {
 	glGenFramebuffers(1, &m_shadowBuffer.framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_shadowBuffer.framebuffer);
+	StateCache::BindFramebuffer(m_shadowBuffer.framebuffer);
 
-	glGenRenderbuffers(1, &m_shadowBuffer.depthBuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, m_shadowBuffer.depthBuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_shadowBuffer.depthBuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	//depth only, the shadow map layers are attached as depth buffer when bound
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	StateCache::BindFramebuffer(0);
 
 	m_shadowBuffer.width = width;
 	m_shadowBuffer.height = height;
-
-	m_shadowBuffer.drawBuffers = GL_COLOR_ATTACHMENT0;
 }
 
 void DeferredRenderer::FreeShadowBuffer()
 {
-	glDeleteRenderbuffers(1, &m_shadowBuffer.depthBuffer);
+	ForgetFramebuffer(m_shadowBuffer.framebuffer);
 	glDeleteFramebuffers(1, &m_shadowBuffer.framebuffer);
 }
 
 void DeferredRenderer::CreateLightAccumulationBuffer(int const & width, int const & height)
 {
 	glGenFramebuffers(1, &m_lightAccumulationBuffer.framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_lightAccumulationBuffer.framebuffer);
+	StateCache::BindFramebuffer(m_lightAccumulationBuffer.framebuffer);
+
+	//every target that lights are blended into uses the selected format
+	m_lightAccumulationBuffer.format = m_accumulationPrecision.format;
+	GLenum const format = g_accumulationFormats[m_lightAccumulationBuffer.format];
 
 	//attach color buffer
-	m_lightAccumulationBuffer.colorBuffer.Initialize(width, height, GL_RGBA32F, GL_RGBA, GL_FLOAT, 0);
+	m_lightAccumulationBuffer.colorBuffer.Initialize(width, height, format, GL_RGBA, GL_FLOAT, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_lightAccumulationBuffer.colorBuffer.GetHandle(), 0);
 
-	//attach depth buffer
+	//the history textures are attached in turn, one is written while the other is read
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		m_lightAccumulationBuffer.historyBuffers[i].Initialize(width, height, GL_RGBA32F, GL_RGBA, GL_FLOAT, 0);
+		m_lightAccumulationBuffer.historyNormals[i].Initialize(width, height, GL_RGBA16F, GL_RGBA, GL_FLOAT, 0);
+	}
+
+	//attach depth and stencil buffer
 	m_gBuffer.depthBuffer.Bind();
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_gBuffer.depthBuffer.GetHandle(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_gBuffer.depthBuffer.GetHandle(), 0);
 
 	m_lightAccumulationBuffer.width = width;
 	m_lightAccumulationBuffer.height = height;
 
 	m_lightAccumulationBuffer.drawBuffers = GL_COLOR_ATTACHMENT0;
+
+	glGenFramebuffers(1, &m_referenceAccumulationBuffer.framebuffer);
+	StateCache::BindFramebuffer(m_referenceAccumulationBuffer.framebuffer);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_gBuffer.depthBuffer.GetHandle(), 0);
+
+	StateCache::BindFramebuffer(0);
 }
 
 void DeferredRenderer::FreeLightAccumulationBuffer()
 {
+	ForgetFramebuffer(m_lightAccumulationBuffer.framebuffer);
 	glDeleteFramebuffers(1, &m_lightAccumulationBuffer.framebuffer);
 	m_lightAccumulationBuffer.colorBuffer.Free();
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		m_lightAccumulationBuffer.historyBuffers[i].Free();
+		m_lightAccumulationBuffer.historyNormals[i].Free();
+	}
+
+	ForgetFramebuffer(m_referenceAccumulationBuffer.framebuffer);
+	glDeleteFramebuffers(1, &m_referenceAccumulationBuffer.framebuffer);
+}
+
+void DeferredRenderer::CreateReducedLightingBuffer()
+{
+	//the targets are attached every frame from the render graph, as long as the local lights are accumulated at reduced resolution
+	glGenFramebuffers(1, &m_reducedLightingBuffer.framebuffer);
+
+	for (unsigned int i = 0; i < 5; ++i)
+		m_reducedLightingBuffer.drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+}
+
+void DeferredRenderer::FreeReducedLightingBuffer()
+{
+	ForgetFramebuffer(m_reducedLightingBuffer.framebuffer);
+	glDeleteFramebuffers(1, &m_reducedLightingBuffer.framebuffer);
+}
+
+void DeferredRenderer::SetDrawBuffers(unsigned int const & framebuffer, unsigned int const & count, unsigned int const * drawBuffers) const
+{
+	//the draw buffers are state of the bound framebuffer object, it keeps them while others are bound
+	std::vector<unsigned int> & current = m_framebufferState.drawBuffers[framebuffer];
+	if (current.size() == count && std::equal(current.begin(), current.end(), drawBuffers))
+		return;
+
+	current.assign(drawBuffers, drawBuffers + count);
+	glDrawBuffers(count, drawBuffers);
+	m_framebufferState.drawBufferChanges++;
+}
+
+void DeferredRenderer::AttachTexture(unsigned int const & framebuffer, unsigned int const & attachment, unsigned int const & texture) const
+{
+	unsigned int & attached = m_framebufferState.attachments[std::make_pair(framebuffer, attachment)];
+	if (attached == texture)
+		return;
+
+	StateCache::BindFramebuffer(framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+	attached = texture;
+}
+
+void DeferredRenderer::ForgetFramebuffer(unsigned int const & framebuffer)
+{
+	//names of deleted framebuffers are reused
+	FramebufferState & state = m_framebufferState;
+	state.drawBuffers.erase(framebuffer);
+	for (auto it = state.attachments.begin(); it != state.attachments.end();)
+		it = it->first.first == framebuffer ? state.attachments.erase(it) : ++it;
+	StateCache::ForgetFramebuffer(framebuffer);
 }
 
 #pragma endregion
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include <Framework/FrameQueue.h>
+#include <Framework/SceneSnapshot.h>
+
+#include <algorithm>
+
+//weight of the newest frame in the smoothed statistics
+static float const g_smoothing = 0.05f;
+
+static float Milliseconds(std::chrono::steady_clock::duration const & duration)
+{
+	return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+#pragma region "Constructors/Destructor"
+
+FrameQueue::FrameQueue(unsigned int const & capacity) : m_capacity(std::max(capacity, 1u)), m_packets(), m_freePackets(), m_submittedPackets(), m_mutex(), m_changed(), m_closed(false), m_suspended(false), m_preparing(false), m_submittedCount(0), m_lastRelease(), m_frameTime(0.0f), m_preparationTime(0.0f), m_latency(0.0f), m_maxLatency(0.0f)
+{
+	for (unsigned int i = 0; i < m_capacity; ++i)
+	{
+		m_packets.emplace_back(new FramePacket());
+		m_freePackets.push_back(m_packets.back().get());
+	}
+}
+
+FrameQueue::~FrameQueue()
+{
+
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+FramePacket * FrameQueue::BeginPacket()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_changed.wait(lock, [this]() { return m_closed || (!m_suspended && !m_freePackets.empty()); });
+	if (m_closed)
+		return nullptr;
+
+	FramePacket * packet = m_freePackets.front();
+	m_freePackets.pop_front();
+	m_preparing = true;
+	lock.unlock();
+
+	//the lists keep their capacity from the frames the packet carried before
+	packet->index = 0;
+	packet->inputEvents.clear();
+	packet->hasInput = false;
+	packet->preparationStart = std::chrono::steady_clock::now();
+	packet->snapshot.reset();
+	packet->globalLights.clear();
+	packet->localLights.clear();
+	packet->shadowedLocalLights.clear();
+	packet->instanceGroups.clear();
+	packet->instanceTransforms.clear();
+	packet->objectsCount = 0;
+	return packet;
+}
+
+void FrameQueue::SubmitPacket(FramePacket * packet)
+{
+	float const preparationTime = Milliseconds(std::chrono::steady_clock::now() - packet->preparationStart);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		packet->index = m_submittedCount++;
+		m_preparing = false;
+		m_preparationTime += (preparationTime - m_preparationTime) * g_smoothing;
+		m_submittedPackets.push_back(packet);
+	}
+	m_changed.notify_all();
+}
+
+void FrameQueue::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+	}
+	m_changed.notify_all();
+}
+
+FramePacket * FrameQueue::AcquirePacket()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_changed.wait(lock, [this]() { return m_closed || !m_submittedPackets.empty(); });
+	if (m_submittedPackets.empty())
+		return nullptr;
+
+	FramePacket * packet = m_submittedPackets.front();
+	m_submittedPackets.pop_front();
+	return packet;
+}
+
+void FrameQueue::ReleasePacket(FramePacket * packet)
+{
+	//released after the buffers were swapped, which is as close to the display as the application gets
+	auto const now = std::chrono::steady_clock::now();
+	float const latency = Milliseconds(now - (packet->hasInput ? packet->inputTime : packet->preparationStart));
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_lastRelease != std::chrono::steady_clock::time_point())
+			m_frameTime += (Milliseconds(now - m_lastRelease) - m_frameTime) * g_smoothing;
+		m_lastRelease = now;
+
+		m_latency += (latency - m_latency) * g_smoothing;
+		m_maxLatency = std::max(m_maxLatency * (1.0f - g_smoothing), latency);
+
+		m_freePackets.push_back(packet);
+	}
+	m_changed.notify_all();
+}
+
+void FrameQueue::SuspendProducer()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_suspended = true;
+	m_changed.wait(lock, [this]() { return m_closed || !m_preparing; });
+}
+
+void FrameQueue::ResumeProducer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_suspended = false;
+	}
+	m_changed.notify_all();
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+unsigned int const & FrameQueue::GetCapacity() const
+{
+	return m_capacity;
+}
+
+unsigned int FrameQueue::GetQueuedPacketsCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (unsigned int)m_submittedPackets.size();
+}
+
+float FrameQueue::GetFrameTime() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frameTime;
+}
+
+float FrameQueue::GetPreparationTime() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_preparationTime;
+}
+
+float FrameQueue::GetLatency() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_latency;
+}
+
+float FrameQueue::GetMaxLatency() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_maxLatency;
+}
+
+#pragma endregion
@@ -7,11 +7,20 @@
 #include <Framework/Mesh.h>
 #include <Framework/GlobalLight.h>
 #include <Framework/LocalLight.h>
+#include <Framework/DeferredPass.h>
+#include <Framework/JobSystem.h>
+#include <Framework/FrameQueue.h>
+#include <Framework/SceneSnapshot.h>
+#include <Framework/NodePool.h>
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl.h>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
 
 struct Grapher {
 	static float graph(void * data, int idx)
@@ -95,7 +104,7 @@ struct TextureCombo {
 };
 
 
-GUI::GUI()
+GUI::GUI() : m_benchmarkResults(), m_benchmarkBuildTime(0.0), m_benchmarkPublishTime(0.0f), m_benchmarkSequentialSceneNodes(0.0f), m_benchmarkSequentialSnapshotNodes(0.0f)
 {
 }
 
@@ -159,6 +168,7 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 				scene.DecrementReference(object->m_mesh);
 				object->m_mesh = scene.m_meshes[currentMesh].second.mesh;
 				scene.m_meshes[currentMesh].second.referenceCount++;
+				object->Changed();
 			}
 			ImGui::PopID();
 			ImGui::PopItemWidth();
@@ -175,6 +185,7 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 				scene.DecrementReference(object->m_material);
 				object->m_material = scene.m_materials[currentMaterial].second.material;
 				scene.m_materials[currentMaterial].second.referenceCount++;
+				object->Changed();
 			}
 			ImGui::PopID();
 			ImGui::PopItemWidth();
@@ -189,17 +200,21 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 			
 			ImGui::PushItemWidth(-1);
 			ImGui::PushID(0);
-			ImGui::InputFloat3("", &globalLight->m_intensity[0]);
+			if (ImGui::InputFloat3("", &globalLight->m_intensity[0]))
+				globalLight->Changed();
 			ImGui::PopID();
 			ImGui::PopItemWidth();
 			ImGui::NextColumn();
 
-			ImGui::Text("Shadow Map:");
+			ImGui::Text("Shadow Resolution:");
 			ImGui::NextColumn();
 
-			ImGui::PushItemWidth(-1);
-			ImGui::Image((void*)&globalLight->m_shadowMap, ImVec2(100, 100));
-			ImGui::PopItemWidth();
+			//shadows are assigned to the copy the renderer works with
+			GlobalLight const * published = dynamic_cast<GlobalLight const *>(scene.GetSnapshot()->GetNode(globalLight->m_slot));
+			if (published && published->GetShadowResolution())
+				ImGui::Text("%i x %i", published->GetShadowResolution(), published->GetShadowResolution());
+			else
+				ImGui::Text("None");
 			ImGui::NextColumn();
 		}
 		else if (node->GetNodeType() == Node::LOCAL_LIGHT_NODE)
@@ -211,7 +226,8 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 
 			ImGui::PushItemWidth(-1);
 			ImGui::PushID(0);
-			ImGui::InputFloat3("", &localLight->m_intensity[0]);
+			if (ImGui::InputFloat3("", &localLight->m_intensity[0]))
+				localLight->Changed();
 			ImGui::PopID();
 			ImGui::PopItemWidth();
 			ImGui::NextColumn();
@@ -221,10 +237,20 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 
 			ImGui::PushItemWidth(-1);
 			ImGui::PushID(1);
-			ImGui::InputFloat("", &localLight->m_radius);
+			if (ImGui::InputFloat("", &localLight->m_radius))
+				localLight->Changed();
 			ImGui::PopID();
 			ImGui::PopItemWidth();
 			ImGui::NextColumn();
+
+			ImGui::Text("Cast Shadows:");
+			ImGui::NextColumn();
+
+			ImGui::PushID(2);
+			if (ImGui::Checkbox("", &localLight->m_castShadows))
+				localLight->Changed();
+			ImGui::PopID();
+			ImGui::NextColumn();
 		}
 
 		ImGui::Text("Translation:");
@@ -232,7 +258,8 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 		
 		ImGui::PushItemWidth(-1);
 		ImGui::PushID(10);
-		ImGui::InputFloat3("", &node->m_translation[0]);
+		if (ImGui::InputFloat3("", &node->m_translation[0]))
+			node->Changed();
 		ImGui::PopID();
 		ImGui::PopItemWidth();
 		ImGui::NextColumn();
@@ -242,7 +269,8 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 		
 		ImGui::PushItemWidth(-1);
 		ImGui::PushID(11);
-		ImGui::InputFloat3("", &node->m_scale[0]);
+		if (ImGui::InputFloat3("", &node->m_scale[0]))
+			node->Changed();
 		ImGui::PopID();
 		ImGui::PopItemWidth();
 		ImGui::NextColumn();
@@ -252,12 +280,13 @@ void GUI::TraverseNode(Node * node, Scene & scene)
 
 		ImGui::PushItemWidth(-1);
 		ImGui::PushID(12);
-		ImGui::InputFloat4("", &node->m_orientation[0]);
+		if (ImGui::InputFloat4("", &node->m_orientation[0]))
+			node->Changed();
 		ImGui::PopID();
 		ImGui::PopItemWidth();
 		ImGui::NextColumn();
 
-		for (auto child : node->m_children)
+		for (Node * child = node->m_firstChild; child; child = child->m_nextSibling)
 			TraverseNode(child, scene);
 		ImGui::TreePop();
 	}
@@ -352,7 +381,7 @@ void GUI::MaterialEditor(Material * material, Scene & scene)
 	ImGui::Spacing();
 }
 
-void GUI::GenerateGUI(Scene & scene)
+void GUI::GenerateGUI(Scene & scene, FrameQueue & frames)
 {
 	ImGui::SetNextWindowSize(ImVec2(300, 500), ImGuiSetCond_FirstUseEver);
 	if (!ImGui::Begin("Scene", 0, ImGuiWindowFlags_ShowBorders))
@@ -442,7 +471,7 @@ void GUI::GenerateGUI(Scene & scene)
 	{
 		ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(2, 2));
 		ImGui::Columns(2);
-		for (auto child : scene.m_rootNode->m_children)
+		for (Node * child = scene.m_rootNode->m_firstChild; child; child = child->m_nextSibling)
 			TraverseNode(child, scene);
 		ImGui::Columns(1);
 		ImGui::PopStyleVar();
@@ -498,9 +527,10 @@ void GUI::GenerateGUI(Scene & scene)
 		ImGui::Spacing();
 		if (ImGui::Button("Load Mesh"))
 		{
-			std::string path = scene.OpenFile("Wavefront OBJ\0*.obj\0");
-			if (path != "")
+			scene.OpenFile("Wavefront OBJ\0*.obj\0", [&scene](std::string const & path)
+			{
 				scene.CreateMesh(std::string(path.end() - 5, path.end()), path);
+			});
 		}
 		ImGui::Spacing();
 	}
@@ -530,17 +560,196 @@ void GUI::GenerateGUI(Scene & scene)
 		
 		if (ImGui::Button("Load Texture"))
 		{
-			std::string path = scene.OpenFile("PNG\0*.png\0");
-			if(path != "")
+			scene.OpenFile("PNG\0*.png\0", [&scene](std::string const & path)
+			{
 				scene.CreateTexture(std::string(path.end() - 5, path.end()), path, true);
+			});
+		}
+
+		ImGui::Separator();
+	}
+
+	if (ImGui::CollapsingHeader("Job System"))
+	{
+		ImGui::Text("Workers: %i", JobSystem::GetWorkersCount());
+		ImGui::Text("Jobs: %i (%i stolen)", JobSystem::GetExecutedJobsCount(), JobSystem::GetStolenJobsCount());
+
+		ImGui::Separator();
+
+		//the benchmark reconfigures the workers, the window thread must not be gathering meanwhile
+		if (ImGui::Button("Benchmark Traversal"))
+		{
+			frames.SuspendProducer();
+			BenchmarkTraversal(scene);
+			frames.ResumeProducer();
+		}
+
+		if (!m_benchmarkResults.empty())
+		{
+			ImGui::Text("Build: %.3f ms, Publish: %.3f ms", m_benchmarkBuildTime, m_benchmarkPublishTime);
+			ImGui::Text("Sequential Scene Nodes: %.1f%%", m_benchmarkSequentialSceneNodes * 100.0f);
+			ImGui::Text("Sequential Snapshot Nodes: %.1f%%", m_benchmarkSequentialSnapshotNodes * 100.0f);
 		}
 
+		for (auto const & result : m_benchmarkResults)
+			ImGui::Text("%i workers: %.3f ms (%.2fx)", result.first, result.second, m_benchmarkResults.front().second / result.second);
+
+		ImGui::Separator();
+	}
+
+	if (ImGui::CollapsingHeader("Scene Snapshot"))
+	{
+		std::shared_ptr<SceneSnapshot const> const snapshot = scene.GetSnapshot();
+		ImGui::Text("Version: %llu", snapshot->GetVersion());
+		ImGui::Text("Nodes: %i", snapshot->GetNodesCount());
+		ImGui::Text("Last Publish: %i changed, %i chunks copied", snapshot->GetChangedNodesCount(), snapshot->GetCopiedChunksCount());
+		ImGui::Text("Publish Time: %.3f ms", snapshot->GetPublishTime());
+
+		//scene nodes and their published copies share the pools
+		ImGui::Text("Pooled Nodes: %i / %i", NodePool<Node>::GetUsedCount(), NodePool<Node>::GetCapacity());
+		ImGui::Text("Pooled Objects: %i / %i", NodePool<Object>::GetUsedCount(), NodePool<Object>::GetCapacity());
+		ImGui::Text("Pooled Local Lights: %i / %i", NodePool<LocalLight>::GetUsedCount(), NodePool<LocalLight>::GetCapacity());
+
 		ImGui::Separator();
 	}
+
+	if (ImGui::CollapsingHeader("Frame Pipeline"))
+	{
+		float const frameTime = frames.GetFrameTime();
+		ImGui::Text("Throughput: %.1f fps (%.2f ms)", frameTime > 0.0f ? 1000.0f / frameTime : 0.0f, frameTime);
+		ImGui::Text("Preparation: %.2f ms", frames.GetPreparationTime());
+		ImGui::Text("Input Latency: %.2f ms (%.2f ms peak)", frames.GetLatency(), frames.GetMaxLatency());
+		ImGui::Text("Queued: %i / %i", frames.GetQueuedPacketsCount(), frames.GetCapacity());
+
+		ImGui::Separator();
+	}
+
+	//jobs are counted per frame
+	JobSystem::ResetStatistics();
 	
 	ImGui::End();
 }
 
+void GUI::BenchmarkTraversal(Scene & scene)
+{
+	//100k nodes in subtrees of a thousand, a quarter of them lights, objects share the first mesh and material of the scene
+	unsigned int const subtreesCount = 100;
+	unsigned int const subtreeSize = 1000;
+	unsigned int const repetitions = 10;
+
+	Scene benchmarkScene(scene.m_application, scene.m_windowWidth, scene.m_windowHeight);
+	benchmarkScene.m_projectionMatrix = scene.m_projectionMatrix;
+	benchmarkScene.m_viewMatrix = scene.m_viewMatrix;
+
+	Mesh * mesh = scene.m_meshes.empty() ? nullptr : scene.m_meshes.front().second.mesh;
+	Material * material = scene.m_materials.empty() ? nullptr : scene.m_materials.front().second.material;
+	auto const buildStart = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < subtreesCount; ++i)
+	{
+		Node * subtree = new Node("subtree" + std::to_string(i), glm::vec3((float)i, 0.0f, 0.0f), glm::quat());
+		for (unsigned int j = 1; j < subtreeSize; ++j)
+		{
+			glm::vec3 const translation((float)(j % 32), 0.0f, (float)(j / 32));
+			Node * node;
+			if (j % 4 == 0 || !mesh || !material)
+				node = new LocalLight(std::to_string(i * subtreeSize + j), glm::vec3(1.0f), 0.5f, translation, glm::quat());
+			else
+			{
+				node = new Object(std::to_string(i * subtreeSize + j), mesh, material);
+				node->SetTranslation(translation);
+			}
+			subtree->AddChild(node);
+		}
+		benchmarkScene.AddNode(subtree);
+	}
+	m_benchmarkBuildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+	benchmarkScene.PublishSnapshot();
+	std::shared_ptr<SceneSnapshot const> const snapshot = benchmarkScene.GetSnapshot();
+	m_benchmarkPublishTime = snapshot->GetPublishTime();
+
+	//cache misses cannot be counted portably, instead nodes are walked in traversal order and a node counts as sequential
+	//when it lies within a few cache lines after the last node of its type, a stride the prefetcher streams through
+	auto const isSequential = [](Node const * node, std::uintptr_t * previous)
+	{
+		std::uintptr_t const address = (std::uintptr_t)node;
+		std::uintptr_t & last = previous[node->GetNodeType()];
+		bool const sequential = last && address > last && address - last <= 256;
+		last = address;
+		return sequential;
+	};
+
+	//the write side nodes come from the pools and are followed through their links, depth first like the traversal
+	std::uintptr_t scenePrevious[Node::MAX_NODE_TYPES] = {};
+	unsigned int sceneNodesCount = 0;
+	unsigned int sequentialSceneNodesCount = 0;
+	std::vector<Node const *> stack(1, benchmarkScene.m_rootNode);
+	while (!stack.empty())
+	{
+		Node const * node = stack.back();
+		stack.pop_back();
+
+		sceneNodesCount++;
+		if (isSequential(node, scenePrevious))
+			sequentialSceneNodesCount++;
+
+		//the children are reversed on the stack so the first one is visited next
+		std::size_t const first = stack.size();
+		for (Node const * child = node->m_firstChild; child; child = child->m_nextSibling)
+			stack.push_back(child);
+		std::reverse(stack.begin() + first, stack.end());
+	}
+	m_benchmarkSequentialSceneNodes = (float)sequentialSceneNodesCount / sceneNodesCount;
+
+	//the snapshot clones are laid out in slot order
+	std::uintptr_t snapshotPrevious[Node::MAX_NODE_TYPES] = {};
+	unsigned int sequentialSnapshotNodesCount = 0;
+	for (unsigned int slot = 0; slot < snapshot->GetNodesCount(); ++slot)
+		if (isSequential(snapshot->GetNode(slot), snapshotPrevious))
+			sequentialSnapshotNodesCount++;
+	m_benchmarkSequentialSnapshotNodes = (float)sequentialSnapshotNodesCount / snapshot->GetNodesCount();
+
+	//gather the scene with 1, 2, 4... workers up to every core
+	unsigned int const defaultWorkersCount = JobSystem::GetWorkersCount();
+	std::vector<unsigned int> workersCounts;
+	for (unsigned int workers = 1; workers < defaultWorkersCount; workers *= 2)
+		workersCounts.push_back(workers);
+	workersCounts.push_back(defaultWorkersCount);
+
+	DeferredPass pass(nullptr);
+	std::vector<std::pair<GlobalLight const *, glm::vec3>> globalLights;
+	std::vector<LocalLightInformation> localLights;
+	std::vector<std::pair<LocalLight const *, unsigned int>> shadowedLocalLights;
+	std::vector<InstanceGroup> instanceGroups;
+	std::vector<glm::mat4> instanceTransforms;
+
+	m_benchmarkResults.clear();
+	for (auto const & workers : workersCounts)
+	{
+		JobSystem::Initialize(workers);
+
+		//the first run sizes the buckets
+		double total = 0.0;
+		for (unsigned int i = 0; i <= repetitions; ++i)
+		{
+			globalLights.clear();
+			localLights.clear();
+			shadowedLocalLights.clear();
+			instanceGroups.clear();
+			instanceTransforms.clear();
+
+			auto const start = std::chrono::steady_clock::now();
+			pass.ProcessScene(*snapshot, &globalLights, &localLights, &shadowedLocalLights, nullptr, &instanceGroups, &instanceTransforms);
+			if (i)
+				total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		m_benchmarkResults.push_back(std::make_pair(workers, total / repetitions));
+	}
+
+	JobSystem::Initialize(defaultWorkersCount);
+}
+
 void GUI::EndFrame()
 {
 	ImGui::Render();
@@ -1,22 +1,43 @@
 #include <Framework/GlobalLight.h>
+#include <Framework/NodePool.h>
 #include <Framework/Defaults.h>
-#include <GL/glew.h>
 
 #pragma region "Constructors/Destructor"
 
-GlobalLight::GlobalLight(std::string const & name, glm::vec3 const & intensity, glm::vec3 const & translation, glm::quat const & orientation) : Node(name, translation, orientation), m_intensity(intensity), m_shadowMatrix(1.0f), m_shadowMap(SHADOW_MAP_TEXTURE_UNIT, Texture::DEPTH)
+GlobalLight::GlobalLight(std::string const & name, glm::vec3 const & intensity, glm::vec3 const & translation, glm::quat const & orientation) : Node(name, translation, orientation), m_intensity(intensity), m_cascadeSplits(0.0f), m_shadowResolution(0), m_shadowCacheHits(0), m_shadowCacheLookups(0)
 {
-	CreateHandle();
+	ResetShadowState();
 }
 
-GlobalLight::GlobalLight(std::string const & name, glm::vec3 const & intensity) : Node(name), m_intensity(intensity), m_shadowMatrix(1.0f), m_shadowMap(SHADOW_MAP_TEXTURE_UNIT, Texture::DEPTH)
+GlobalLight::GlobalLight(std::string const & name, glm::vec3 const & intensity) : Node(name), m_intensity(intensity), m_cascadeSplits(0.0f), m_shadowResolution(0), m_shadowCacheHits(0), m_shadowCacheLookups(0)
 {
-	CreateHandle();
+	ResetShadowState();
 }
 
 GlobalLight::~GlobalLight()
 {
-	DestroyHandle();
+}
+
+void * GlobalLight::operator new(std::size_t size)
+{
+	return size == sizeof(GlobalLight) ? NodePool<GlobalLight>::Allocate() : ::operator new(size);
+}
+
+void GlobalLight::operator delete(void * pointer, std::size_t size)
+{
+	if (size == sizeof(GlobalLight))
+		NodePool<GlobalLight>::Free(pointer);
+	else
+		::operator delete(pointer);
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+Node * GlobalLight::Clone() const
+{
+	return new GlobalLight(*this);
 }
 
 #pragma endregion
@@ -28,14 +49,31 @@ glm::vec3 const & GlobalLight::GetIntensity() const
 	return m_intensity;
 }
 
-glm::mat4 const & GlobalLight::GetShadowMatrix() const
+glm::mat4 const & GlobalLight::GetShadowMatrix(unsigned int const & cascade) const
 {
-	return m_shadowMatrix;
+	return m_shadowMatrices[cascade];
 }
 
-Texture const & GlobalLight::GetShadowMap() const
+glm::vec4 const & GlobalLight::GetCascadeSplits() const
 {
-	return m_shadowMap;
+	return m_cascadeSplits;
+}
+
+glm::vec3 const & GlobalLight::GetShadowTile(unsigned int const & cascade) const
+{
+	return m_shadowTiles[cascade];
+}
+
+unsigned int const & GlobalLight::GetShadowResolution() const
+{
+	return m_shadowResolution;
+}
+
+float GlobalLight::GetShadowCacheHitRate() const
+{
+	if (m_shadowCacheLookups)
+		return (float)m_shadowCacheHits / (float)m_shadowCacheLookups;
+	return 0.0f;
 }
 
 Node::NodeType GlobalLight::GetNodeType() const
@@ -50,20 +88,21 @@ Node::NodeType GlobalLight::GetNodeType() const
 void GlobalLight::SetIntensity(glm::vec3 const & intensity)
 {
 	m_intensity = intensity;
+	Changed();
 }
 
 #pragma endregion
 
 #pragma region "Private Methods"
 
-void GlobalLight::CreateHandle()
-{
-	m_shadowMap.Initialize(DEFAULT_SHADOW_WIDTH, DEFAULT_SHADOW_HEIGHT, GL_RGBA32F, GL_RGBA, GL_FLOAT, 0);
-}
-
-void GlobalLight::DestroyHandle()
+void GlobalLight::ResetShadowState() const
 {
-	m_shadowMap.Free();
+	//the light casts no shadows until it gets atlas tiles again
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+	{
+		m_shadowMatrices[i] = glm::mat4(1.0f);
+		m_shadowTiles[i] = glm::vec3(0.0f);
+	}
 }
 
 #pragma endregion
\ No newline at end of file
@@ -7,7 +7,12 @@ Node const * const & IRenderer::GetRootNode(Scene const & scene) const
 	return scene.m_rootNode;
 }
 
-std::vector<Node *> const & IRenderer::GetChildren(Node const * const & node) const
+Node const * IRenderer::GetFirstChild(Node const * const & node) const
 {
-	return node->m_children;
+	return node->m_firstChild;
+}
+
+Node const * IRenderer::GetNextSibling(Node const * const & node) const
+{
+	return node->m_nextSibling;
 }
\ No newline at end of file
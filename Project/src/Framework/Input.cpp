@@ -2,7 +2,7 @@
 #include <Framework/Application.h>
 #include <imgui/imgui.h>
 
-Input::Input(Application * application) : m_application(application)
+Input::Input(Application * application) : m_application(application), m_io(nullptr), m_events(), m_firstEventTime()
 {
 }
 
@@ -35,48 +35,91 @@ void Input::Finalize()
 
 void Input::KeyDown(unsigned char key)
 {
-	m_io->KeysDown[key] = true;
-	if (key == VK_LCONTROL || key == VK_CONTROL || key == VK_RCONTROL)
-		m_io->KeyCtrl = true;
-	if (key == VK_LMENU || key == VK_RMENU || key == VK_MENU)
-		m_io->KeyAlt = true;
-	if (key == VK_LSHIFT || key == VK_RSHIFT || key == VK_SHIFT)
-		m_io->KeyShift = true;
+	RecordEvent(InputEvent::KEY_DOWN, key, 0);
 }
 
 void Input::KeyUp(unsigned char key)
 {
-	m_io->KeysDown[key] = false;
-	if (key == VK_LCONTROL || key == VK_CONTROL || key == VK_RCONTROL)
-		m_io->KeyCtrl = false;
-	if (key == VK_LMENU || key == VK_RMENU || key == VK_MENU)
-		m_io->KeyAlt = false;
-	if (key == VK_LSHIFT || key == VK_RSHIFT || key == VK_SHIFT)
-		m_io->KeyShift = false;
+	RecordEvent(InputEvent::KEY_UP, key, 0);
 }
 
 void Input::MouseMove(int x, int y)
 {
-	m_io->MousePos.x = x;
-	m_io->MousePos.y = y;
+	RecordEvent(InputEvent::MOUSE_MOVE, x, y);
 }
 
 void Input::MouseDown(char button)
 {
-	m_io->MouseDown[button] = true;
+	RecordEvent(InputEvent::MOUSE_DOWN, button, 0);
 }
 
 void Input::MouseUp(char button)
 {
-	m_io->MouseDown[button] = false;
+	RecordEvent(InputEvent::MOUSE_UP, button, 0);
 }
 
 void Input::MouseScroll(int value)
 {
-	m_io->MouseWheel = (float)value / 120.0f;
+	RecordEvent(InputEvent::MOUSE_SCROLL, value, 0);
 }
 
 void Input::CharInput(int character)
 {
-	m_io->AddInputCharacter(character);
+	RecordEvent(InputEvent::CHARACTER_INPUT, character, 0);
+}
+
+bool Input::TakeEvents(std::vector<InputEvent> & events, std::chrono::steady_clock::time_point & firstEventTime)
+{
+	events.clear();
+	events.swap(m_events);
+	firstEventTime = m_firstEventTime;
+	return !events.empty();
+}
+
+void Input::ApplyEvents(std::vector<InputEvent> const & events)
+{
+	for (auto const & e : events)
+	{
+		switch (e.type)
+		{
+		case InputEvent::KEY_DOWN:
+		case InputEvent::KEY_UP:
+		{
+			bool const down = e.type == InputEvent::KEY_DOWN;
+			m_io->KeysDown[e.x] = down;
+			if (e.x == VK_LCONTROL || e.x == VK_CONTROL || e.x == VK_RCONTROL)
+				m_io->KeyCtrl = down;
+			if (e.x == VK_LMENU || e.x == VK_RMENU || e.x == VK_MENU)
+				m_io->KeyAlt = down;
+			if (e.x == VK_LSHIFT || e.x == VK_RSHIFT || e.x == VK_SHIFT)
+				m_io->KeyShift = down;
+			break;
+		}
+		case InputEvent::MOUSE_MOVE:
+			m_io->MousePos.x = e.x;
+			m_io->MousePos.y = e.y;
+			break;
+		case InputEvent::MOUSE_DOWN:
+			m_io->MouseDown[e.x] = true;
+			break;
+		case InputEvent::MOUSE_UP:
+			m_io->MouseDown[e.x] = false;
+			break;
+		case InputEvent::MOUSE_SCROLL:
+			m_io->MouseWheel = (float)e.x / 120.0f;
+			break;
+		case InputEvent::CHARACTER_INPUT:
+			m_io->AddInputCharacter(e.x);
+			break;
+		}
+	}
+}
+
+void Input::RecordEvent(InputEvent::InputEventType type, int x, int y)
+{
+	//the latency of a frame is measured from the oldest input it carries
+	if (m_events.empty())
+		m_firstEventTime = std::chrono::steady_clock::now();
+
+	m_events.push_back({ type, x, y });
 }
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include <Framework/JobSystem.h>
+#include <Framework/Defaults.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+struct Job
+{
+	std::function<void()> work;
+	JobCounter * counter;
+};
+
+//each worker pushes and pops at the back of its own deque, idle workers steal the oldest jobs from the front of the others
+struct WorkerQueue
+{
+	std::mutex mutex;
+	std::deque<Job> jobs;
+};
+
+static struct JobSystemState
+{
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> threads;
+	unsigned int workersCount = 1;
+	std::atomic<bool> running{ false };
+	std::atomic<unsigned int> queuedJobs{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+	std::atomic<unsigned int> executedJobs{ 0 };
+	std::atomic<unsigned int> stolenJobs{ 0 };
+} g_jobs;
+
+//threads outside of the pool, the window and the render thread, submit to the first queue, nobody owns it so everyone takes its oldest jobs
+static unsigned int const g_submissionQueue = 0;
+static thread_local unsigned int t_workerIndex = g_submissionQueue;
+
+static void Push(Job const & job)
+{
+	WorkerQueue & queue = *g_jobs.queues[t_workerIndex];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+	g_jobs.queuedJobs++;
+
+	//taking the lock makes sure a worker going to sleep either sees the job or gets the notification
+	{
+		std::lock_guard<std::mutex> lock(g_jobs.sleepMutex);
+	}
+	g_jobs.wakeUp.notify_one();
+}
+
+static bool Pop(Job & job)
+{
+	if (!g_jobs.queuedJobs)
+		return false;
+
+	unsigned int const count = (unsigned int)g_jobs.queues.size();
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		WorkerQueue & queue = *g_jobs.queues[(t_workerIndex + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			continue;
+
+		if (i == 0 && t_workerIndex != g_submissionQueue)
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			if (i)
+				g_jobs.stolenJobs++;
+		}
+
+		g_jobs.queuedJobs--;
+		return true;
+	}
+
+	return false;
+}
+
+#pragma region "Constructors/Destructor"
+
+JobCounter::JobCounter() : m_pending(0), m_mutex(), m_continuations()
+{
+
+}
+
+JobCounter::~JobCounter()
+{
+
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+bool JobCounter::IsDone() const
+{
+	return m_pending == 0;
+}
+
+#pragma endregion
+
+#pragma region "Static Methods"
+
+void JobSystem::Initialize(unsigned int const & workersCount)
+{
+	Finalize();
+
+	//the pool threads own the queues after the submission queue, threads waiting from outside of the pool make up the first worker
+	g_jobs.workersCount = workersCount ? workersCount : std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned int i = 0; i < g_jobs.workersCount; ++i)
+		g_jobs.queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+
+	g_jobs.running = true;
+	for (unsigned int i = 1; i < g_jobs.workersCount; ++i)
+		g_jobs.threads.push_back(std::thread(WorkerLoop, i));
+}
+
+void JobSystem::Finalize()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_jobs.sleepMutex);
+		g_jobs.running = false;
+	}
+	g_jobs.wakeUp.notify_all();
+
+	for (auto & thread : g_jobs.threads)
+		thread.join();
+
+	g_jobs.threads.clear();
+	g_jobs.queues.clear();
+	g_jobs.workersCount = 1;
+}
+
+void JobSystem::Run(std::function<void()> const & work, JobCounter & counter)
+{
+	counter.m_pending++;
+
+	Job job = { work, &counter };
+	if (g_jobs.queues.empty())
+		Execute(job);
+	else
+		Push(job);
+}
+
+void JobSystem::Then(JobCounter & dependency, std::function<void()> const & work, JobCounter & counter)
+{
+	counter.m_pending++;
+
+	{
+		std::lock_guard<std::mutex> lock(dependency.m_mutex);
+		if (dependency.m_pending)
+		{
+			dependency.m_continuations.push_back({ work, &counter });
+			return;
+		}
+	}
+
+	Job job = { work, &counter };
+	if (g_jobs.queues.empty())
+		Execute(job);
+	else
+		Push(job);
+}
+
+void JobSystem::Wait(JobCounter & counter)
+{
+	while (counter.m_pending)
+	{
+		Job job;
+		if (Pop(job))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+
+	//the last job may still be releasing the counter
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::ParallelFor(unsigned int const & itemsCount, unsigned int const & grainSize, std::function<void(unsigned int, unsigned int, unsigned int)> const & body)
+{
+	unsigned int const chunksCount = GetChunksCount(itemsCount, grainSize);
+	if (chunksCount <= 1)
+	{
+		if (itemsCount)
+			body(0, 0, itemsCount);
+		return;
+	}
+
+	//the last chunks are queued first so a calling worker pops the next chunk in order while thieves take the far end
+	JobCounter counter;
+	for (unsigned int chunk = chunksCount - 1; chunk > 0; --chunk)
+	{
+		unsigned int const begin = (unsigned int)((unsigned long long)itemsCount * chunk / chunksCount);
+		unsigned int const end = (unsigned int)((unsigned long long)itemsCount * (chunk + 1) / chunksCount);
+		Run([&body, chunk, begin, end]() { body(chunk, begin, end); }, counter);
+	}
+
+	body(0, 0, itemsCount / chunksCount);
+	Wait(counter);
+}
+
+unsigned int JobSystem::GetChunksCount(unsigned int const & itemsCount, unsigned int const & grainSize)
+{
+	//more chunks than workers leaves something to steal when the chunks are uneven
+	unsigned int const grain = std::max(grainSize, 1u);
+	unsigned int const maxChunks = g_jobs.workersCount > 1 ? g_jobs.workersCount * JOB_CHUNKS_PER_WORKER : 1;
+	return std::min(maxChunks, (itemsCount + grain - 1) / grain);
+}
+
+unsigned int const & JobSystem::GetWorkersCount()
+{
+	return g_jobs.workersCount;
+}
+
+#pragma endregion
+
+#pragma region "Statistical Information"
+
+void JobSystem::ResetStatistics()
+{
+	g_jobs.executedJobs = 0;
+	g_jobs.stolenJobs = 0;
+}
+
+unsigned int JobSystem::GetExecutedJobsCount()
+{
+	return g_jobs.executedJobs;
+}
+
+unsigned int JobSystem::GetStolenJobsCount()
+{
+	return g_jobs.stolenJobs;
+}
+
+#pragma endregion
+
+#pragma region "Private Methods"
+
+void JobSystem::WorkerLoop(unsigned int const index)
+{
+	t_workerIndex = index;
+	while (g_jobs.running)
+	{
+		Job job;
+		if (Pop(job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(g_jobs.sleepMutex);
+		g_jobs.wakeUp.wait(lock, []() { return !g_jobs.running || g_jobs.queuedJobs > 0; });
+	}
+}
+
+void JobSystem::Execute(Job & job)
+{
+	job.work();
+	g_jobs.executedJobs++;
+	Finish(*job.counter);
+}
+
+void JobSystem::Finish(JobCounter & counter)
+{
+	std::vector<JobCounter::Continuation> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_mutex);
+		if (--counter.m_pending == 0)
+			continuations.swap(counter.m_continuations);
+	}
+
+	//the counter may be gone as soon as it is released, continuations carry their own
+	for (auto const & continuation : continuations)
+	{
+		Job job = { continuation.work, continuation.counter };
+		if (g_jobs.queues.empty())
+			Execute(job);
+		else
+			Push(job);
+	}
+}
+
+#pragma endregion
@@ -5,14 +5,17 @@
 #include <Framework/DeferredRenderer.h>
 #include <Framework/Scene.h>
 #include <Framework/Shape.h>
+#include <Framework/StateCache.h>
+#include <Framework/Texture.h>
 #include <Framework/Defaults.h>
 
 #include <GL/glew.h>
+#include <algorithm>
 #include <cmath>
 
 #pragma region "Constructors/Destructor"
 
-LightingPass::LightingPass(IRenderer const * renderer) : m_renderer(renderer), m_globalLights(nullptr), m_localLightsCount(0), m_ambientLightProgram(), m_globalLightProgram(), m_localLightProgram()
+LightingPass::LightingPass(IRenderer const * renderer) : m_renderer(renderer), m_globalLights(nullptr), m_localLightsCount(0), m_sphereLightsCount(0), m_quadProxySize(0.25f), m_globalLightsBuffer(6, 8), m_batchGlobalLights(true), m_localLightingResolution(FULL_RESOLUTION), m_directLocalLighting(false), m_checkerboardLocalLights(false), m_historyValid(false), m_frameIndex(0), m_viewMatrix(), m_projectionMatrix(), m_previousViewMatrix(), m_previousProjectionMatrix(), m_previousRenderSize(), m_localLightInvocations(GL_FRAGMENT_SHADER_INVOCATIONS_ARB), m_stencilVolumes(true), m_drawCommandBuffer(8, 2), m_visibleLightsBuffer(7, 1000), m_depthPyramid(DEPTH_PYRAMID_TEXTURE_UNIT), m_depthPyramidLevels(0), m_gpuCulling(true), m_occlusionCulling(true), m_visibleCountBuffer(0), m_visibleCountFence(0), m_visibleLightsCount(0), m_ambientLightProgram(), m_globalLightProgram(), m_batchedLightProgram(), m_localLightProgram(), m_localLightStencilProgram(), m_depthPyramidProgram(), m_lightCullingProgram(), m_downsampleProgram(), m_upsampleProgram(), m_temporalResolveProgram()
 {
 }
 
@@ -24,6 +27,10 @@ LightingPass::~LightingPass()
 
 #pragma region "Public Methods"
 
+static char const * const g_cascadeMatrixNames[SHADOW_CASCADE_COUNT] = { "uShadow.matrices[0]", "uShadow.matrices[1]", "uShadow.matrices[2]", "uShadow.matrices[3]" };
+static char const * const g_cascadeTileNames[SHADOW_CASCADE_COUNT] = { "uShadow.tiles[0]", "uShadow.tiles[1]", "uShadow.tiles[2]", "uShadow.tiles[3]" };
+static char const * const g_frustumPlaneNames[6] = { "uFrustumPlanes[0]", "uFrustumPlanes[1]", "uFrustumPlanes[2]", "uFrustumPlanes[3]", "uFrustumPlanes[4]", "uFrustumPlanes[5]" };
+
 void LightingPass::Initialize()
 {
 	m_ambientLightProgram.CreateHandle();
@@ -43,6 +50,21 @@ void LightingPass::Initialize()
 	m_globalLightProgram.SetUniform("uColor2", 3);
 	m_globalLightProgram.SetUniform("uColor3", 4);
 	m_globalLightProgram.SetUniform("uShadow.map", 7);
+	m_globalLightProgram.SetUniform("uShadow.moments", 13);
+
+	m_batchedLightProgram.CreateHandle();
+	m_batchedLightProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/GlobalLightPass.vert");
+	m_batchedLightProgram.AttachShader(Program::FRAGMENT_SHADER_TYPE, "src/Shaders/BatchedLightPass.frag");
+	m_batchedLightProgram.Link();
+
+	m_batchedLightProgram.SetUniform("uColor0", 1);
+	m_batchedLightProgram.SetUniform("uColor1", 2);
+	m_batchedLightProgram.SetUniform("uColor2", 3);
+	m_batchedLightProgram.SetUniform("uColor3", 4);
+	m_batchedLightProgram.SetUniform("uShadow.map", 7);
+	m_batchedLightProgram.SetUniform("uShadow.moments", 13);
+
+	m_globalLightsBuffer.Initialize();
 
 	m_localLightProgram.CreateHandle();
 	m_localLightProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/LocalLightPass.vert");
@@ -53,7 +75,65 @@ void LightingPass::Initialize()
 	m_localLightProgram.SetUniform("uColor1", 2);
 	m_localLightProgram.SetUniform("uColor2", 3);
 	m_localLightProgram.SetUniform("uColor3", 4);
+	m_localLightProgram.SetUniform("uShadowAtlas", 7);
+
+	//marks the pixels inside the light volumes, no fragment shader is attached
+	m_localLightStencilProgram.CreateHandle();
+	m_localLightStencilProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/LocalLightPass.vert");
+	m_localLightStencilProgram.Link();
+
+	if (GLEW_ARB_pipeline_statistics_query)
+		m_localLightInvocations.Initialize();
+
+	m_depthPyramidProgram.CreateHandle();
+	m_depthPyramidProgram.AttachShader(Program::COMPUTE_SHADER_TYPE, "src/Shaders/DepthPyramid.comp");
+	m_depthPyramidProgram.Link();
+
+	m_depthPyramidProgram.SetUniform("uDepth", 5);
+
+	m_lightCullingProgram.CreateHandle();
+	m_lightCullingProgram.AttachShader(Program::COMPUTE_SHADER_TYPE, "src/Shaders/LightCulling.comp");
+	m_lightCullingProgram.Link();
+
+	m_lightCullingProgram.SetUniform("uDepthPyramid", 14);
+
+	m_downsampleProgram.CreateHandle();
+	m_downsampleProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/GlobalLightPass.vert");
+	m_downsampleProgram.AttachShader(Program::FRAGMENT_SHADER_TYPE, "src/Shaders/LightingDownsample.frag");
+	m_downsampleProgram.Link();
+
+	m_downsampleProgram.SetUniform("uColor0", 1);
+	m_downsampleProgram.SetUniform("uColor1", 2);
+	m_downsampleProgram.SetUniform("uColor2", 3);
+	m_downsampleProgram.SetUniform("uColor3", 4);
+	m_downsampleProgram.SetUniform("uDepth", 5);
+
+	m_upsampleProgram.CreateHandle();
+	m_upsampleProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/GlobalLightPass.vert");
+	m_upsampleProgram.AttachShader(Program::FRAGMENT_SHADER_TYPE, "src/Shaders/LightingUpsample.frag");
+	m_upsampleProgram.Link();
+
+	m_upsampleProgram.SetUniform("uColor0", 1);
+	m_upsampleProgram.SetUniform("uColor1", 2);
+	m_upsampleProgram.SetUniform("uReducedColor0", 15);
+	m_upsampleProgram.SetUniform("uReducedColor1", 16);
+	m_upsampleProgram.SetUniform("uReducedLighting", 20);
+
+	m_temporalResolveProgram.CreateHandle();
+	m_temporalResolveProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/GlobalLightPass.vert");
+	m_temporalResolveProgram.AttachShader(Program::FRAGMENT_SHADER_TYPE, "src/Shaders/TemporalResolve.frag");
+	m_temporalResolveProgram.Link();
+
+	m_temporalResolveProgram.SetUniform("uColor0", 1);
+	m_temporalResolveProgram.SetUniform("uColor1", 2);
+	m_temporalResolveProgram.SetUniform("uLocalLighting", 21);
 
+	m_drawCommandBuffer.Initialize();
+	m_visibleLightsBuffer.Initialize();
+
+	glGenBuffers(1, &m_visibleCountBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_visibleCountBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, sizeof(DrawCommand) * 2, 0, GL_STREAM_READ);
 }
 
 void LightingPass::Prepare(Scene const & scene) const
@@ -64,68 +144,459 @@ void LightingPass::Prepare(Scene const & scene) const
 	deferredRenderer->BindLightAccumulationBuffer();
 	
 	glClear(GL_COLOR_BUFFER_BIT);
-	glEnable(GL_BLEND);
+	StateCache::Enable(GL_BLEND);
+
+	StateCache::Disable(GL_DEPTH_TEST);
+	StateCache::SetDepthMask(false);
 
-	glDisable(GL_DEPTH_TEST);
-	glDepthMask(GL_FALSE);
+	m_viewMatrix = scene.GetViewMatrix();
+	m_projectionMatrix = scene.GetProjectionMatrix();
 
 	m_ambientLightProgram.SetUniform("uAmbientIntensity", scene.GetAmbientIntensity());
+	m_batchedLightProgram.SetUniform("uAmbientIntensity", scene.GetAmbientIntensity());
+}
+
+void LightingPass::SelectLightProxies(Scene const & scene, std::vector<struct LocalLightInformation> & localLights) const
+{
+	glm::mat4 const & viewMatrix = scene.GetViewMatrix();
+	float const projectionScale = scene.GetProjectionMatrix()[1][1];
+	float const frontPlane = scene.GetFrontPlane();
+
+	//small or distant lights are bounded by a quad, large ones and those crossing the near plane by a sphere
+	auto const quads = std::partition(localLights.begin(), localLights.end(), [&](LocalLightInformation const & light)
+	{
+		float const depth = -(viewMatrix * glm::vec4(light.position[0], light.position[1], light.position[2], 1.0f)).z;
+		if (depth - light.radius <= frontPlane)
+			return true;
+		return light.radius * projectionScale / depth > m_quadProxySize;
+	});
+
+	m_sphereLightsCount = quads - localLights.begin();
+}
+
+void LightingPass::CullLocalLights(Scene const & scene, unsigned int const & lightsCount, Texture const & depthBuffer) const
+{
+	//pick up the visible count of an earlier frame once the gpu has finished it
+	if (m_visibleCountFence)
+	{
+		GLenum const status = glClientWaitSync(m_visibleCountFence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			DrawCommand commands[2];
+			glBindBuffer(GL_COPY_READ_BUFFER, m_visibleCountBuffer);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(commands), commands);
+			m_visibleLightsCount = commands[0].instanceCount + commands[1].instanceCount;
+
+			glDeleteSync(m_visibleCountFence);
+			m_visibleCountFence = 0;
+		}
+	}
+
+	if (!m_gpuCulling)
+		return;
+
+	//both draws start out empty, the culling shader counts their instances
+	m_drawCommandBuffer.m_buffer[0] = { Shape::GetSphere()->GetIndexCount(), 0, 0, 0, 0 };
+	m_drawCommandBuffer.m_buffer[1] = { Shape::GetFullScreenQuad()->GetIndexCount(), 0, 0, 0, 0 };
+	m_drawCommandBuffer.Upload();
+	m_visibleLightsBuffer.Reserve(lightsCount);
+
+	if (lightsCount)
+	{
+		DeferredRenderer const * deferredRenderer = dynamic_cast<DeferredRenderer const *>(m_renderer);
+		if (m_occlusionCulling)
+			BuildDepthPyramid(depthBuffer);
+
+		//planes of the view frustum in world space, normalized so the light radius can be compared directly
+		glm::mat4 const viewProjection = scene.GetProjectionMatrix() * scene.GetViewMatrix();
+		glm::vec4 const w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+		for (int i = 0; i < 3; ++i)
+		{
+			glm::vec4 const axis(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+			glm::vec4 const lower = w + axis;
+			glm::vec4 const upper = w - axis;
+			m_lightCullingProgram.SetUniform(g_frustumPlaneNames[i * 2 + 0], lower / glm::length(glm::vec3(lower)));
+			m_lightCullingProgram.SetUniform(g_frustumPlaneNames[i * 2 + 1], upper / glm::length(glm::vec3(upper)));
+		}
+
+		m_lightCullingProgram.Use();
+		m_lightCullingProgram.SetUniform("uLightsCount", (int)lightsCount);
+		m_lightCullingProgram.SetUniform("uSphereLightsCount", (int)m_sphereLightsCount);
+		m_lightCullingProgram.SetUniform("uFrontPlane", scene.GetFrontPlane());
+		m_lightCullingProgram.SetUniform("uOcclusionCulling", m_occlusionCulling);
+		m_lightCullingProgram.SetUniform("uDepthPyramidLevels", (int)m_depthPyramidLevels);
+		m_lightCullingProgram.SetUniform("uDepthPyramidSize", glm::vec2(deferredRenderer->GetRenderWidth(), deferredRenderer->GetRenderHeight()));
+
+		glDispatchCompute((lightsCount + 63) / 64, 1, 1);
+	}
+
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	if (!m_visibleCountFence)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_drawCommandBuffer.m_handle);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_visibleCountBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(DrawCommand) * 2);
+		m_visibleCountFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
 }
 
 void LightingPass::ProcessAmbientLight() const
 {
-	m_ambientLightProgram.Use();
+	StateCache::BindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
 
-	glBindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
-	glEnableVertexAttribArray(0);
+	//the batched pass adds the ambient term together with the global lights
+	if (m_batchGlobalLights)
+		return;
 
+	m_ambientLightProgram.Use();
 	glDrawElements(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0);
 }
 
-void LightingPass::ProcessGlobalLights(std::vector<std::pair<GlobalLight const *,glm::vec3>> const & globalLights) const
+void LightingPass::ProcessGlobalLights(std::vector<std::pair<GlobalLight const *,glm::vec3>> const & globalLights, ShadowPass const & shadowPass) const
 {
 	m_globalLights = &globalLights;
-	
+
+	shadowPass.GetShadowAtlas().Bind();
+	shadowPass.GetMomentsAtlas().Bind();
+
+	if (m_batchGlobalLights)
+	{
+		//one pass reads the g-buffer once per pixel and loops over every light
+		m_globalLightsBuffer.m_buffer.clear();
+		for (auto const & lightPair : globalLights)
+		{
+			GlobalLightInformation information;
+			information.position = glm::vec4(lightPair.second, 1.0f);
+			information.intensity = glm::vec4(lightPair.first->GetIntensity(), 0.0f);
+			for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+			{
+				information.shadowMatrices[i] = lightPair.first->GetShadowMatrix(i);
+				information.shadowTiles[i] = glm::vec4(lightPair.first->GetShadowTile(i), 0.0f);
+			}
+			information.cascadeSplits = lightPair.first->GetCascadeSplits();
+			m_globalLightsBuffer.m_buffer.push_back(information);
+		}
+		m_globalLightsBuffer.Upload();
+
+		m_batchedLightProgram.Use();
+		m_batchedLightProgram.SetUniform("uGlobalLightsCount", (int)globalLights.size());
+		m_batchedLightProgram.SetUniform("uShadow.mode", shadowPass.GetShadowFilter());
+		m_batchedLightProgram.SetUniform("uShadow.exponents", shadowPass.GetMomentsExponents());
+		m_batchedLightProgram.SetUniform("uShadow.bleedingReduction", shadowPass.GetLightBleedingReduction());
+
+		glDrawElements(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0);
+
+		return;
+	}
+
 	m_globalLightProgram.Use();
 
+	m_globalLightProgram.SetUniform("uShadow.mode", shadowPass.GetShadowFilter());
+	m_globalLightProgram.SetUniform("uShadow.exponents", shadowPass.GetMomentsExponents());
+	m_globalLightProgram.SetUniform("uShadow.bleedingReduction", shadowPass.GetLightBleedingReduction());
+
 	for (auto const & lightPair : globalLights)
 	{
 		m_globalLightProgram.SetUniform("uLight.position", lightPair.second);
 		m_globalLightProgram.SetUniform("uLight.intensity", lightPair.first->GetIntensity());
 
-		m_globalLightProgram.SetUniform("uShadow.matrix", lightPair.first->GetShadowMatrix());
-		lightPair.first->GetShadowMap().Bind();
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+		{
+			m_globalLightProgram.SetUniform(g_cascadeMatrixNames[i], lightPair.first->GetShadowMatrix(i));
+			m_globalLightProgram.SetUniform(g_cascadeTileNames[i], lightPair.first->GetShadowTile(i));
+		}
+		m_globalLightProgram.SetUniform("uShadow.splits", lightPair.first->GetCascadeSplits());
 
 		glDrawElements(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0);
 	}
-
-	glDisableVertexAttribArray(0);
-	glBindVertexArray(0);
 }
 
-void LightingPass::ProcessLocalLights(unsigned int const & lightsCount) const
+void LightingPass::ProcessLocalLights(unsigned int const & lightsCount, Texture const & shadowAtlas) const
 {
 	m_localLightsCount = lightsCount;
 
-	glEnable(GL_DEPTH_TEST);
+	if (GLEW_ARB_pipeline_statistics_query)
+		m_localLightInvocations.Begin();
+
+	shadowAtlas.Bind();
+
+	DeferredRenderer const * deferredRenderer = dynamic_cast<DeferredRenderer const *>(m_renderer);
+	int const scale = GetLocalLightingScale();
+
+	//reduced resolution lighting reads a downsampled copy of the g-buffer, with its own depth for the proxies
+	if (scale > 1)
+	{
+		deferredRenderer->BindReducedGBuffer();
 
-	m_localLightProgram.Use();
+		StateCache::Disable(GL_BLEND);
+		StateCache::Enable(GL_DEPTH_TEST);
+		StateCache::SetDepthFunc(GL_ALWAYS);
+		StateCache::SetDepthMask(true);
+		glClear(GL_STENCIL_BUFFER_BIT);
 
-	glBindVertexArray(Shape::GetIcosahedron()->GetVAO());
-	glEnableVertexAttribArray(0);
-	glDrawElementsInstanced(GL_TRIANGLES, Shape::GetIcosahedron()->GetIndexCount(), GL_UNSIGNED_INT, 0, lightsCount);
-	glDisableVertexAttribArray(0);
-	glBindVertexArray(0);
+		m_downsampleProgram.Use();
+		m_downsampleProgram.SetUniform("uScale", scale);
+		m_downsampleProgram.SetUniform("uRenderSize", glm::vec2(deferredRenderer->GetRenderWidth(), deferredRenderer->GetRenderHeight()));
 
-	glDepthMask(GL_TRUE);
+		StateCache::BindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
+		glDrawElements(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0);
+
+		StateCache::SetDepthFunc(GL_LESS);
+		StateCache::SetDepthMask(false);
+		StateCache::Enable(GL_BLEND);
+
+		deferredRenderer->BindReducedLightingBuffer();
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	bool const checkerboard = IsCheckerboarding();
+	if (checkerboard)
+	{
+		deferredRenderer->BindLocalLightingBuffer();
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	else
+		m_historyValid = false;
+
+	m_localLightProgram.SetUniform("uCheckerboard", checkerboard);
+	m_localLightProgram.SetUniform("uFrameParity", (int)(m_frameIndex & 1));
+
+	int const unit = scale > 1 ? 15 : 1;
+	m_localLightProgram.SetUniform("uColor0", unit + 0);
+	m_localLightProgram.SetUniform("uColor1", unit + 1);
+	m_localLightProgram.SetUniform("uColor2", unit + 2);
+	m_localLightProgram.SetUniform("uColor3", unit + 3);
+
+	StateCache::BindVertexArray(Shape::GetSphere()->GetVAO());
+	m_localLightProgram.SetUniform("uScreenQuad", false);
+	m_localLightProgram.SetUniform("uCompacted", false);
+
+	if (m_gpuCulling)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommandBuffer.m_handle);
+
+	if (m_stencilVolumes)
+	{
+		StateCache::Enable(GL_STENCIL_TEST);
+		//back faces behind the far plane still have to flip the stencil
+		StateCache::Enable(GL_DEPTH_CLAMP);
+
+		//every light of a group owns one stencil bit, so the group is marked and shaded with two state changes
+		for (unsigned int group = 0; group < m_sphereLightsCount; group += 8)
+		{
+			unsigned int const groupSize = glm::min(m_sphereLightsCount - group, 8u);
+
+			//a pixel is inside a convex volume when an odd number of its faces lie behind the geometry
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			StateCache::Enable(GL_DEPTH_TEST);
+			StateCache::Disable(GL_CULL_FACE);
+			glStencilFunc(GL_ALWAYS, 0, 0xFF);
+			glStencilOp(GL_KEEP, GL_INVERT, GL_KEEP);
+
+			m_localLightStencilProgram.Use();
+			for (unsigned int i = 0; i < groupSize; ++i)
+			{
+				glStencilMask(1 << i);
+				m_localLightStencilProgram.SetUniform("uLightOffset", (int)(group + i));
+				glDrawElements(GL_TRIANGLES, Shape::GetSphere()->GetIndexCount(), GL_UNSIGNED_INT, 0);
+			}
+
+			//back faces cover the volume even with the camera inside, shading clears the bit again for the next group
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			StateCache::Disable(GL_DEPTH_TEST);
+			StateCache::Enable(GL_CULL_FACE);
+			StateCache::SetCullFace(GL_FRONT);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+
+			m_localLightProgram.Use();
+			for (unsigned int i = 0; i < groupSize; ++i)
+			{
+				glStencilFunc(GL_EQUAL, 0xFF, 1 << i);
+				glStencilMask(1 << i);
+				m_localLightProgram.SetUniform("uLightOffset", (int)(group + i));
+				glDrawElements(GL_TRIANGLES, Shape::GetSphere()->GetIndexCount(), GL_UNSIGNED_INT, 0);
+			}
+		}
+
+		StateCache::SetCullFace(GL_BACK);
+		glStencilMask(0xFF);
+		StateCache::Disable(GL_DEPTH_CLAMP);
+		StateCache::Disable(GL_STENCIL_TEST);
+	}
+	else
+	{
+		StateCache::Enable(GL_DEPTH_TEST);
+
+		m_localLightProgram.Use();
+		m_localLightProgram.SetUniform("uLightOffset", 0);
+		if (m_gpuCulling)
+		{
+			m_localLightProgram.SetUniform("uCompacted", true);
+			glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0);
+		}
+		else
+			glDrawElementsInstanced(GL_TRIANGLES, Shape::GetSphere()->GetIndexCount(), GL_UNSIGNED_INT, 0, m_sphereLightsCount);
+	}
+
+	//quads are placed at the closest point of their sphere, the depth test rejects pixels in front of it
+	if (m_sphereLightsCount < lightsCount)
+	{
+		StateCache::Enable(GL_DEPTH_TEST);
+
+		m_localLightProgram.Use();
+		m_localLightProgram.SetUniform("uScreenQuad", true);
+		m_localLightProgram.SetUniform("uLightOffset", (int)m_sphereLightsCount);
+
+		StateCache::BindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
+		if (m_gpuCulling)
+		{
+			m_localLightProgram.SetUniform("uCompacted", true);
+			glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void const *)sizeof(DrawCommand));
+		}
+		else
+			glDrawElementsInstanced(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0, lightsCount - m_sphereLightsCount);
+	}
+
+	//joint bilateral upsample into the full resolution light accumulation
+	if (scale > 1)
+	{
+		deferredRenderer->BindLightAccumulationBuffer();
+		StateCache::Disable(GL_DEPTH_TEST);
+
+		m_upsampleProgram.Use();
+		m_upsampleProgram.SetUniform("uScale", scale);
+		m_upsampleProgram.SetUniform("uRenderSize", glm::vec2(deferredRenderer->GetRenderWidth(), deferredRenderer->GetRenderHeight()));
+
+		StateCache::BindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
+		glDrawElements(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0);
+	}
+
+	//fill the pixels skipped this frame from history and add the local lighting to the accumulation
+	if (checkerboard)
+	{
+		unsigned int const history = m_frameIndex & 1;
+		glm::vec2 const renderSize(deferredRenderer->GetRenderWidth(), deferredRenderer->GetRenderHeight());
+
+		deferredRenderer->BindTemporalResolveBuffer(history);
+		StateCache::Disable(GL_DEPTH_TEST);
+		StateCache::Disable(GL_BLEND, 1);
+		StateCache::Disable(GL_BLEND, 2);
+
+		m_temporalResolveProgram.Use();
+		m_temporalResolveProgram.SetUniform("uHistory", 22 + (int)(history ^ 1));
+		m_temporalResolveProgram.SetUniform("uHistoryNormals", 24 + (int)(history ^ 1));
+		m_temporalResolveProgram.SetUniform("uHistoryValid", m_historyValid);
+		m_temporalResolveProgram.SetUniform("uPreviousViewMatrix", m_previousViewMatrix);
+		m_temporalResolveProgram.SetUniform("uPreviousProjectionMatrix", m_previousProjectionMatrix);
+		m_temporalResolveProgram.SetUniform("uPreviousRenderSize", m_previousRenderSize);
+		m_temporalResolveProgram.SetUniform("uRenderSize", renderSize);
+		m_temporalResolveProgram.SetUniform("uFrameParity", (int)(m_frameIndex & 1));
+
+		StateCache::BindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
+		glDrawElements(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0);
+
+		StateCache::Enable(GL_BLEND);
+
+		m_previousViewMatrix = m_viewMatrix;
+		m_previousProjectionMatrix = m_projectionMatrix;
+		m_previousRenderSize = renderSize;
+		m_historyValid = true;
+	}
+	m_frameIndex++;
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	if (GLEW_ARB_pipeline_statistics_query)
+		m_localLightInvocations.End();
+
+	StateCache::SetDepthMask(true);
 	
 }
 
 void LightingPass::Finalize()
 {
 	m_localLightProgram.DestroyHandle();
+	m_localLightStencilProgram.DestroyHandle();
 	m_globalLightProgram.DestroyHandle();
+	m_batchedLightProgram.DestroyHandle();
 	m_ambientLightProgram.DestroyHandle();
+	m_depthPyramidProgram.DestroyHandle();
+	m_lightCullingProgram.DestroyHandle();
+	m_downsampleProgram.DestroyHandle();
+	m_upsampleProgram.DestroyHandle();
+	m_temporalResolveProgram.DestroyHandle();
+	m_globalLightsBuffer.Free();
+	m_drawCommandBuffer.Free();
+	m_visibleLightsBuffer.Free();
+	m_depthPyramid.Free();
+
+	if (m_visibleCountFence)
+		glDeleteSync(m_visibleCountFence);
+	glDeleteBuffers(1, &m_visibleCountBuffer);
+
+	if (GLEW_ARB_pipeline_statistics_query)
+		m_localLightInvocations.Free();
+}
+
+int LightingPass::GetLocalLightingScale() const
+{
+	return m_directLocalLighting ? 1 : 1 << m_localLightingResolution;
+}
+
+bool LightingPass::IsCheckerboarding() const
+{
+	//the checkerboard needs every pixel of the target, so it is skipped at reduced resolution
+	return m_checkerboardLocalLights && GetLocalLightingScale() == 1 && !m_directLocalLighting;
+}
+
+#pragma endregion
+
+#pragma region "Private Methods"
+
+void LightingPass::BuildDepthPyramid(Texture const & depthBuffer) const
+{
+	DeferredRenderer const * deferredRenderer = dynamic_cast<DeferredRenderer const *>(m_renderer);
+	unsigned int const width = deferredRenderer->GetRenderWidth();
+	unsigned int const height = deferredRenderer->GetRenderHeight();
+
+	//the pyramid is allocated for the whole g-buffer, only the rendered part of it is reduced
+	if (m_depthPyramid.GetWidth() != depthBuffer.GetWidth() || m_depthPyramid.GetHeight() != depthBuffer.GetHeight())
+	{
+		unsigned int levels = 1;
+		while ((glm::max(depthBuffer.GetWidth(), depthBuffer.GetHeight()) >> levels) > 0)
+			levels++;
+		m_depthPyramid.InitializeStorage(depthBuffer.GetWidth(), depthBuffer.GetHeight(), GL_R32F, levels);
+	}
+
+	m_depthPyramidLevels = 1;
+	while ((glm::max(width, height) >> m_depthPyramidLevels) > 0)
+		m_depthPyramidLevels++;
+
+	m_depthPyramidProgram.Use();
+	depthBuffer.Bind();
+
+	m_depthPyramidProgram.SetUniform("uCopy", true);
+	m_depthPyramidProgram.SetUniform("uTargetSize", glm::vec2(width, height));
+	glBindImageTexture(1, m_depthPyramid.GetHandle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+
+	//every further level keeps the farthest depth of the level below
+	m_depthPyramidProgram.SetUniform("uCopy", false);
+	for (unsigned int level = 1; level < m_depthPyramidLevels; ++level)
+	{
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		glBindImageTexture(0, m_depthPyramid.GetHandle(), level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, m_depthPyramid.GetHandle(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		unsigned int const levelWidth = glm::max(width >> level, 1u);
+		unsigned int const levelHeight = glm::max(height >> level, 1u);
+		m_depthPyramidProgram.SetUniform("uSourceSize", glm::vec2(glm::max(width >> (level - 1), 1u), glm::max(height >> (level - 1), 1u)));
+		m_depthPyramidProgram.SetUniform("uTargetSize", glm::vec2(levelWidth, levelHeight));
+		glDispatchCompute((levelWidth + 15) / 16, (levelHeight + 15) / 16, 1);
+	}
+
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	m_depthPyramid.Bind();
 }
 
 #pragma endregion
@@ -144,4 +615,24 @@ unsigned int const & LightingPass::GetLocalLightsCount() const
 	return m_localLightsCount;
 }
 
+unsigned long long const & LightingPass::GetLocalLightInvocationsCount() const
+{
+	return m_localLightInvocations.GetResult();
+}
+
+unsigned int const & LightingPass::GetSphereProxiesCount() const
+{
+	return m_sphereLightsCount;
+}
+
+unsigned int LightingPass::GetQuadProxiesCount() const
+{
+	return m_localLightsCount - m_sphereLightsCount;
+}
+
+unsigned int const & LightingPass::GetVisibleLightsCount() const
+{
+	return m_visibleLightsCount;
+}
+
 #pragma endregion
\ No newline at end of file
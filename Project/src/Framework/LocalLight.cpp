@@ -1,12 +1,13 @@
 #include <Framework/LocalLight.h>
+#include <Framework/NodePool.h>
 
 #pragma region "Constructors/Destructor"
 
-LocalLight::LocalLight(std::string const & name, glm::vec3 const & intensity, float const & radius, glm::vec3 const & translation, glm::quat const & orientation) : Node(name, translation, orientation), m_intensity(intensity), m_radius(radius)
+LocalLight::LocalLight(std::string const & name, glm::vec3 const & intensity, float const & radius, glm::vec3 const & translation, glm::quat const & orientation) : Node(name, translation, orientation), m_intensity(intensity), m_radius(radius), m_castShadows(false)
 {
 }
 
-LocalLight::LocalLight(std::string const & name, glm::vec3 const & intensity, float const & radius) : Node(name), m_intensity(intensity), m_radius(radius)
+LocalLight::LocalLight(std::string const & name, glm::vec3 const & intensity, float const & radius) : Node(name), m_intensity(intensity), m_radius(radius), m_castShadows(false)
 {
 }
 
@@ -14,6 +15,28 @@ LocalLight::~LocalLight()
 {
 }
 
+void * LocalLight::operator new(std::size_t size)
+{
+	return size == sizeof(LocalLight) ? NodePool<LocalLight>::Allocate() : ::operator new(size);
+}
+
+void LocalLight::operator delete(void * pointer, std::size_t size)
+{
+	if (size == sizeof(LocalLight))
+		NodePool<LocalLight>::Free(pointer);
+	else
+		::operator delete(pointer);
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+Node * LocalLight::Clone() const
+{
+	return new LocalLight(*this);
+}
+
 #pragma endregion
 
 #pragma region "Getters"
@@ -28,6 +51,11 @@ float const & LocalLight::GetRadius() const
 	return m_radius;
 }
 
+bool const & LocalLight::GetCastShadows() const
+{
+	return m_castShadows;
+}
+
 Node::NodeType LocalLight::GetNodeType() const
 {
 	return Node::LOCAL_LIGHT_NODE;
@@ -40,11 +68,19 @@ Node::NodeType LocalLight::GetNodeType() const
 void LocalLight::SetIntensity(glm::vec3 const & intensity)
 {
 	m_intensity = intensity;
+	Changed();
 }
 
 void LocalLight::SetRadius(float const & radius)
 {
 	m_radius = radius;
+	Changed();
+}
+
+void LocalLight::SetCastShadows(bool const & castShadows)
+{
+	m_castShadows = castShadows;
+	Changed();
 }
 
 #pragma endregion
\ No newline at end of file
@@ -1,7 +1,14 @@
 #include <Framework/Mesh.h>
+#include <Framework/MeshSimplifier.h>
+#include <Framework/StateCache.h>
+#include <Framework/Defaults.h>
 
 #include <GL/glew.h>
 #include <iostream>
+#include <cfloat>
+#include <map>
+#include <unordered_map>
+#include <tuple>
 
 typedef struct Vertex
 {
@@ -11,53 +18,120 @@ typedef struct Vertex
 	float uv[2];
 } Vertex;
 
-Mesh::Mesh(unsigned const & numberOfFaces, aiFace * faces, aiVector3t<float> * positions, aiVector3t<float> * normals, aiVector3t<float> * tangents, aiVector3t<float> * textureCoords[8]) : m_vao(0), m_vbo(0), m_vertexCount(0)
+Mesh::Mesh(unsigned const & numberOfVertices, unsigned const & numberOfFaces, aiFace * faces, aiVector3t<float> * positions, aiVector3t<float> * normals, aiVector3t<float> * tangents, aiVector3t<float> * textureCoords[8]) : m_vao(0), m_vbo(0), m_ibo(0), m_vertexCount(numberOfVertices), m_levels(), m_boundingSphereCenter(0.0f), m_boundingSphereRadius(0.0f)
 {
-	m_vertexCount = (numberOfFaces) * 3;
-
 	Vertex * vertices = (Vertex*)malloc(sizeof(Vertex) * m_vertexCount);
+	std::vector<glm::vec3> vertexPositions(m_vertexCount);
+
+	glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+
+	for (unsigned i = 0; i < m_vertexCount; ++i)
+	{
+		vertices[i].position[0] = positions[i].x;
+		vertices[i].position[1] = positions[i].y;
+		vertices[i].position[2] = positions[i].z;
+		vertices[i].normal[0] = normals[i].x;
+		vertices[i].normal[1] = normals[i].y;
+		vertices[i].normal[2] = normals[i].z;
+		vertices[i].tangent[0] = tangents ? tangents[i].x : 0.0f;
+		vertices[i].tangent[1] = tangents ? tangents[i].y : 0.0f;
+		vertices[i].tangent[2] = tangents ? tangents[i].z : 0.0f;
+		vertices[i].uv[0] = textureCoords[0] ? textureCoords[0][i].x : 0.0f;
+		vertices[i].uv[1] = textureCoords[0] ? textureCoords[0][i].y : 0.0f;
+
+		vertexPositions[i] = glm::vec3(positions[i].x, positions[i].y, positions[i].z);
+		minimum = glm::min(minimum, vertexPositions[i]);
+		maximum = glm::max(maximum, vertexPositions[i]);
+	}
+
+	//bounding sphere used for culling and level of detail selection
+	m_boundingSphereCenter = (minimum + maximum) * 0.5f;
+	for (auto const & position : vertexPositions)
+		m_boundingSphereRadius = glm::max(m_boundingSphereRadius, glm::length(position - m_boundingSphereCenter));
+
+	std::vector<unsigned> indices;
+	indices.reserve(numberOfFaces * 3);
+	for (unsigned i = 0; i < numberOfFaces; ++i)
+	{
+		indices.push_back(faces[i].mIndices[0]);
+		indices.push_back(faces[i].mIndices[1]);
+		indices.push_back(faces[i].mIndices[2]);
+	}
+
+	//weld vertices by position; split vertices mark uv/normal seams
+	std::map<std::tuple<float, float, float>, unsigned> positionIds;
+	std::vector<unsigned> weldedIds(m_vertexCount);
+	std::vector<unsigned> weldedCounts;
+	for (unsigned i = 0; i < m_vertexCount; ++i)
+	{
+		auto result = positionIds.insert(std::make_pair(std::make_tuple(vertexPositions[i].x, vertexPositions[i].y, vertexPositions[i].z), (unsigned)weldedCounts.size()));
+		if (result.second)
+			weldedCounts.push_back(0);
+		weldedIds[i] = result.first->second;
+		weldedCounts[weldedIds[i]]++;
+	}
 
-	for (int i = 0; i < numberOfFaces; ++i)
+	//edges referenced by a single triangle lie on an open boundary
+	std::unordered_map<unsigned long long, unsigned> edgeCounts;
+	for (unsigned i = 0; i < indices.size(); i += 3)
 	{
-		for (int faceId = 0; faceId < 3; ++faceId)
+		for (unsigned e = 0; e < 3; ++e)
 		{
-			aiVector3t<float> & position = positions[faces[i].mIndices[faceId]];
-			aiVector3t<float> & normal = normals[faces[i].mIndices[faceId]];
-			aiVector3t<float> & tangent = tangents[faces[i].mIndices[faceId]];
-
-			vertices[(i * 3) + faceId].position[0] = positions[faces[i].mIndices[faceId]].x;
-			vertices[(i * 3) + faceId].position[1] = positions[faces[i].mIndices[faceId]].y;
-			vertices[(i * 3) + faceId].position[2] = positions[faces[i].mIndices[faceId]].z;
-			vertices[(i * 3) + faceId].normal[0] = normals[faces[i].mIndices[faceId]].x;
-			vertices[(i * 3) + faceId].normal[1] = normals[faces[i].mIndices[faceId]].y;
-			vertices[(i * 3) + faceId].normal[2] = normals[faces[i].mIndices[faceId]].z;
-			vertices[(i * 3) + faceId].tangent[0] = tangents[faces[i].mIndices[faceId]].x;
-			vertices[(i * 3) + faceId].tangent[1] = tangents[faces[i].mIndices[faceId]].y;
-			vertices[(i * 3) + faceId].tangent[2] = tangents[faces[i].mIndices[faceId]].z;
-			vertices[(i * 3) + faceId].uv[0] = textureCoords[0][faces[i].mIndices[faceId]].x;
-			vertices[(i * 3) + faceId].uv[1] = textureCoords[0][faces[i].mIndices[faceId]].y;
+			unsigned long long a = weldedIds[indices[i + e]];
+			unsigned long long b = weldedIds[indices[i + (e + 1) % 3]];
+			edgeCounts[a < b ? (a << 32) | b : (b << 32) | a]++;
 		}
 	}
 
+	std::vector<bool> lockedPositions(weldedCounts.size(), false);
+	for (unsigned i = 0; i < weldedCounts.size(); ++i)
+		lockedPositions[i] = weldedCounts[i] > 1;
+	for (auto const & edge : edgeCounts)
+	{
+		if (edge.second == 1)
+		{
+			lockedPositions[(unsigned)(edge.first >> 32)] = true;
+			lockedPositions[(unsigned)(edge.first & 0xFFFFFFFF)] = true;
+		}
+	}
+
+	std::vector<bool> lockedVertices(m_vertexCount);
+	for (unsigned i = 0; i < m_vertexCount; ++i)
+		lockedVertices[i] = lockedPositions[weldedIds[i]];
+
+	GenerateLevelsOfDetail(vertexPositions, lockedVertices, indices);
+
 	glGenVertexArrays(1, &m_vao);
-	glBindVertexArray(m_vao);
+	StateCache::BindVertexArray(m_vao);
 
 	glGenBuffers(1, &m_vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*m_vertexCount, vertices, GL_STATIC_DRAW);
 
+	glGenBuffers(1, &m_ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned)*indices.size(), &indices[0], GL_STATIC_DRAW);
+
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(sizeof(float) * 3));
 	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(sizeof(float) * 6));
 	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(sizeof(float) * 9));
 
+	//the arrays stay enabled in the vertex array object, passes only bind it
+	for (unsigned int i = 0; i < 4; ++i)
+		glEnableVertexAttribArray(i);
+
+	StateCache::BindVertexArray(0);
+
 	free(vertices);
 }
 
 
 Mesh::~Mesh()
 {
+	glDeleteBuffers(1, &m_ibo);
 	glDeleteBuffers(1, &m_vbo);
+	StateCache::ForgetVertexArray(m_vao);
 	glDeleteVertexArrays(1, &m_vao);
 }
 
@@ -69,4 +143,59 @@ unsigned const & Mesh::GetVAO() const
 unsigned const & Mesh::GetVertexCount() const
 {
 	return m_vertexCount;
-}
\ No newline at end of file
+}
+
+unsigned Mesh::GetLevelCount() const
+{
+	return m_levels.size();
+}
+
+unsigned const & Mesh::GetIndexCount(unsigned const & level) const
+{
+	return m_levels[level].indexCount;
+}
+
+unsigned const & Mesh::GetIndexOffset(unsigned const & level) const
+{
+	return m_levels[level].indexOffset;
+}
+
+unsigned Mesh::GetTriangleCount(unsigned const & level) const
+{
+	return m_levels[level].indexCount / 3;
+}
+
+glm::vec3 const & Mesh::GetBoundingSphereCenter() const
+{
+	return m_boundingSphereCenter;
+}
+
+float const & Mesh::GetBoundingSphereRadius() const
+{
+	return m_boundingSphereRadius;
+}
+
+void Mesh::GenerateLevelsOfDetail(std::vector<glm::vec3> const & positions, std::vector<bool> const & lockedVertices, std::vector<unsigned> & indices)
+{
+	m_levels.push_back({ 0, (unsigned)indices.size() });
+
+	MeshSimplifier simplifier(positions, indices, lockedVertices);
+	std::vector<unsigned> levelIndices;
+
+	//each level halves the triangle count of the previous one, continuing from where the last collapse stopped
+	while (m_levels.size() < MAX_MESH_LEVELS_OF_DETAIL)
+	{
+		unsigned const previousCount = m_levels.back().indexCount / 3;
+		unsigned const targetCount = previousCount / 2;
+		if (targetCount < MIN_LOD_TRIANGLE_COUNT)
+			break;
+
+		simplifier.Simplify(targetCount);
+		if (simplifier.GetTriangleCount() > previousCount * 0.9f)
+			break;
+
+		simplifier.GetIndices(levelIndices);
+		m_levels.push_back({ (unsigned)indices.size(), (unsigned)levelIndices.size() });
+		indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+	}
+}
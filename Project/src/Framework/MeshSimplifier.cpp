@@ -0,0 +1,249 @@
+#include <Framework/MeshSimplifier.h>
+
+#include <algorithm>
+
+#pragma region "Constructors/Destructor"
+
+MeshSimplifier::MeshSimplifier(std::vector<glm::vec3> const & positions, std::vector<unsigned int> const & indices, std::vector<bool> const & lockedVertices) : m_positions(positions.size()), m_triangles(indices), m_triangleAlive(indices.size() / 3, true), m_vertexTriangles(positions.size()), m_quadrics(positions.size(), { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }), m_versions(positions.size(), 0), m_vertexAlive(positions.size(), true), m_locked(lockedVertices), m_collapses(), m_triangleCount(0)
+{
+	for (unsigned int i = 0; i < positions.size(); ++i)
+		m_positions[i] = glm::dvec3(positions[i]);
+
+	//build the vertex to triangle adjacency and accumulate the plane quadrics of every vertex
+	for (unsigned int t = 0; t < m_triangleAlive.size(); ++t)
+	{
+		unsigned int const a = m_triangles[t * 3 + 0];
+		unsigned int const b = m_triangles[t * 3 + 1];
+		unsigned int const c = m_triangles[t * 3 + 2];
+
+		if (a == b || b == c || c == a)
+		{
+			m_triangleAlive[t] = false;
+			continue;
+		}
+
+		m_vertexTriangles[a].push_back(t);
+		m_vertexTriangles[b].push_back(t);
+		m_vertexTriangles[c].push_back(t);
+		m_triangleCount++;
+
+		glm::dvec3 normal = glm::cross(m_positions[b] - m_positions[a], m_positions[c] - m_positions[a]);
+		double const length = glm::length(normal);
+		if (length <= 0.0)
+			continue;
+
+		normal /= length;
+		Quadric const plane = PlaneQuadric(normal, -glm::dot(normal, m_positions[a]), length * 0.5);
+		AddQuadric(m_quadrics[a], plane);
+		AddQuadric(m_quadrics[b], plane);
+		AddQuadric(m_quadrics[c], plane);
+	}
+
+	for (unsigned int t = 0; t < m_triangleAlive.size(); ++t)
+	{
+		if (!m_triangleAlive[t])
+			continue;
+
+		PushEdge(m_triangles[t * 3 + 0], m_triangles[t * 3 + 1]);
+		PushEdge(m_triangles[t * 3 + 1], m_triangles[t * 3 + 2]);
+		PushEdge(m_triangles[t * 3 + 2], m_triangles[t * 3 + 0]);
+	}
+}
+
+MeshSimplifier::~MeshSimplifier()
+{
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+bool MeshSimplifier::Simplify(unsigned int const & targetTriangleCount)
+{
+	while (m_triangleCount > targetTriangleCount && !m_collapses.empty())
+	{
+		Collapse const collapse = m_collapses.top();
+		m_collapses.pop();
+
+		//skip collapses that were queued before one of their vertices changed
+		if (!m_vertexAlive[collapse.from] || !m_vertexAlive[collapse.to])
+			continue;
+		if (m_versions[collapse.from] != collapse.fromVersion || m_versions[collapse.to] != collapse.toVersion)
+			continue;
+		if (!IsCollapseValid(collapse.from, collapse.to))
+			continue;
+
+		CollapseEdge(collapse.from, collapse.to);
+	}
+
+	return m_triangleCount <= targetTriangleCount;
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+unsigned int const & MeshSimplifier::GetTriangleCount() const
+{
+	return m_triangleCount;
+}
+
+void MeshSimplifier::GetIndices(std::vector<unsigned int> & indices) const
+{
+	indices.clear();
+	indices.reserve(m_triangleCount * 3);
+	for (unsigned int t = 0; t < m_triangleAlive.size(); ++t)
+	{
+		if (!m_triangleAlive[t])
+			continue;
+
+		indices.push_back(m_triangles[t * 3 + 0]);
+		indices.push_back(m_triangles[t * 3 + 1]);
+		indices.push_back(m_triangles[t * 3 + 2]);
+	}
+}
+
+#pragma endregion
+
+#pragma region "Private Methods"
+
+MeshSimplifier::Quadric MeshSimplifier::PlaneQuadric(glm::dvec3 const & n, double const & d, double const & weight)
+{
+	return {
+		weight * n.x * n.x, weight * n.x * n.y, weight * n.x * n.z, weight * n.x * d,
+		weight * n.y * n.y, weight * n.y * n.z, weight * n.y * d,
+		weight * n.z * n.z, weight * n.z * d,
+		weight * d * d
+	};
+}
+
+void MeshSimplifier::AddQuadric(Quadric & target, Quadric const & source)
+{
+	target.a2 += source.a2; target.ab += source.ab; target.ac += source.ac; target.ad += source.ad;
+	target.b2 += source.b2; target.bc += source.bc; target.bd += source.bd;
+	target.c2 += source.c2; target.cd += source.cd;
+	target.d2 += source.d2;
+}
+
+double MeshSimplifier::EvaluateQuadric(Quadric const & q, glm::dvec3 const & p)
+{
+	return q.a2 * p.x * p.x + 2.0 * q.ab * p.x * p.y + 2.0 * q.ac * p.x * p.z + 2.0 * q.ad * p.x
+		+ q.b2 * p.y * p.y + 2.0 * q.bc * p.y * p.z + 2.0 * q.bd * p.y
+		+ q.c2 * p.z * p.z + 2.0 * q.cd * p.z
+		+ q.d2;
+}
+
+void MeshSimplifier::PushEdge(unsigned int const & a, unsigned int const & b)
+{
+	//half-edge collapses keep the surviving vertex untouched, so every level shares the same vertex buffer
+	Quadric combined = m_quadrics[a];
+	AddQuadric(combined, m_quadrics[b]);
+
+	if (!m_locked[a])
+		m_collapses.push({ EvaluateQuadric(combined, m_positions[b]), a, b, m_versions[a], m_versions[b] });
+	if (!m_locked[b])
+		m_collapses.push({ EvaluateQuadric(combined, m_positions[a]), b, a, m_versions[b], m_versions[a] });
+}
+
+bool MeshSimplifier::IsCollapseValid(unsigned int const & from, unsigned int const & to) const
+{
+	unsigned int sharedTriangles = 0;
+
+	//reject collapses that flip or degenerate any of the remaining triangles
+	for (auto const & t : m_vertexTriangles[from])
+	{
+		if (!m_triangleAlive[t])
+			continue;
+
+		unsigned int const * triangle = &m_triangles[t * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			sharedTriangles++;
+			continue;
+		}
+
+		glm::dvec3 before[3] = { m_positions[triangle[0]], m_positions[triangle[1]], m_positions[triangle[2]] };
+		glm::dvec3 after[3] = { before[0], before[1], before[2] };
+		for (int i = 0; i < 3; ++i)
+			if (triangle[i] == from)
+				after[i] = m_positions[to];
+
+		glm::dvec3 const oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::dvec3 const newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+		double const oldLength = glm::length(oldNormal);
+		double const newLength = glm::length(newNormal);
+
+		if (newLength <= 1e-12 * std::max(oldLength, 1e-12))
+			return false;
+		if (oldLength > 0.0 && glm::dot(oldNormal, newNormal) < 0.2 * oldLength * newLength)
+			return false;
+	}
+
+	//link condition: the two vertices may only share the neighbours opposite their shared triangles
+	std::vector<unsigned int> fromNeighbours, toNeighbours;
+	GatherNeighbours(from, fromNeighbours);
+	GatherNeighbours(to, toNeighbours);
+
+	unsigned int commonNeighbours = 0;
+	for (auto const & neighbour : fromNeighbours)
+		if (std::binary_search(toNeighbours.begin(), toNeighbours.end(), neighbour))
+			commonNeighbours++;
+
+	return commonNeighbours <= sharedTriangles;
+}
+
+void MeshSimplifier::CollapseEdge(unsigned int const & from, unsigned int const & to)
+{
+	for (auto const & t : m_vertexTriangles[from])
+	{
+		if (!m_triangleAlive[t])
+			continue;
+
+		unsigned int * triangle = &m_triangles[t * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			m_triangleAlive[t] = false;
+			m_triangleCount--;
+			continue;
+		}
+
+		for (int i = 0; i < 3; ++i)
+			if (triangle[i] == from)
+				triangle[i] = to;
+		m_vertexTriangles[to].push_back(t);
+	}
+
+	m_vertexTriangles[from].clear();
+	m_vertexAlive[from] = false;
+
+	AddQuadric(m_quadrics[to], m_quadrics[from]);
+	m_versions[to]++;
+
+	//drop dead triangles from the surviving vertex and requeue its edges
+	std::vector<unsigned int> & triangles = m_vertexTriangles[to];
+	triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [this](unsigned int t) { return !m_triangleAlive[t]; }), triangles.end());
+
+	std::vector<unsigned int> neighbours;
+	GatherNeighbours(to, neighbours);
+	for (auto const & neighbour : neighbours)
+		PushEdge(to, neighbour);
+}
+
+void MeshSimplifier::GatherNeighbours(unsigned int const & vertex, std::vector<unsigned int> & neighbours) const
+{
+	neighbours.clear();
+	for (auto const & t : m_vertexTriangles[vertex])
+	{
+		if (!m_triangleAlive[t])
+			continue;
+
+		for (int i = 0; i < 3; ++i)
+			if (m_triangles[t * 3 + i] != vertex)
+				neighbours.push_back(m_triangles[t * 3 + i]);
+	}
+
+	std::sort(neighbours.begin(), neighbours.end());
+	neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+#pragma endregion
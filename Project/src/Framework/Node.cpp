@@ -1,14 +1,37 @@
 #include <Framework/Node.h>
+#include <Framework/Scene.h>
+#include <Framework/NodePool.h>
 #include <glm/gtc/quaternion.hpp>
 
+#include <mutex>
+#include <unordered_set>
+
+//names are kept until the application exits, the set never moves its strings
+static struct Names
+{
+	std::mutex mutex;
+	std::unordered_set<std::string> strings;
+} g_names;
+
+static std::string const * Intern(std::string const & name)
+{
+	std::lock_guard<std::mutex> lock(g_names.mutex);
+	return &*g_names.strings.insert(name).first;
+}
+
 #pragma region "Constructors/Destructor"
  
-Node::Node(std::string const & name) : m_name(name), m_translation(0.0f, 0.0f, 0.0f), m_scale(1, 1, 1), m_orientation(), m_children()
+Node::Node(std::string const & name) : m_name(Intern(name)), m_translation(0.0f, 0.0f, 0.0f), m_scale(1, 1, 1), m_orientation(), m_firstChild(nullptr), m_lastChild(nullptr), m_nextSibling(nullptr), m_scene(nullptr), m_slot(0), m_contentChanged(false), m_linksChanged(false)
 {
 
 }
 
-Node::Node(std::string const & name, glm::vec3 const & translation, glm::quat const & orientation) : m_name(name), m_translation(translation), m_scale(1, 1, 1), m_orientation(orientation), m_children()
+Node::Node(std::string const & name, glm::vec3 const & translation, glm::quat const & orientation) : m_name(Intern(name)), m_translation(translation), m_scale(1, 1, 1), m_orientation(orientation), m_firstChild(nullptr), m_lastChild(nullptr), m_nextSibling(nullptr), m_scene(nullptr), m_slot(0), m_contentChanged(false), m_linksChanged(false)
+{
+
+}
+
+Node::Node(Node const & node) : m_name(node.m_name), m_translation(node.m_translation), m_scale(node.m_scale), m_orientation(node.m_orientation), m_firstChild(nullptr), m_lastChild(nullptr), m_nextSibling(nullptr), m_scene(nullptr), m_slot(node.m_slot), m_contentChanged(false), m_linksChanged(false)
 {
 
 }
@@ -16,8 +39,26 @@ Node::Node(std::string const & name, glm::vec3 const & translation, glm::quat co
 
 Node::~Node()
 {
-	for (auto childNode : m_children)
-		delete childNode;
+	for (Node * child = m_firstChild; child;)
+	{
+		Node * next = child->m_nextSibling;
+		delete child;
+		child = next;
+	}
+}
+
+void * Node::operator new(std::size_t size)
+{
+	//types deriving without a pool of their own come from the heap
+	return size == sizeof(Node) ? NodePool<Node>::Allocate() : ::operator new(size);
+}
+
+void Node::operator delete(void * pointer, std::size_t size)
+{
+	if (size == sizeof(Node))
+		NodePool<Node>::Free(pointer);
+	else
+		::operator delete(pointer);
 }
 
 #pragma endregion
@@ -26,7 +67,23 @@ Node::~Node()
 
 void Node::AddChild(Node * node)
 {
-	m_children.push_back(node);
+	//the links of the previous last child, or of this node for the first one, change in the snapshot
+	if (m_scene)
+		m_scene->MarkChanged(m_lastChild ? m_lastChild : this, false);
+
+	if (m_lastChild)
+		m_lastChild->m_nextSibling = node;
+	else
+		m_firstChild = node;
+	m_lastChild = node;
+
+	if (m_scene)
+		m_scene->Register(node);
+}
+
+Node * Node::Clone() const
+{
+	return new Node(*this);
 }
 
 #pragma endregion
@@ -70,7 +127,13 @@ glm::mat4 Node::GetTransformMatrixWithScale() const
 
 std::string const & Node::GetName() const
 {
-	return m_name;
+	return *m_name;
+}
+
+unsigned int const & Node::GetSlot() const
+{
+	//published copies keep the slot, render side state outlives them when it is kept by slot
+	return m_slot;
 }
 
 #pragma endregion
@@ -80,21 +143,25 @@ std::string const & Node::GetName() const
 void Node::SetTranslation(glm::vec3 const & translation)
 {
 	m_translation = translation;
+	Changed();
 }
 
 void Node::SetScale(glm::vec3 const & scale)
 {
 	m_scale = scale;
+	Changed();
 }
 
 void Node::SetOrientation(glm::quat const & orientation)
 {
 	m_orientation = orientation;
+	Changed();
 }
 
 void Node::SetName(std::string const & name)
 {
-	m_name = name;
+	m_name = Intern(name);
+	Changed();
 }
 
 #pragma endregion
@@ -106,4 +173,10 @@ Node::NodeType Node::GetNodeType() const
 	return BASE_NODE;
 }
 
+void Node::Changed()
+{
+	if (m_scene)
+		m_scene->MarkChanged(this, true);
+}
+
 #pragma endregion
\ No newline at end of file
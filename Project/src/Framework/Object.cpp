@@ -1,4 +1,5 @@
 #include <Framework/Object.h>
+#include <Framework/NodePool.h>
 
 #pragma region "Constructors/Destructor"
 
@@ -10,6 +11,19 @@ Object::~Object()
 {
 }
 
+void * Object::operator new(std::size_t size)
+{
+	return size == sizeof(Object) ? NodePool<Object>::Allocate() : ::operator new(size);
+}
+
+void Object::operator delete(void * pointer, std::size_t size)
+{
+	if (size == sizeof(Object))
+		NodePool<Object>::Free(pointer);
+	else
+		::operator delete(pointer);
+}
+
 #pragma endregion
 
 #pragma region "Getters"
@@ -28,6 +42,11 @@ Material const * const & Object::GetMaterial() const
 
 #pragma region "Public Methods"
 
+Node * Object::Clone() const
+{
+	return new Object(*this);
+}
+
 Node::NodeType Object::GetNodeType() const
 {
 	return OBJECT_NODE;
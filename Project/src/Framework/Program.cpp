@@ -1,6 +1,8 @@
 #include <Framework/Program.h>
 
 #include <GL/glew.h>
+
+#include <Framework/StateCache.h>
 #include <cstdlib>
 #include <cstdio>
 #include <iostream>
@@ -24,12 +26,12 @@ Program::~Program()
 
 void Program::Use() const
 {
-	glUseProgram(m_handle);
+	StateCache::UseProgram(m_handle);
 }
 
 void Program::Unuse() const
 {
-	glUseProgram(0);
+	StateCache::UseProgram(0);
 }
 
 void Program::SetUniform(char const * name, glm::mat4 const & matrix) const
@@ -100,6 +102,7 @@ unsigned int const & Program::GetHandle() const
 
 void Program::DestroyHandle()
 {
+	StateCache::ForgetProgram(m_handle);
 	glDeleteProgram(m_handle);
 }
 
@@ -0,0 +1,96 @@
+#include <Framework/Query.h>
+#include <GL/glew.h>
+
+#pragma region "Constructors/Destructor"
+
+Query::Query(unsigned int const & target) : m_target(target), m_handles(), m_current(0), m_oldest(0), m_pending(), m_result(0), m_newResult(false)
+{
+
+}
+
+Query::~Query()
+{
+
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+void Query::Initialize()
+{
+	glGenQueries(QUERY_RING_SIZE, m_handles);
+
+	for (unsigned int i = 0; i < QUERY_RING_SIZE; i++)
+		m_pending[i] = false;
+
+	m_current = m_oldest = 0;
+	m_newResult = false;
+}
+
+void Query::Begin() const
+{
+	Update();
+
+	//every query is still in flight, the oldest one is dropped instead of waiting for it
+	if (m_pending[m_current])
+	{
+		m_pending[m_current] = false;
+		m_oldest = (m_oldest + 1) % QUERY_RING_SIZE;
+	}
+
+	glBeginQuery(m_target, m_handles[m_current]);
+}
+
+void Query::End() const
+{
+	glEndQuery(m_target);
+	m_pending[m_current] = true;
+	m_current = (m_current + 1) % QUERY_RING_SIZE;
+}
+
+void Query::Update() const
+{
+	//the gpu finishes queries in order, the first one not available ends the readback
+	while (m_pending[m_oldest])
+	{
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(m_handles[m_oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+			break;
+
+		GLuint64 result = 0;
+		glGetQueryObjectui64v(m_handles[m_oldest], GL_QUERY_RESULT, &result);
+		m_result = result;
+		m_newResult = true;
+
+		m_pending[m_oldest] = false;
+		m_oldest = (m_oldest + 1) % QUERY_RING_SIZE;
+	}
+}
+
+void Query::AcknowledgeResult() const
+{
+	m_newResult = false;
+}
+
+void Query::Free()
+{
+	glDeleteQueries(QUERY_RING_SIZE, m_handles);
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+unsigned long long const & Query::GetResult() const
+{
+	return m_result;
+}
+
+bool const & Query::HasNewResult() const
+{
+	return m_newResult;
+}
+
+#pragma endregion
@@ -0,0 +1,207 @@
+#include <Framework/RenderGraph.h>
+#include <GL/glew.h>
+
+#include <Framework/StateCache.h>
+
+#include <algorithm>
+
+#pragma region "Constructors/Destructor"
+
+RenderGraph::RenderGraph() : m_resources(), m_passes(), m_pool(), m_executionOrder()
+{
+
+}
+
+RenderGraph::~RenderGraph()
+{
+
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+void RenderGraph::Reset()
+{
+	//the graph is declared again every frame, only the texture pool is kept
+	m_resources.clear();
+	m_passes.clear();
+	m_executionOrder.clear();
+}
+
+RenderGraph::Resource RenderGraph::CreateTexture(std::string const & name, TextureDescription const & description, unsigned int const & unit)
+{
+	m_resources.push_back({ name, true, false, description, unit, -1, -1, -1 });
+	return (Resource)m_resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::ImportResource(std::string const & name)
+{
+	m_resources.push_back({ name, false, false, { 0, 0, 0, 0, 0 }, 0, -1, -1, -1 });
+	return (Resource)m_resources.size() - 1;
+}
+
+void RenderGraph::AddPass(std::string const & name, std::vector<Resource> const & reads, std::vector<Resource> const & writes, std::function<void()> const & execute)
+{
+	m_passes.push_back({ name, reads, writes, execute, false });
+}
+
+void RenderGraph::MarkOutput(Resource const & resource)
+{
+	m_resources[resource].output = true;
+}
+
+void RenderGraph::Compile()
+{
+	//walking back from the outputs, a pass survives when a later pass or an output needs something it writes
+	std::vector<bool> needed(m_resources.size());
+	for (unsigned int i = 0; i < m_resources.size(); ++i)
+		needed[i] = m_resources[i].output;
+
+	for (int p = (int)m_passes.size() - 1; p >= 0; --p)
+	{
+		PassNode & pass = m_passes[p];
+		pass.culled = std::none_of(pass.writes.begin(), pass.writes.end(), [&needed](Resource r) { return needed[r]; });
+		if (!pass.culled)
+			for (auto const & r : pass.reads)
+				needed[r] = true;
+	}
+
+	//passes are declared in submission order, so every writer precedes its readers and the order only loses the culled passes
+	for (unsigned int p = 0; p < m_passes.size(); ++p)
+	{
+		if (m_passes[p].culled)
+			continue;
+
+		int const index = (int)m_executionOrder.size();
+		m_executionOrder.push_back(p);
+
+		for (auto const * resources : { &m_passes[p].reads, &m_passes[p].writes })
+			for (auto const & r : *resources)
+			{
+				ResourceNode & resource = m_resources[r];
+				if (resource.firstPass < 0)
+					resource.firstPass = index;
+				resource.lastPass = index;
+			}
+	}
+
+	for (auto & physical : m_pool)
+	{
+		physical.available = true;
+		physical.used = false;
+	}
+
+	//a transient target takes a matching texture at its first pass and hands it back after its last one
+	for (int index = 0; index < (int)m_executionOrder.size(); ++index)
+	{
+		for (auto & resource : m_resources)
+		{
+			if (!resource.transient || resource.firstPass != index)
+				continue;
+
+			auto match = std::find_if(m_pool.begin(), m_pool.end(), [&resource](PhysicalTexture const & physical) { return physical.available && physical.description == resource.description; });
+			if (match == m_pool.end())
+			{
+				TextureDescription const & description = resource.description;
+				m_pool.push_back({ Texture(), description, true, false });
+				m_pool.back().texture.Initialize(description.width, description.height, description.internalFormat, description.format, description.type, 0);
+				match = m_pool.end() - 1;
+			}
+
+			match->available = false;
+			match->used = true;
+			resource.physical = (int)(match - m_pool.begin());
+
+			//shaders sample the targets from fixed units, aliased targets are simply bound to several of them
+			StateCache::BindTexture(resource.unit, match->texture.GetHandle());
+		}
+
+		for (auto const & resource : m_resources)
+			if (resource.transient && resource.lastPass == index)
+				m_pool[resource.physical].available = true;
+	}
+
+	//textures no pass asked for this frame are released, the graph was declared for another configuration
+	for (unsigned int i = 0; i < m_pool.size(); ++i)
+	{
+		if (m_pool[i].used)
+			continue;
+
+		m_pool[i].texture.Free();
+		m_pool.erase(m_pool.begin() + i);
+		for (auto & resource : m_resources)
+			if (resource.physical > (int)i)
+				resource.physical--;
+		--i;
+	}
+}
+
+void RenderGraph::Execute() const
+{
+	for (auto const & p : m_executionOrder)
+		m_passes[p].execute();
+}
+
+void RenderGraph::Free()
+{
+	for (auto & physical : m_pool)
+		physical.texture.Free();
+
+	m_pool.clear();
+	Reset();
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+bool RenderGraph::IsUsed(Resource const & resource) const
+{
+	return m_resources[resource].firstPass >= 0;
+}
+
+unsigned int RenderGraph::GetTextureHandle(Resource const & resource) const
+{
+	return m_resources[resource].physical < 0 ? 0 : m_pool[m_resources[resource].physical].texture.GetHandle();
+}
+
+unsigned int RenderGraph::GetExecutedPassesCount() const
+{
+	return (unsigned int)m_executionOrder.size();
+}
+
+unsigned long long RenderGraph::GetTransientMemory() const
+{
+	//what the transient targets would take without sharing textures
+	unsigned long long size = 0;
+	for (auto const & resource : m_resources)
+		if (resource.transient && resource.physical >= 0)
+			size += GetTextureSize(resource.description);
+	return size;
+}
+
+unsigned long long RenderGraph::GetPooledMemory() const
+{
+	unsigned long long size = 0;
+	for (auto const & physical : m_pool)
+		size += GetTextureSize(physical.description);
+	return size;
+}
+
+#pragma endregion
+
+#pragma region "Private Methods"
+
+unsigned long long RenderGraph::GetTextureSize(TextureDescription const & description)
+{
+	unsigned long long bytesPerPixel = 4;
+	if (description.internalFormat == GL_RGBA32F)
+		bytesPerPixel = 16;
+	else if (description.internalFormat == GL_RGBA16F)
+		bytesPerPixel = 8;
+
+	return bytesPerPixel * description.width * description.height;
+}
+
+#pragma endregion
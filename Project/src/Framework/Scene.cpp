@@ -4,17 +4,23 @@
 #include <Framework/Material.h>
 #include <Framework/IRenderPass.h>
 #include <Framework/Defaults.h>
+#include <Framework/SceneSnapshot.h>
+#include <Framework/NodePool.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <png/png.h>
 #include <GL/glew.h>
 
+#include <chrono>
+#include <unordered_map>
+
 #pragma region "Constructors/Destructor"
 
-Scene::Scene(Application & application, unsigned const & windowWidth, unsigned const & windowHeight) : m_application(application), m_rootNode(new Node("Root")), m_camera(m_viewMatrix), m_meshes(), m_materials(), m_textures(), m_projectionMatrix(), m_viewMatrix(), m_sceneSize(glm::vec3(1, 1, 1)), m_ambientIntensity(glm::vec3(0, 0, 0)), m_windowWidth(windowWidth), m_windowHeight(windowHeight)
+Scene::Scene(Application & application, unsigned const & windowWidth, unsigned const & windowHeight) : m_application(application), m_rootNode(new Node("Root")), m_camera(m_viewMatrix), m_meshes(), m_materials(), m_textures(), m_projectionMatrix(), m_viewMatrix(), m_frontPlane(0.1f), m_backPlane(1000.0f), m_sceneSize(glm::vec3(1, 1, 1)), m_ambientIntensity(glm::vec3(0, 0, 0)), m_windowWidth(windowWidth), m_windowHeight(windowHeight), m_snapshot(new SceneSnapshot()), m_changedNodes(), m_slotsCount(0)
 {
-
+	Register(m_rootNode);
+	PublishSnapshot();
 }
 
 Scene::~Scene()
@@ -46,6 +52,16 @@ glm::mat4 const & Scene::GetViewMatrix() const
 	return m_viewMatrix;
 }
 
+float const & Scene::GetFrontPlane() const
+{
+	return m_frontPlane;
+}
+
+float const & Scene::GetBackPlane() const
+{
+	return m_backPlane;
+}
+
 glm::vec3 const & Scene::GetSceneSize() const
 {
 	return m_sceneSize;
@@ -63,6 +79,8 @@ glm::vec3 const & Scene::GetAmbientIntensity() const
 void Scene::SetProjection(float const & ry, float const & front, float const & back)
 {
 	float rx = ry * (float)m_windowWidth / (float)m_windowHeight;
+	m_frontPlane = front;
+	m_backPlane = back;
 	m_projectionMatrix = glm::mat4(
 		glm::vec4(1.0f / rx, 0.0f, 0.0f, 0.0f), 
 		glm::vec4(0.0f, 1.0f / ry, 0.0f, 0.0f), 
@@ -97,14 +115,14 @@ void Scene::SetAmbientIntensity(glm::vec3 const & ambientIntensity)
 Mesh * Scene::CreateMesh(std::string const & name, std::string const & path)
 {
 	Assimp::Importer importer;
-	aiScene const * scene = importer.ReadFile(path, aiProcess_CalcTangentSpace | aiProcess_Triangulate);
+	aiScene const * scene = importer.ReadFile(path, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
 
 	if (!scene || !scene->HasMeshes())
 		return nullptr;
 
 	//process the object
 	aiMesh * assimpMesh = scene->mMeshes[0];
-	Mesh * mesh = new Mesh(assimpMesh->mNumFaces, assimpMesh->mFaces, assimpMesh->mVertices, assimpMesh->mNormals, assimpMesh->mTangents, assimpMesh->mTextureCoords);
+	Mesh * mesh = new Mesh(assimpMesh->mNumVertices, assimpMesh->mNumFaces, assimpMesh->mFaces, assimpMesh->mVertices, assimpMesh->mNormals, assimpMesh->mTangents, assimpMesh->mTextureCoords);
 	MeshInfo meshInfo = { path, mesh, 0 };
 	m_meshes.push_back(std::make_pair(name, meshInfo));
 	return mesh;
@@ -259,9 +277,9 @@ Texture * Scene::CreateTexture(std::string const & name, std::string const & pat
 	return texture;
 }
 
-std::string Scene::OpenFile(char const * filter)
+void Scene::OpenFile(char const * filter, std::function<void(std::string const &)> const & opened)
 {
-	return m_application.OpenFile(filter);
+	m_application.OpenFile(filter, opened);
 }
 
 void Scene::AddNode(Node * node)
@@ -269,15 +287,6 @@ void Scene::AddNode(Node * node)
 	m_rootNode->AddChild(node);
 }
 
-void Scene::Traverse(IRenderPass const & pass) const
-{
-	static glm::mat4 identity = glm::mat4();
-	for (auto & const node : m_rootNode->m_children)
-	{
-		TraverseNode(node, pass, identity);
-	}
-}
-
 void Scene::Resize(int const & width, int const & height)
 {
 	float ry = 1.0f / m_projectionMatrix[1][1];
@@ -373,15 +382,103 @@ void Scene::DecrementReference(Texture const * texture)
 }
 
 
+#pragma endregion
+
+#pragma region "Snapshots"
+
+std::shared_ptr<SceneSnapshot const> Scene::GetSnapshot() const
+{
+	return std::atomic_load(&m_snapshot);
+}
+
+void Scene::PublishSnapshot()
+{
+	std::shared_ptr<SceneSnapshot const> const previous = std::atomic_load(&m_snapshot);
+	if (m_changedNodes.empty() && previous->m_viewMatrix == m_viewMatrix && previous->m_projectionMatrix == m_projectionMatrix)
+		return;
+
+	auto const start = std::chrono::steady_clock::now();
+
+	//the page table is the only part copied whole, one pointer per SNAPSHOT_PAGE_SIZE * SNAPSHOT_CHUNK_SIZE nodes
+	std::shared_ptr<SceneSnapshot> snapshot(new SceneSnapshot(*previous));
+	snapshot->m_version = previous->m_version + 1;
+	snapshot->m_nodesCount = m_slotsCount;
+	snapshot->m_viewMatrix = m_viewMatrix;
+	snapshot->m_projectionMatrix = m_projectionMatrix;
+	snapshot->m_changedNodesCount = (unsigned int)m_changedNodes.size();
+	snapshot->m_copiedChunksCount = 0;
+
+	unsigned int const chunksCount = (m_slotsCount + SNAPSHOT_CHUNK_SIZE - 1) / SNAPSHOT_CHUNK_SIZE;
+	snapshot->m_pages.resize((chunksCount + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE);
+
+	//pages and chunks are copied the first time this publish writes to them, later changes in them are written in place
+	std::unordered_map<unsigned int, SceneSnapshot::Page *> writablePages;
+	std::unordered_map<unsigned int, SceneSnapshot::Chunk *> writableChunks;
+	for (auto node : m_changedNodes)
+	{
+		unsigned int const chunkIndex = node->m_slot / SNAPSHOT_CHUNK_SIZE;
+		unsigned int const pageIndex = chunkIndex / SNAPSHOT_PAGE_SIZE;
+
+		auto page = writablePages.find(pageIndex);
+		if (page == writablePages.end())
+		{
+			std::shared_ptr<SceneSnapshot::Page const> const & shared = snapshot->m_pages[pageIndex];
+			SceneSnapshot::Page * copy = shared ? new SceneSnapshot::Page(*shared) : new SceneSnapshot::Page();
+			snapshot->m_pages[pageIndex].reset(copy);
+			page = writablePages.insert(std::make_pair(pageIndex, copy)).first;
+		}
+
+		auto chunk = writableChunks.find(chunkIndex);
+		if (chunk == writableChunks.end())
+		{
+			std::shared_ptr<SceneSnapshot::Chunk const> & shared = page->second->chunks[chunkIndex % SNAPSHOT_PAGE_SIZE];
+			SceneSnapshot::Chunk * copy = shared ? new SceneSnapshot::Chunk(*shared) : new SceneSnapshot::Chunk();
+			shared.reset(copy);
+			chunk = writableChunks.insert(std::make_pair(chunkIndex, copy)).first;
+			snapshot->m_copiedChunksCount++;
+		}
+
+		//a node whose links changed keeps its copy, the render side state kept on it survives
+		SceneSnapshot::NodeRecord & record = chunk->second->records[node->m_slot % SNAPSHOT_CHUNK_SIZE];
+		if (node->m_contentChanged || !record.node)
+			record.node.reset(node->Clone(), std::default_delete<Node const>(), NodeAllocator<Node>());
+
+		record.firstChild = node->m_firstChild ? node->m_firstChild->m_slot : SceneSnapshot::NO_NODE;
+		record.nextSibling = node->m_nextSibling ? node->m_nextSibling->m_slot : SceneSnapshot::NO_NODE;
+
+		node->m_contentChanged = false;
+		node->m_linksChanged = false;
+	}
+	m_changedNodes.clear();
+
+	snapshot->m_publishTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::atomic_store(&m_snapshot, std::shared_ptr<SceneSnapshot const>(snapshot));
+}
+
 #pragma endregion
 
 #pragma region "Private Methods"
 
-void Scene::TraverseNode(Node * const & node, IRenderPass const & pass, glm::mat4 const & modelMatrix) const
+void Scene::Register(Node * node)
 {
-	pass.ProcessNode(node, modelMatrix * node->GetTransformMatrixWithScale());
-	for (auto & const child : node->m_children)
-		TraverseNode(child, pass, modelMatrix * node->GetTransformMatrix());
+	//slots are handed out in order, nodes are never removed from a scene
+	node->m_scene = this;
+	node->m_slot = m_slotsCount++;
+	MarkChanged(node, true);
+
+	for (Node * child = node->m_firstChild; child; child = child->m_nextSibling)
+		Register(child);
+}
+
+void Scene::MarkChanged(Node * node, bool const & content)
+{
+	if (!node->m_contentChanged && !node->m_linksChanged)
+		m_changedNodes.push_back(node);
+
+	if (content)
+		node->m_contentChanged = true;
+	else
+		node->m_linksChanged = true;
 }
 
 #pragma endregion
\ No newline at end of file
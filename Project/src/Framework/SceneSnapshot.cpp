@@ -0,0 +1,139 @@
+#include <Framework/SceneSnapshot.h>
+#include <Framework/Node.h>
+#include <Framework/IRenderPass.h>
+#include <Framework/JobSystem.h>
+
+#include <utility>
+
+#pragma region "Constructors/Destructor"
+
+SceneSnapshot::SceneSnapshot() : m_pages(), m_nodesCount(0), m_version(0), m_viewMatrix(), m_projectionMatrix(), m_changedNodesCount(0), m_copiedChunksCount(0), m_publishTime(0.0f)
+{
+
+}
+
+SceneSnapshot::~SceneSnapshot()
+{
+
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+void SceneSnapshot::Traverse(IRenderPass const & pass) const
+{
+	//slot 0 is the root of the scene
+	std::vector<std::pair<unsigned int, glm::mat4>> subtrees;
+	if (m_nodesCount)
+		for (unsigned int child = GetRecord(0).firstChild; child != NO_NODE; child = GetRecord(child).nextSibling)
+			subtrees.push_back(std::make_pair(child, glm::mat4()));
+
+	//split the hierarchy breadth first until there are enough subtrees to keep every worker busy
+	std::vector<std::pair<unsigned int, glm::mat4>> parents;
+	unsigned int const subtreesCount = JobSystem::GetWorkersCount() * JOB_CHUNKS_PER_WORKER * TRAVERSAL_SUBTREES_PER_CHUNK;
+	while (subtrees.size() < subtreesCount)
+	{
+		std::vector<std::pair<unsigned int, glm::mat4>> next;
+		for (auto const & subtree : subtrees)
+		{
+			NodeRecord const & record = GetRecord(subtree.first);
+			if (record.firstChild == NO_NODE)
+			{
+				next.push_back(subtree);
+				continue;
+			}
+
+			parents.push_back(subtree);
+			glm::mat4 const modelMatrix = subtree.second * record.node->GetTransformMatrix();
+			for (unsigned int child = record.firstChild; child != NO_NODE; child = GetRecord(child).nextSibling)
+				next.push_back(std::make_pair(child, modelMatrix));
+		}
+
+		if (next.size() == subtrees.size())
+			break;
+		subtrees.swap(next);
+	}
+
+	//the nodes above the subtrees go to the first bucket, every chunk of subtrees transforms and gathers into its own
+	unsigned int const bucketsCount = glm::max(JobSystem::GetChunksCount(subtrees.size(), TRAVERSAL_SUBTREES_PER_CHUNK), 1u);
+	pass.PrepareTraversal(bucketsCount);
+
+	for (auto const & parent : parents)
+	{
+		Node const * node = GetRecord(parent.first).node.get();
+		pass.ProcessNode(node, parent.second * node->GetTransformMatrixWithScale(), 0);
+	}
+
+	JobSystem::ParallelFor(subtrees.size(), TRAVERSAL_SUBTREES_PER_CHUNK, [this, &pass, &subtrees](unsigned int chunk, unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+			TraverseNode(subtrees[i].first, pass, subtrees[i].second, chunk);
+	});
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+Node const * SceneSnapshot::GetNode(unsigned int const & slot) const
+{
+	return slot < m_nodesCount ? GetRecord(slot).node.get() : nullptr;
+}
+
+unsigned long long const & SceneSnapshot::GetVersion() const
+{
+	return m_version;
+}
+
+unsigned int const & SceneSnapshot::GetNodesCount() const
+{
+	return m_nodesCount;
+}
+
+glm::mat4 const & SceneSnapshot::GetViewMatrix() const
+{
+	return m_viewMatrix;
+}
+
+glm::mat4 const & SceneSnapshot::GetProjectionMatrix() const
+{
+	return m_projectionMatrix;
+}
+
+unsigned int const & SceneSnapshot::GetChangedNodesCount() const
+{
+	return m_changedNodesCount;
+}
+
+unsigned int const & SceneSnapshot::GetCopiedChunksCount() const
+{
+	return m_copiedChunksCount;
+}
+
+float const & SceneSnapshot::GetPublishTime() const
+{
+	return m_publishTime;
+}
+
+#pragma endregion
+
+#pragma region "Private Methods"
+
+SceneSnapshot::NodeRecord const & SceneSnapshot::GetRecord(unsigned int const & slot) const
+{
+	unsigned int const chunk = slot / SNAPSHOT_CHUNK_SIZE;
+	return m_pages[chunk / SNAPSHOT_PAGE_SIZE]->chunks[chunk % SNAPSHOT_PAGE_SIZE]->records[slot % SNAPSHOT_CHUNK_SIZE];
+}
+
+void SceneSnapshot::TraverseNode(unsigned int const & slot, IRenderPass const & pass, glm::mat4 const & modelMatrix, unsigned int const & bucket) const
+{
+	NodeRecord const & record = GetRecord(slot);
+	pass.ProcessNode(record.node.get(), modelMatrix * record.node->GetTransformMatrixWithScale(), bucket);
+
+	glm::mat4 const childMatrix = modelMatrix * record.node->GetTransformMatrix();
+	for (unsigned int child = record.firstChild; child != NO_NODE; child = GetRecord(child).nextSibling)
+		TraverseNode(child, pass, childMatrix, bucket);
+}
+
+#pragma endregion
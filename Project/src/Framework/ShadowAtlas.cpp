@@ -0,0 +1,149 @@
+#include <Framework/ShadowAtlas.h>
+
+#include <algorithm>
+
+#pragma region "Constructors/Destructor"
+
+ShadowAtlas::ShadowAtlas(unsigned int const & size, unsigned int const & minTileSize) : m_size(size), m_minTileSize(minTileSize), m_levels(0), m_usedArea(0), m_nodes(), m_levelOffsets()
+{
+	//one level per power of two between the atlas and the smallest tile
+	unsigned int nodes = 0;
+	for (unsigned int tileSize = m_size; tileSize >= m_minTileSize; tileSize >>= 1, ++m_levels)
+	{
+		m_levelOffsets.push_back(nodes);
+		nodes += (1 << m_levels) * (1 << m_levels);
+	}
+
+	m_nodes.resize(nodes, FREE);
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+}
+
+#pragma endregion
+
+#pragma region "Public Methods"
+
+bool ShadowAtlas::Allocate(unsigned int const & size, Tile & tile)
+{
+	unsigned int level = 0;
+	while (level + 1 < m_levels && (m_size >> (level + 1)) >= size)
+		level++;
+
+	//only power of two tiles between the smallest tile and the atlas are handed out
+	if ((m_size >> level) != size)
+		return false;
+
+	return AllocateNode(0, 0, 0, level, tile);
+}
+
+void ShadowAtlas::Free(Tile const & tile)
+{
+	unsigned int level = 0;
+	while ((m_size >> level) > tile.size)
+		level++;
+
+	unsigned int x = tile.x / tile.size;
+	unsigned int y = tile.y / tile.size;
+
+	if (m_nodes[GetNodeIndex(level, x, y)] != USED)
+		return;
+
+	m_nodes[GetNodeIndex(level, x, y)] = FREE;
+	m_usedArea -= tile.size * tile.size;
+
+	//merge the parents back as long as all four of their children are free
+	while (level > 0)
+	{
+		x &= ~1u;
+		y &= ~1u;
+		if (m_nodes[GetNodeIndex(level, x, y)] != FREE || m_nodes[GetNodeIndex(level, x + 1, y)] != FREE ||
+			m_nodes[GetNodeIndex(level, x, y + 1)] != FREE || m_nodes[GetNodeIndex(level, x + 1, y + 1)] != FREE)
+			break;
+
+		level--;
+		x >>= 1;
+		y >>= 1;
+		m_nodes[GetNodeIndex(level, x, y)] = FREE;
+	}
+}
+
+void ShadowAtlas::Clear()
+{
+	std::fill(m_nodes.begin(), m_nodes.end(), (unsigned char)FREE);
+	m_usedArea = 0;
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+unsigned int const & ShadowAtlas::GetSize() const
+{
+	return m_size;
+}
+
+unsigned int const & ShadowAtlas::GetMinTileSize() const
+{
+	return m_minTileSize;
+}
+
+unsigned int const & ShadowAtlas::GetUsedArea() const
+{
+	return m_usedArea;
+}
+
+#pragma endregion
+
+#pragma region "Private Methods"
+
+unsigned int ShadowAtlas::GetNodeIndex(unsigned int const & level, unsigned int const & x, unsigned int const & y) const
+{
+	return m_levelOffsets[level] + y * (1 << level) + x;
+}
+
+bool ShadowAtlas::AllocateNode(unsigned int const & level, unsigned int const & x, unsigned int const & y, unsigned int const & targetLevel, Tile & tile)
+{
+	unsigned char & node = m_nodes[GetNodeIndex(level, x, y)];
+
+	if (node == USED)
+		return false;
+
+	if (level == targetLevel)
+	{
+		if (node != FREE)
+			return false;
+
+		node = USED;
+		tile.size = m_size >> level;
+		tile.x = x * tile.size;
+		tile.y = y * tile.size;
+		m_usedArea += tile.size * tile.size;
+		return true;
+	}
+
+	bool const wasFree = node == FREE;
+	node = SPLIT;
+
+	//descend into children that are already split first so whole free regions stay available for large tiles
+	for (unsigned int pass = 0; pass < 2; ++pass)
+	{
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			unsigned int const childX = 2 * x + (i & 1);
+			unsigned int const childY = 2 * y + (i >> 1);
+			if (m_nodes[GetNodeIndex(level + 1, childX, childY)] != (pass == 0 ? SPLIT : FREE))
+				continue;
+
+			if (AllocateNode(level + 1, childX, childY, targetLevel, tile))
+				return true;
+		}
+	}
+
+	if (wasFree)
+		node = FREE;
+	return false;
+}
+
+#pragma endregion
@@ -1,17 +1,23 @@
 #include <Framework/ShadowPass.h>
 #include <Framework/Scene.h>
 #include <Framework/GlobalLight.h>
+#include <Framework/LocalLight.h>
 #include <Framework/Object.h>
 #include <Framework/Mesh.h>
+#include <Framework/StateCache.h>
+#include <Framework/JobSystem.h>
 #include <Framework/DeferredRenderer.h>
 #include <Framework/Defaults.h>
 
 #include <GL/glew.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <string>
 
 #pragma region "Constructors/Destructor"
 
-ShadowPass::ShadowPass(IRenderer const * renderer) : IRenderPass(renderer), m_shadowProgram(), m_globalLights(nullptr)
+ShadowPass::ShadowPass(IRenderer const * renderer) : IRenderPass(renderer), m_globalLights(nullptr), m_drawCallsCount(0), m_trianglesCount(0), m_culledCastersCount(0), m_renderedCascadesCount(0), m_cascadesCount(0), m_shadowedLocalLightsCount(0), m_droppedLocalLightsCount(0), m_renderedFacesCount(0), m_pendingFacesCount(0), m_shadowAtlas(SHADOW_MAP_TEXTURE_UNIT), m_atlasView(), m_atlas(SHADOW_ATLAS_SIZE, MIN_LOCAL_SHADOW_TILE_SIZE), m_allocations(), m_lightRanking(), m_localShadows(), m_localRanking(), m_localTileSizes(), m_localShadowBuffer(5, 16), m_momentsAtlas(SHADOW_MOMENTS_TEXTURE_UNIT), m_blurTarget(), m_viewUniformBuffer(4), m_casterBuffer(3, 4000), m_casterBatches(), m_casterChunks(), m_localSignatures(), m_localCasters(), m_localCasterCells(), m_commandBuffers(), m_views(), m_lodBias(1), m_shadowDistance(60.0f), m_splitLambda(0.75f), m_slopeBias(2.0f), m_constantBias(4.0f), m_atlasBudget(1.0f), m_localFaceBudget(12), m_shadowFilter(HARDWARE_FILTER), m_blurRadius(4), m_momentsExponents(40.0f, 5.0f), m_lightBleedingReduction(0.3f), m_shadowProgram(), m_momentsProgram(), m_blurProgram()
 {
 }
 
@@ -24,66 +30,945 @@ ShadowPass::~ShadowPass()
 
 #pragma region "Public Methods"
 
-static float const front = 0.1f;
-static float const back = 100.0f;
-static glm::mat4 const g_projectionMatrix(glm::vec4(5, 0, 0, 0),
-											glm::vec4(0, 1.0f / (0.2f * ((float)DEFAULT_SHADOW_WIDTH / (float)DEFAULT_SHADOW_HEIGHT)), 0, 0),
-											glm::vec4(0, 0, (front - back) / (back - front), -1.0f),
-											glm::vec4(0, 0, (-2.0f * front * back) / (back - front), 0.0f));
-
 static glm::mat4 const g_BMatrix(glm::vec4(0.5, 0, 0, 0), glm::vec4(0, 0.5, 0, 0), glm::vec4(0, 0, 0.5, 0), glm::vec4(0.5, 0.5, 0.5, 1));
 
+//cube face directions and up vectors, +x -x +y -y +z -z
+static glm::vec3 const g_faceDirections[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+static glm::vec3 const g_faceUps[6] = { glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+
+static glm::vec4 ClipTile(ShadowAtlas::Tile const & tile)
+{
+	//maps the clip space of a view onto its tile of the atlas
+	return glm::vec4((float)tile.size / SHADOW_ATLAS_SIZE, (float)(2 * tile.x + tile.size) / SHADOW_ATLAS_SIZE - 1.0f, (float)(2 * tile.y + tile.size) / SHADOW_ATLAS_SIZE - 1.0f, 0.0f);
+}
+
+static void HashBytes(unsigned long long & hash, void const * data, size_t size)
+{
+	//64 bit FNV-1a
+	unsigned char const * bytes = (unsigned char const *)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+}
+
+//casters of local lights are binned into a sparse grid, the cell coordinates are packed 21 bits each
+static unsigned long long const g_largeCasterCell = 0xFFFFFFFFFFFFFFFFull;
+
+static unsigned long long GetCellKey(glm::ivec3 const & cell)
+{
+	return ((unsigned long long)(cell.x & 0x1FFFFF) << 42) | ((unsigned long long)(cell.y & 0x1FFFFF) << 21) | (unsigned long long)(cell.z & 0x1FFFFF);
+}
+
 void ShadowPass::Initialize()
 {
 	m_shadowProgram.CreateHandle();
+	//depth only, no fragment shader is attached
 	m_shadowProgram.AttachShader(Program::VERTEX_SHADER_TYPE, "src/Shaders/ShadowPass.vert");
-	m_shadowProgram.AttachShader(Program::FRAGMENT_SHADER_TYPE, "src/Shaders/ShadowPass.frag");
 	m_shadowProgram.Link();
+
+	m_momentsProgram.CreateHandle();
+	m_momentsProgram.AttachShader(Program::COMPUTE_SHADER_TYPE, "src/Shaders/ShadowMoments.comp");
+	m_momentsProgram.Link();
+	m_momentsProgram.SetUniform("uDepth", 12);
+
+	m_blurProgram.CreateHandle();
+	m_blurProgram.AttachShader(Program::COMPUTE_SHADER_TYPE, "src/Shaders/ShadowBlur.comp");
+	m_blurProgram.Link();
+
+	//shadow maps of all lights, compared in hardware when sampled through a shadow sampler
+	m_shadowAtlas.InitializeStorage(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, GL_DEPTH_COMPONENT32F);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	//the view is only used to preview the atlas in the gui, show depth as grey
+	GLint const swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+	m_atlasView.InitializeView(m_shadowAtlas, GL_DEPTH_COMPONENT32F);
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+	//mip levels stop at the smallest tile so coarse levels never mix neighbouring tiles
+	unsigned int levels = 1;
+	while (((MIN_SHADOW_TILE_SIZE / 2) >> levels) > 0)
+		levels++;
+	m_momentsAtlas.InitializeStorage(SHADOW_ATLAS_SIZE / 2, SHADOW_ATLAS_SIZE / 2, GL_RGBA32F, levels);
+	if (GLEW_EXT_texture_filter_anisotropic)
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 8.0f);
+	m_blurTarget.InitializeStorage(SHADOW_ATLAS_SIZE / 2, SHADOW_ATLAS_SIZE / 2, GL_RGBA32F);
+
+	//std140 places the tiles right after the matrices, so they are added in that order
+	for (unsigned int i = 0; i < MAX_SHADOW_VIEWS; ++i)
+	{
+		m_viewMatrixNames[i] = "uShadowViews.Matrices[" + std::to_string(i) + "]";
+		m_viewUniformBuffer.AddUniform(m_viewMatrixNames[i], GL_FLOAT_MAT4);
+	}
+	for (unsigned int i = 0; i < MAX_SHADOW_VIEWS; ++i)
+	{
+		m_viewTileNames[i] = "uShadowViews.Tiles[" + std::to_string(i) + "]";
+		m_viewUniformBuffer.AddUniform(m_viewTileNames[i], GL_FLOAT_VEC4);
+	}
+	m_viewUniformBuffer.Initialize();
+
+	m_casterBuffer.Initialize();
+	m_localShadowBuffer.Initialize();
 }
 
 void ShadowPass::Prepare(Scene const & scene) const
 {
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	StateCache::Disable(GL_BLEND);
+	StateCache::Enable(GL_DEPTH_TEST);
+	StateCache::SetDepthMask(true);
+
+	//slope scaled bias keeps the hardware comparison free of acne
+	StateCache::Enable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(m_slopeBias, m_constantBias);
+
+	//clip every primitive to the edges of its atlas tile
+	for (unsigned int i = 0; i < 4; ++i)
+		StateCache::Enable(GL_CLIP_DISTANCE0 + i);
+
 	m_shadowProgram.Use();
 }
 
-void ShadowPass::ProcessScene(Scene const & scene, std::vector<std::pair<GlobalLight const *, glm::vec3>> const & globalLights) const
+void ShadowPass::ProcessScene(Scene const & scene, std::vector<std::pair<GlobalLight const *, glm::vec3>> const & globalLights, std::vector<struct LocalLightInformation> & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights, std::vector<struct InstanceGroup> const & instanceGroups) const
 {
 	m_globalLights = &globalLights;
+	m_drawCallsCount = 0;
+	m_trianglesCount = 0;
+	m_culledCastersCount = 0;
+	m_renderedCascadesCount = 0;
+	m_renderedFacesCount = 0;
+	m_pendingFacesCount = 0;
+
+	m_casterBuffer.m_buffer.clear();
+	m_casterBatches.clear();
+	m_views.clear();
+
+	float splits[SHADOW_CASCADE_COUNT + 1];
+	ComputeCascadeSplits(scene, splits);
+	glm::mat4 const cameraMatrix = glm::inverse(scene.GetViewMatrix());
 
+	AllocateTiles(globalLights);
+
+	//fit the cascades of the lights that were given atlas tiles
 	for (auto const & lightPair : globalLights)
 	{
-		//bind shadow framebuffer
-		dynamic_cast<DeferredRenderer const *>(m_renderer)->BindShadowBuffer(lightPair.first->GetShadowMap());
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		auto const allocation = m_allocations.find(lightPair.first->GetSlot());
+		if (allocation == m_allocations.end())
+			continue;
+
+		//global lights shine from their position towards the origin
+		glm::vec3 direction = glm::length(lightPair.second) > 0.0f ? glm::normalize(-lightPair.second) : glm::vec3(0, -1, 0);
+		glm::vec3 const up = glm::abs(direction.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+		glm::mat4 const lightViewMatrix = glm::lookAt(glm::vec3(0), direction, up);
 
-		glm::mat4 shadowMatrix = g_projectionMatrix * glm::lookAt(lightPair.second, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-		m_shadowProgram.SetUniform("uShadowMatrix", shadowMatrix);
-		lightPair.first->m_shadowMatrix = g_BMatrix * shadowMatrix;
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+		{
+			ShadowView cascade = FitCascade(scene, cameraMatrix, lightViewMatrix, splits[i], splits[i + 1], allocation->second.tiles[i]);
+			cascade.light = lightPair.first;
+			cascade.index = i;
 
-		//traverse the scene
-		scene.Traverse(*this);
+			lightPair.first->m_shadowMatrices[i] = g_BMatrix * cascade.shadowMatrix;
+			lightPair.first->m_cascadeSplits[i] = splits[i + 1];
+			m_viewUniformBuffer.SetUniform(m_viewMatrixNames[m_views.size()], cascade.shadowMatrix);
+			m_viewUniformBuffer.SetUniform(m_viewTileNames[m_views.size()], cascade.clipTile);
+			m_views.push_back(cascade);
+		}
 	}
+	m_cascadesCount = m_views.size();
+
+	//local lights take the atlas space left by the global lights and refresh a limited number of cube faces per frame
+	AllocateLocalTiles(glm::vec3(cameraMatrix[3]), localLights, shadowedLocalLights);
+	ScheduleLocalFaces(localLights, shadowedLocalLights, instanceGroups);
+	PublishLocalShadows(localLights, shadowedLocalLights);
+
+	GatherCasters(instanceGroups);
+
+	//a cascade keeps last frame's contents unless its projection or one of its casters changed
+	for (auto & cascade : m_views)
+	{
+		//cube faces are only scheduled when they have to be rendered
+		if (cascade.localLight)
+			continue;
+
+		HashBytes(cascade.signature, &cascade.shadowMatrix, sizeof(glm::mat4));
+		HashBytes(cascade.signature, &m_slopeBias, sizeof(float));
+		HashBytes(cascade.signature, &m_constantBias, sizeof(float));
+		HashBytes(cascade.signature, &m_shadowFilter, sizeof(int));
+		if (m_shadowFilter == MOMENTS_FILTER)
+		{
+			HashBytes(cascade.signature, &m_momentsExponents, sizeof(glm::vec2));
+			HashBytes(cascade.signature, &m_blurRadius, sizeof(int));
+		}
+
+		//never collide with the reset state of an allocation
+		if (!cascade.signature)
+			cascade.signature = 1;
+
+		LightAllocation & allocation = m_allocations.find(cascade.light->GetSlot())->second;
+		cascade.dirty = cascade.signature != allocation.signatures[cascade.index];
+		allocation.signatures[cascade.index] = cascade.signature;
+		allocation.cacheLookups++;
+		if (!cascade.dirty)
+			allocation.cacheHits++;
+		else
+			m_renderedCascadesCount++;
+
+		cascade.light->m_shadowCacheHits = allocation.cacheHits;
+		cascade.light->m_shadowCacheLookups = allocation.cacheLookups;
+	}
+
+	if (!m_renderedCascadesCount && !m_renderedFacesCount)
+	{
+		for (unsigned int i = 0; i < 4; ++i)
+			StateCache::Disable(GL_CLIP_DISTANCE0 + i);
+		StateCache::Disable(GL_POLYGON_OFFSET_FILL);
+		return;
+	}
+
+	DiscardCleanCasters();
+
+	m_viewUniformBuffer.UploadBuffer();
+	m_casterBuffer.Upload();
+
+	//the whole atlas is attached, every caster is moved into its tile in the vertex shader
+	dynamic_cast<DeferredRenderer const *>(m_renderer)->BindShadowBuffer(m_shadowAtlas);
+
+	float const clearDepth = 1.0f;
+	for (auto const & view : m_views)
+		if (view.dirty)
+			glClearTexSubImage(m_shadowAtlas.GetHandle(), 0, view.tile.x, view.tile.y, 0, view.tile.size, view.tile.size, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &clearDepth);
+
+	//one draw per mesh and level of detail, independent of the number of lights
+	m_commandBuffers.resize(JobSystem::GetChunksCount(m_casterBatches.size(), CASTER_BATCHES_PER_CHUNK));
+	JobSystem::ParallelFor(m_casterBatches.size(), CASTER_BATCHES_PER_CHUNK, [this](unsigned int chunk, unsigned int begin, unsigned int end)
+	{
+		CommandBuffer & commands = m_commandBuffers[chunk];
+		commands.Clear();
+		commands.UseProgram(m_shadowProgram);
+
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			CasterBatch const & batch = m_casterBatches[i];
+			commands.SetUniform("uCasterOffset", (int)batch.offset);
+			commands.BindVertexArray(batch.mesh->GetVAO());
+			commands.DrawIndexed(batch.mesh->GetIndexCount(batch.lod), batch.mesh->GetIndexOffset(batch.lod), batch.count);
+		}
+	});
+
+	for (auto const & commands : m_commandBuffers)
+	{
+		commands.Replay();
+		m_drawCallsCount += commands.GetDrawsCount();
+		m_trianglesCount += commands.GetTrianglesCount();
+	}
+
+	for (unsigned int i = 0; i < 4; ++i)
+		StateCache::Disable(GL_CLIP_DISTANCE0 + i);
+	StateCache::Disable(GL_POLYGON_OFFSET_FILL);
+
+	if (m_shadowFilter == MOMENTS_FILTER && m_renderedCascadesCount)
+		FilterMoments();
+}
+
+void ShadowPass::ProcessNode(Node const * const & /*node*/, glm::mat4 const & /*modelMatrix*/, unsigned int const & /*bucket*/) const
+{
+	//casters are submitted per instance group in ProcessScene
 }
 
-void ShadowPass::ProcessNode(Node const * const & node, glm::mat4 const & modelMatrix) const
+void ShadowPass::Finalize()
+{
+	m_atlasView.Free();
+	m_shadowAtlas.Free();
+	m_momentsAtlas.Free();
+	m_blurTarget.Free();
+	m_momentsProgram.DestroyHandle();
+	m_blurProgram.DestroyHandle();
+
+	m_viewUniformBuffer.Free();
+	m_casterBuffer.Free();
+	m_localShadowBuffer.Free();
+}
+
+#pragma endregion
+
+#pragma region "Getters"
+
+Texture const & ShadowPass::GetShadowAtlas() const
 {
-	if (node->GetNodeType() == Node::OBJECT_NODE)
+	return m_shadowAtlas;
+}
+
+Texture const & ShadowPass::GetMomentsAtlas() const
+{
+	return m_momentsAtlas;
+}
+
+int const & ShadowPass::GetShadowFilter() const
+{
+	return m_shadowFilter;
+}
+
+glm::vec2 const & ShadowPass::GetMomentsExponents() const
+{
+	return m_momentsExponents;
+}
+
+float const & ShadowPass::GetLightBleedingReduction() const
+{
+	return m_lightBleedingReduction;
+}
+
+#pragma endregion
+
+#pragma region "Private Methods"
+
+void ShadowPass::AllocateTiles(std::vector<std::pair<GlobalLight const *, glm::vec3>> const & globalLights) const
+{
+	//a global light lights the whole screen, so its influence on the view is its brightness
+	m_lightRanking.clear();
+	for (auto const & lightPair : globalLights)
+		m_lightRanking.push_back(std::make_pair(glm::dot(lightPair.first->GetIntensity(), glm::vec3(0.2126f, 0.7152f, 0.0722f)), lightPair.first));
+
+	std::stable_sort(m_lightRanking.begin(), m_lightRanking.end(), [](std::pair<float, GlobalLight const *> const & a, std::pair<float, GlobalLight const *> const & b) { return a.first > b.first; });
+	if (m_lightRanking.size() > MAX_SHADOWED_GLOBAL_LIGHTS)
+		m_lightRanking.resize(MAX_SHADOWED_GLOBAL_LIGHTS);
+
+	//the key light gets full resolution, the shadowed area of the others scales with their relative brightness
+	unsigned int resolutions[MAX_SHADOWED_GLOBAL_LIGHTS];
+	unsigned int area = 0;
+	float const keyInfluence = m_lightRanking.empty() ? 0.0f : m_lightRanking.front().first;
+	for (unsigned int i = 0; i < m_lightRanking.size(); ++i)
+	{
+		float const influence = keyInfluence > 0.0f ? glm::max(m_lightRanking[i].first, 0.0f) / keyInfluence : 1.0f;
+		unsigned int const ideal = (unsigned int)(DEFAULT_SHADOW_WIDTH * glm::sqrt(influence));
+
+		resolutions[i] = DEFAULT_SHADOW_WIDTH;
+		while (resolutions[i] > MIN_SHADOW_TILE_SIZE && resolutions[i] > ideal)
+			resolutions[i] >>= 1;
+		area += SHADOW_CASCADE_COUNT * resolutions[i] * resolutions[i];
+	}
+
+	//fit the budget by halving the least important lights first, dropping their shadows once they hit the smallest tile
+	unsigned int const budget = (unsigned int)(m_atlasBudget * SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE);
+	while (area > budget)
+	{
+		int light = (int)m_lightRanking.size() - 1;
+		while (light >= 0 && resolutions[light] <= MIN_SHADOW_TILE_SIZE)
+			light--;
+
+		if (light >= 0)
+		{
+			area -= SHADOW_CASCADE_COUNT * 3 * (resolutions[light] / 2) * (resolutions[light] / 2);
+			resolutions[light] >>= 1;
+		}
+		else
+		{
+			light = (int)m_lightRanking.size() - 1;
+			area -= SHADOW_CASCADE_COUNT * resolutions[light] * resolutions[light];
+			m_lightRanking.pop_back();
+		}
+	}
+
+	//keep the tiles of lights whose resolution did not change so their cached cascades survive
+	for (auto & allocation : m_allocations)
+		allocation.second.active = false;
+	for (unsigned int i = 0; i < m_lightRanking.size(); ++i)
+	{
+		auto const allocation = m_allocations.find(m_lightRanking[i].second->GetSlot());
+		if (allocation != m_allocations.end() && allocation->second.resolution == resolutions[i])
+			allocation->second.active = true;
+	}
+
+	for (auto allocation = m_allocations.begin(); allocation != m_allocations.end();)
+	{
+		if (allocation->second.active)
+		{
+			++allocation;
+			continue;
+		}
+
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+			m_atlas.Free(allocation->second.tiles[i]);
+		allocation = m_allocations.erase(allocation);
+	}
+
+	//lights are ranked by decreasing resolution, which keeps the quadtree packing tight
+	bool repack = false;
+	for (unsigned int i = 0; i < m_lightRanking.size() && !repack; ++i)
 	{
-		m_shadowProgram.SetUniform("uModelMatrix", modelMatrix);
-		Object const * object = dynamic_cast<Object const *>(node);
-		glBindVertexArray(object->GetMesh()->GetVAO());
-		glEnableVertexAttribArray(0);
-		glDrawArrays(GL_TRIANGLES, 0, object->GetMesh()->GetVertexCount());
-		glDisableVertexAttribArray(0);
-		glBindVertexArray(0);
+		if (m_allocations.count(m_lightRanking[i].second->GetSlot()))
+			continue;
+
+		LightAllocation allocation = { {}, resolutions[i], {}, 0, 0, true };
+		for (unsigned int j = 0; j < SHADOW_CASCADE_COUNT && !repack; ++j)
+			repack = !m_atlas.Allocate(resolutions[i], allocation.tiles[j]);
+
+		m_allocations[m_lightRanking[i].second->GetSlot()] = allocation;
+	}
+
+	//the budget always fits an empty atlas, so start over when the kept tiles fragmented it
+	if (repack)
+	{
+		m_atlas.Clear();
+		m_allocations.clear();
+		m_localShadows.clear();
+		for (unsigned int i = 0; i < m_lightRanking.size(); ++i)
+		{
+			LightAllocation allocation = { {}, resolutions[i], {}, 0, 0, true };
+			for (unsigned int j = 0; j < SHADOW_CASCADE_COUNT; ++j)
+				m_atlas.Allocate(resolutions[i], allocation.tiles[j]);
+
+			m_allocations[m_lightRanking[i].second->GetSlot()] = allocation;
+		}
+	}
+
+	//the allocations are kept by slot, every frame publishes them onto the light, which may be a fresh copy
+	for (auto const & lightPair : globalLights)
+	{
+		GlobalLight const * light = lightPair.first;
+		auto const allocation = m_allocations.find(light->GetSlot());
+		if (allocation == m_allocations.end())
+		{
+			light->ResetShadowState();
+			light->m_shadowResolution = 0;
+			continue;
+		}
+
+		light->m_shadowResolution = allocation->second.resolution;
+		light->m_shadowCacheHits = allocation->second.cacheHits;
+		light->m_shadowCacheLookups = allocation->second.cacheLookups;
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+		{
+			ShadowAtlas::Tile const & tile = allocation->second.tiles[i];
+			light->m_shadowTiles[i] = glm::vec3((float)tile.x / SHADOW_ATLAS_SIZE, (float)tile.y / SHADOW_ATLAS_SIZE, (float)tile.size / SHADOW_ATLAS_SIZE);
+		}
 	}
 }
 
-void ShadowPass::Finalize()
+void ShadowPass::ComputeCascadeSplits(Scene const & scene, float splits[SHADOW_CASCADE_COUNT + 1]) const
+{
+	float const front = scene.GetFrontPlane();
+	float const back = glm::max(glm::min(scene.GetBackPlane(), m_shadowDistance), front + 1.0f);
+
+	//practical split scheme, blend between logarithmic and uniform distribution
+	for (unsigned int i = 0; i <= SHADOW_CASCADE_COUNT; ++i)
+	{
+		float const t = (float)i / (float)SHADOW_CASCADE_COUNT;
+		float const logarithmic = front * glm::pow(back / front, t);
+		float const uniform = front + (back - front) * t;
+		splits[i] = m_splitLambda * logarithmic + (1.0f - m_splitLambda) * uniform;
+	}
+}
+
+ShadowPass::ShadowView ShadowPass::FitCascade(Scene const & scene, glm::mat4 const & cameraMatrix, glm::mat4 const & lightViewMatrix, float const & nearSplit, float const & farSplit, ShadowAtlas::Tile const & tile) const
+{
+	glm::mat4 const & projectionMatrix = scene.GetProjectionMatrix();
+
+	//squared slope of the frustum corners, the corners of a slice at depth d are d * k away from the view axis
+	float const k2 = 1.0f / (projectionMatrix[0][0] * projectionMatrix[0][0]) + 1.0f / (projectionMatrix[1][1] * projectionMatrix[1][1]);
+
+	//bounding sphere of the slice, equidistant from the near and far corners, its radius does not change when the camera rotates
+	float center = 0.5f * (nearSplit + farSplit) * (1.0f + k2);
+	float radius;
+	if (center >= farSplit)
+	{
+		center = farSplit;
+		radius = farSplit * glm::sqrt(k2);
+	}
+	else
+	{
+		radius = glm::sqrt(nearSplit * nearSplit * k2 + (center - nearSplit) * (center - nearSplit));
+	}
+
+	ShadowView cascade;
+	cascade.viewMatrix = lightViewMatrix;
+	cascade.center = glm::vec3(lightViewMatrix * cameraMatrix * glm::vec4(0, 0, -center, 1));
+
+	//leave room for one texel on either side so snapping never pulls the sphere out of the map
+	cascade.halfSize = radius * (float)tile.size / (float)(tile.size - 2);
+	float const texelSize = 2.0f * cascade.halfSize / (float)tile.size;
+
+	//snap the cascade to whole texels so the shadow edges do not shimmer when the camera moves
+	cascade.center.x = glm::floor(cascade.center.x / texelSize) * texelSize;
+	cascade.center.y = glm::floor(cascade.center.y / texelSize) * texelSize;
+
+	//casters outside the slice but between it and the light still have to be rendered
+	cascade.extent = glm::length(scene.GetSceneSize());
+
+	cascade.shadowMatrix = glm::ortho(cascade.center.x - cascade.halfSize, cascade.center.x + cascade.halfSize,
+										cascade.center.y - cascade.halfSize, cascade.center.y + cascade.halfSize,
+										-(cascade.center.z + cascade.halfSize + cascade.extent), -(cascade.center.z - cascade.halfSize)) * lightViewMatrix;
+	cascade.light = nullptr;
+	cascade.localLight = nullptr;
+	cascade.index = 0;
+
+	cascade.tile = tile;
+	cascade.clipTile = ClipTile(tile);
+	cascade.signature = 14695981039346656037ull;
+	cascade.dirty = true;
+	return cascade;
+}
+
+void ShadowPass::AllocateLocalTiles(glm::vec3 const & eyePosition, std::vector<struct LocalLightInformation> const & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights) const
 {
+	//rank by brightness weighted with the solid angle the light sphere covers from the eye
+	m_localRanking.clear();
+	for (unsigned int i = 0; i < shadowedLocalLights.size(); ++i)
+	{
+		LocalLightInformation const & information = localLights[shadowedLocalLights[i].second];
+		glm::vec3 const position(information.position[0], information.position[1], information.position[2]);
+		float const distance = glm::max(glm::length(position - eyePosition), information.radius);
+		float const coverage = information.radius / distance;
+		float const luminance = 0.2126f * information.intensity[0] + 0.7152f * information.intensity[1] + 0.0722f * information.intensity[2];
+		m_localRanking.push_back(std::make_pair(luminance * coverage * coverage, i));
+	}
+	std::stable_sort(m_localRanking.begin(), m_localRanking.end(), [](std::pair<float, unsigned int> const & a, std::pair<float, unsigned int> const & b) { return a.first > b.first; });
+
+	//every light asks for full resolution, the least important ones are halved first, level by level, and dropped once even the smallest tiles do not fit
+	unsigned int localArea = 0;
+	for (auto const & localShadow : m_localShadows)
+		localArea += 6 * localShadow.second.tiles[0].size * localShadow.second.tiles[0].size;
+	unsigned int const freeArea = SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE - (m_atlas.GetUsedArea() - localArea);
+
+	m_localTileSizes.assign(m_localRanking.size(), LOCAL_SHADOW_TILE_SIZE);
+	unsigned long long area = 6ull * LOCAL_SHADOW_TILE_SIZE * LOCAL_SHADOW_TILE_SIZE * m_localRanking.size();
+	for (unsigned int size = LOCAL_SHADOW_TILE_SIZE; size > MIN_LOCAL_SHADOW_TILE_SIZE && area > freeArea; size >>= 1)
+		for (int light = (int)m_localRanking.size() - 1; light >= 0 && area > freeArea; --light)
+		{
+			m_localTileSizes[light] = size / 2;
+			area -= 6 * 3 * (size / 2) * (size / 2);
+		}
+
+	while (area > freeArea && !m_localRanking.empty())
+	{
+		area -= 6 * MIN_LOCAL_SHADOW_TILE_SIZE * MIN_LOCAL_SHADOW_TILE_SIZE;
+		m_localRanking.pop_back();
+		m_localTileSizes.pop_back();
+	}
+
+	//lights keep their tiles unless they have to shrink, lights that grow keep them until larger tiles are found
+	for (auto & localShadow : m_localShadows)
+		localShadow.second.active = false;
+	for (unsigned int r = 0; r < m_localRanking.size(); ++r)
+	{
+		auto const localShadow = m_localShadows.find(shadowedLocalLights[m_localRanking[r].second].first->GetSlot());
+		if (localShadow != m_localShadows.end() && localShadow->second.tiles[0].size <= m_localTileSizes[r])
+			localShadow->second.active = true;
+	}
+
+	for (auto localShadow = m_localShadows.begin(); localShadow != m_localShadows.end();)
+	{
+		if (localShadow->second.active)
+		{
+			++localShadow;
+			continue;
+		}
+
+		for (unsigned int i = 0; i < 6; ++i)
+			m_atlas.Free(localShadow->second.tiles[i]);
+		localShadow = m_localShadows.erase(localShadow);
+	}
 
+	//the ranking runs from large to small tiles, which keeps the quadtree packing tight, tiles a fragmented atlas cannot fit are halved until they do
+	for (unsigned int r = 0; r < m_localRanking.size(); ++r)
+	{
+		LocalLight const * light = shadowedLocalLights[m_localRanking[r].second].first;
+		auto const current = m_localShadows.find(light->GetSlot());
+		if (current != m_localShadows.end() && current->second.tiles[0].size == m_localTileSizes[r])
+			continue;
+
+		//new lights start with all of their faces pending
+		LocalShadow localShadow = { {}, {}, 0, 0x3F, false, true };
+		unsigned int allocated = 0;
+		unsigned int const minSize = current != m_localShadows.end() ? current->second.tiles[0].size * 2 : MIN_LOCAL_SHADOW_TILE_SIZE;
+		for (unsigned int size = m_localTileSizes[r]; size >= minSize && allocated < 6; size >>= 1)
+		{
+			allocated = 0;
+			while (allocated < 6 && m_atlas.Allocate(size, localShadow.tiles[allocated]))
+				allocated++;
+
+			if (allocated < 6)
+				for (unsigned int i = 0; i < allocated; ++i)
+					m_atlas.Free(localShadow.tiles[i]);
+		}
+
+		if (allocated < 6)
+			continue;
+
+		if (current != m_localShadows.end())
+			for (unsigned int i = 0; i < 6; ++i)
+				m_atlas.Free(current->second.tiles[i]);
+		m_localShadows[light->GetSlot()] = localShadow;
+	}
+
+	m_droppedLocalLightsCount = (unsigned int)shadowedLocalLights.size() - (unsigned int)m_localShadows.size();
+	m_shadowedLocalLightsCount = m_localShadows.size();
+}
+
+void ShadowPass::ScheduleLocalFaces(std::vector<struct LocalLightInformation> & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights, std::vector<struct InstanceGroup> const & instanceGroups) const
+{
+	//cells as large as the largest light sphere, so a light only looks at the casters of the few cells around it
+	float cellSize = 0.0f;
+	for (auto const & ranking : m_localRanking)
+		if (m_localShadows.count(shadowedLocalLights[ranking.second].first->GetSlot()))
+			cellSize = glm::max(cellSize, localLights[shadowedLocalLights[ranking.second].second].radius);
+	GatherLocalCasters(instanceGroups, cellSize);
+
+	//the light moving or any caster inside its sphere changing invalidates all six faces
+	m_localSignatures.resize(m_localRanking.size());
+	JobSystem::ParallelFor(m_localRanking.size(), LOCAL_SHADOWS_PER_CHUNK, [&](unsigned int /*chunk*/, unsigned int begin, unsigned int end)
+	{
+		for (unsigned int r = begin; r < end; ++r)
+		{
+			if (!m_localShadows.count(shadowedLocalLights[m_localRanking[r].second].first->GetSlot()))
+				continue;
+
+			LocalLightInformation const & information = localLights[shadowedLocalLights[m_localRanking[r].second].second];
+			glm::vec3 const position(information.position[0], information.position[1], information.position[2]);
+			float const lightRadius = information.radius;
+
+			//casters are no larger than a cell, so the ones touching the sphere have their centers at most one cell beyond it
+			unsigned long long casters = 0;
+			if (!m_localCasterCells.empty())
+			{
+				glm::ivec3 const first = glm::ivec3(glm::floor((position - lightRadius) / cellSize)) - 1;
+				glm::ivec3 const last = glm::ivec3(glm::floor((position + lightRadius) / cellSize)) + 1;
+				for (int z = first.z; z <= last.z; ++z)
+					for (int y = first.y; y <= last.y; ++y)
+						for (int x = first.x; x <= last.x; ++x)
+						{
+							auto const cell = m_localCasterCells.find(GetCellKey(glm::ivec3(x, y, z)));
+							if (cell == m_localCasterCells.end())
+								continue;
+
+							for (unsigned int i = cell->second.x; i < cell->second.y; ++i)
+								if (glm::length(m_localCasters[i].center - position) <= lightRadius + m_localCasters[i].radius)
+									casters += m_localCasters[i].hash;
+						}
+			}
+
+			//casters too large for the grid are tested by every light
+			auto const large = m_localCasterCells.find(g_largeCasterCell);
+			if (large != m_localCasterCells.end())
+				for (unsigned int i = large->second.x; i < large->second.y; ++i)
+					if (glm::length(m_localCasters[i].center - position) <= lightRadius + m_localCasters[i].radius)
+						casters += m_localCasters[i].hash;
+
+			unsigned long long signature = 14695981039346656037ull;
+			HashBytes(signature, &position, sizeof(glm::vec3));
+			HashBytes(signature, &lightRadius, sizeof(float));
+			HashBytes(signature, &m_slopeBias, sizeof(float));
+			HashBytes(signature, &m_constantBias, sizeof(float));
+			HashBytes(signature, &casters, sizeof(unsigned long long));
+			m_localSignatures[r] = signature;
+		}
+	});
+
+	//the most important lights are refreshed first, the others keep their stale faces until the budget reaches them
+	unsigned int budget = (unsigned int)glm::clamp(m_localFaceBudget, 0, MAX_LOCAL_SHADOW_FACE_BUDGET);
+	for (unsigned int r = 0; r < m_localRanking.size(); ++r)
+	{
+		LocalLight const * light = shadowedLocalLights[m_localRanking[r].second].first;
+		auto const localShadow = m_localShadows.find(light->GetSlot());
+		if (localShadow == m_localShadows.end())
+			continue;
+
+		LocalShadow & state = localShadow->second;
+		LocalLightInformation const & information = localLights[shadowedLocalLights[m_localRanking[r].second].second];
+		glm::vec3 const position(information.position[0], information.position[1], information.position[2]);
+		float const lightRadius = information.radius;
+
+		if (m_localSignatures[r] != state.signature)
+		{
+			state.signature = m_localSignatures[r];
+			state.pendingFaces = 0x3F;
+		}
+
+		glm::mat4 const projectionMatrix = glm::perspective(glm::half_pi<float>(), 1.0f, 0.01f * lightRadius, lightRadius);
+		for (unsigned int i = 0; i < 6 && budget; ++i)
+		{
+			if (!(state.pendingFaces & (1 << i)))
+				continue;
+
+			ShadowView face;
+			face.light = nullptr;
+			face.localLight = light;
+			face.index = i;
+			face.viewMatrix = glm::lookAt(position, position + g_faceDirections[i], g_faceUps[i]);
+			face.shadowMatrix = projectionMatrix * face.viewMatrix;
+			face.center = position;
+			face.halfSize = lightRadius;
+			face.extent = 0.0f;
+			face.tile = state.tiles[i];
+			face.clipTile = ClipTile(state.tiles[i]);
+			face.signature = 0;
+			face.dirty = true;
+
+			//faces are sampled with the matrix they were rendered with, even after the light moved on
+			state.faceMatrices[i] = g_BMatrix * face.shadowMatrix;
+			state.pendingFaces &= ~(1 << i);
+			budget--;
+
+			m_viewUniformBuffer.SetUniform(m_viewMatrixNames[m_views.size()], face.shadowMatrix);
+			m_viewUniformBuffer.SetUniform(m_viewTileNames[m_views.size()], face.clipTile);
+			m_views.push_back(face);
+			m_renderedFacesCount++;
+		}
+
+		//a light is shadowed once every face has been rendered at least once
+		if (!state.pendingFaces)
+			state.complete = true;
+
+		for (unsigned int i = 0; i < 6; ++i)
+			if (state.pendingFaces & (1 << i))
+				m_pendingFacesCount++;
+	}
+}
+
+void ShadowPass::GatherLocalCasters(std::vector<struct InstanceGroup> const & instanceGroups, float const & cellSize) const
+{
+	m_localCasterCells.clear();
+	if (cellSize <= 0.0f)
+		return;
+
+	unsigned int instancesCount = 0;
+	for (auto const & group : instanceGroups)
+		instancesCount += group.modelMatrices.size();
+
+	//every instance is hashed once per frame, independent of the number of lights
+	m_localCasters.resize(instancesCount);
+	JobSystem::ParallelFor(instancesCount, SHADOW_CASTERS_PER_CHUNK, [this, &instanceGroups, &cellSize](unsigned int /*chunk*/, unsigned int begin, unsigned int end)
+	{
+		for (auto const & group : instanceGroups)
+		{
+			unsigned int const first = glm::max(begin, group.offset);
+			unsigned int const last = glm::min(end, group.offset + (unsigned int)group.modelMatrices.size());
+			if (first >= last)
+				continue;
+
+			unsigned int const lod = (unsigned int)glm::clamp((int)group.lod + m_lodBias, 0, (int)group.mesh->GetLevelCount() - 1);
+			for (unsigned int i = first; i < last; ++i)
+			{
+				glm::mat4 const & modelMatrix = group.modelMatrices[i - group.offset];
+				float const scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+				LocalCaster & caster = m_localCasters[i];
+				caster.center = glm::vec3(modelMatrix * glm::vec4(group.mesh->GetBoundingSphereCenter(), 1.0f));
+				caster.radius = group.mesh->GetBoundingSphereRadius() * scale;
+				caster.cell = caster.radius > cellSize ? g_largeCasterCell : GetCellKey(glm::ivec3(glm::floor(caster.center / cellSize)));
+
+				caster.hash = 14695981039346656037ull;
+				HashBytes(caster.hash, &group.mesh, sizeof(Mesh const *));
+				HashBytes(caster.hash, &lod, sizeof(unsigned int));
+				HashBytes(caster.hash, &modelMatrix, sizeof(glm::mat4));
+			}
+		}
+	});
+
+	std::sort(m_localCasters.begin(), m_localCasters.end(), [](LocalCaster const & a, LocalCaster const & b) { return a.cell < b.cell; });
+	for (unsigned int i = 0; i < m_localCasters.size(); ++i)
+	{
+		auto const cell = m_localCasterCells.insert(std::make_pair(m_localCasters[i].cell, glm::uvec2(i, i))).first;
+		cell->second.y = i + 1;
+	}
+}
+
+void ShadowPass::PublishLocalShadows(std::vector<struct LocalLightInformation> & localLights, std::vector<std::pair<LocalLight const *, unsigned int>> const & shadowedLocalLights) const
+{
+	m_localShadowBuffer.m_buffer.clear();
+	for (auto const & lightPair : shadowedLocalLights)
+	{
+		localLights[lightPair.second].shadowIndex = -1;
+
+		auto const localShadow = m_localShadows.find(lightPair.first->GetSlot());
+		if (localShadow == m_localShadows.end() || !localShadow->second.complete)
+			continue;
+
+		LocalShadowInformation information;
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			ShadowAtlas::Tile const & tile = localShadow->second.tiles[i];
+			information.matrices[i] = localShadow->second.faceMatrices[i];
+			information.tiles[i] = glm::vec4((float)tile.x / SHADOW_ATLAS_SIZE, (float)tile.y / SHADOW_ATLAS_SIZE, (float)tile.size / SHADOW_ATLAS_SIZE, 0.0f);
+		}
+
+		localLights[lightPair.second].shadowIndex = (int)m_localShadowBuffer.m_buffer.size();
+		m_localShadowBuffer.m_buffer.push_back(information);
+	}
+
+	m_localShadowBuffer.Upload();
+}
+
+void ShadowPass::GatherCasters(std::vector<struct InstanceGroup> const & instanceGroups) const
+{
+	//groups are laid out one after the other in the instance buffer, each worker tests a range of instances against every view
+	unsigned int instancesCount = 0;
+	for (auto const & group : instanceGroups)
+		instancesCount += group.modelMatrices.size();
+
+	m_casterChunks.resize(JobSystem::GetChunksCount(instancesCount, SHADOW_CASTERS_PER_CHUNK));
+	JobSystem::ParallelFor(instancesCount, SHADOW_CASTERS_PER_CHUNK, [this, &instanceGroups](unsigned int chunk, unsigned int begin, unsigned int end)
+	{
+		CasterChunk & casters = m_casterChunks[chunk];
+		casters.casters.clear();
+		casters.batches.clear();
+		casters.signatures.assign(m_views.size(), 0);
+		casters.culledCount = 0;
+
+		for (auto const & group : instanceGroups)
+		{
+			unsigned int const first = glm::max(begin, group.offset);
+			unsigned int const last = glm::min(end, group.offset + (unsigned int)group.modelMatrices.size());
+			if (first >= last)
+				continue;
+
+			//shadow casters use a coarser level of detail than the camera view
+			unsigned int const lod = (unsigned int)glm::clamp((int)group.lod + m_lodBias, 0, (int)group.mesh->GetLevelCount() - 1);
+			CasterBatch batch = { group.mesh, lod, (unsigned int)casters.casters.size(), 0 };
+
+			for (unsigned int i = first; i < last; ++i)
+			{
+				glm::mat4 const & modelMatrix = group.modelMatrices[i - group.offset];
+				float const scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+				float const radius = group.mesh->GetBoundingSphereRadius() * scale;
+				glm::vec4 const worldCenter = modelMatrix * glm::vec4(group.mesh->GetBoundingSphereCenter(), 1.0f);
+
+				for (unsigned int j = 0; j < m_views.size(); ++j)
+				{
+					ShadowView const & cascade = m_views[j];
+					glm::vec3 const center = glm::vec3(cascade.viewMatrix * worldCenter);
+
+					if (cascade.localLight)
+					{
+						//test the bounding sphere against the light sphere and the four side planes of the face frustum
+						float const slack = radius * glm::root_two<float>();
+						if (glm::length(center) > cascade.halfSize + radius || -center.z + center.x < -slack || -center.z - center.x < -slack || -center.z + center.y < -slack || -center.z - center.y < -slack)
+						{
+							casters.culledCount++;
+							continue;
+						}
+					}
+					//test the bounding sphere against the box of the cascade, extended towards the light
+					else if (glm::abs(center.x - cascade.center.x) > cascade.halfSize + radius ||
+						glm::abs(center.y - cascade.center.y) > cascade.halfSize + radius ||
+						center.z < cascade.center.z - cascade.halfSize - radius ||
+						center.z > cascade.center.z + cascade.halfSize + cascade.extent + radius)
+					{
+						casters.culledCount++;
+						continue;
+					}
+
+					//casters moving, appearing, disappearing or switching level of detail all change the signature, the chunk they were found in does not
+					unsigned long long hash = 14695981039346656037ull;
+					HashBytes(hash, &batch.mesh, sizeof(Mesh const *));
+					HashBytes(hash, &batch.lod, sizeof(unsigned int));
+					HashBytes(hash, &modelMatrix, sizeof(glm::mat4));
+					casters.signatures[j] += hash;
+
+					casters.casters.push_back(glm::uvec2(i, j));
+					batch.count++;
+				}
+			}
+
+			if (batch.count)
+				casters.batches.push_back(batch);
+		}
+	});
+
+	//chunks are merged in order, a group split between two chunks is joined back into one batch
+	std::vector<unsigned long long> signatures(m_views.size(), 0);
+	for (auto const & casters : m_casterChunks)
+	{
+		unsigned int const offset = m_casterBuffer.m_buffer.size();
+		m_casterBuffer.m_buffer.insert(m_casterBuffer.m_buffer.end(), casters.casters.begin(), casters.casters.end());
+
+		for (auto batch : casters.batches)
+		{
+			batch.offset += offset;
+			CasterBatch * previous = m_casterBatches.empty() ? nullptr : &m_casterBatches.back();
+			if (previous && previous->mesh == batch.mesh && previous->lod == batch.lod && previous->offset + previous->count == batch.offset)
+				previous->count += batch.count;
+			else
+				m_casterBatches.push_back(batch);
+		}
+
+		for (unsigned int j = 0; j < m_views.size(); ++j)
+			signatures[j] += casters.signatures[j];
+		m_culledCastersCount += casters.culledCount;
+	}
+
+	for (unsigned int j = 0; j < m_views.size(); ++j)
+		HashBytes(m_views[j].signature, &signatures[j], sizeof(unsigned long long));
+}
+
+void ShadowPass::DiscardCleanCasters() const
+{
+	//cascades served from the cache need neither clearing nor drawing
+	unsigned int write = 0;
+	for (auto & batch : m_casterBatches)
+	{
+		unsigned int const offset = write;
+		for (unsigned int i = batch.offset; i < batch.offset + batch.count; ++i)
+			if (m_views[m_casterBuffer.m_buffer[i].y].dirty)
+				m_casterBuffer.m_buffer[write++] = m_casterBuffer.m_buffer[i];
+
+		batch.offset = offset;
+		batch.count = write - offset;
+	}
+
+	m_casterBuffer.m_buffer.resize(write);
+	m_casterBatches.erase(std::remove_if(m_casterBatches.begin(), m_casterBatches.end(), [](CasterBatch const & batch) { return batch.count == 0; }), m_casterBatches.end());
+}
+
+void ShadowPass::FilterMoments() const
+{
+	//convert the depth of every re-rendered cascade into moments, four depth texels per moments texel
+	m_momentsProgram.Use();
+	m_momentsProgram.SetUniform("uExponents", m_momentsExponents);
+	m_atlasView.Bind();
+	glBindImageTexture(0, m_momentsAtlas.GetHandle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+	for (auto const & view : m_views)
+	{
+		if (!view.dirty || view.localLight)
+			continue;
+
+		unsigned int const size = view.tile.size / 2;
+		m_momentsProgram.SetUniform("uTile", glm::vec4(view.tile.x / 2, view.tile.y / 2, size, 0));
+		glDispatchCompute((size + 15) / 16, (size + 15) / 16, 1);
+	}
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	//separable gaussian, rows into the scratch texture and columns back into the atlas, 128 texels of a line per group
+	int const radius = glm::clamp(m_blurRadius, 0, MAX_SHADOW_BLUR_RADIUS);
+	if (radius)
+	{
+		m_blurProgram.Use();
+		m_blurProgram.SetUniform("uRadius", radius);
+
+		for (unsigned int pass = 0; pass < 2; ++pass)
+		{
+			glBindImageTexture(0, pass ? m_blurTarget.GetHandle() : m_momentsAtlas.GetHandle(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+			glBindImageTexture(1, pass ? m_momentsAtlas.GetHandle() : m_blurTarget.GetHandle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+			m_blurProgram.SetUniform("uDirection", pass ? glm::vec2(0, 1) : glm::vec2(1, 0));
+
+			for (auto const & view : m_views)
+			{
+				if (!view.dirty || view.localLight)
+					continue;
+
+				unsigned int const size = view.tile.size / 2;
+				m_blurProgram.SetUniform("uTile", glm::vec4(view.tile.x / 2, view.tile.y / 2, size, 0));
+				glDispatchCompute((size + 127) / 128, size, 1);
+			}
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+	}
+
+	//the lighting pass reads the moments through mip mapped, anisotropic filtering
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	m_momentsAtlas.GenerateMipmaps();
 }
 
 #pragma endregion
@@ -97,4 +982,49 @@ unsigned int const & ShadowPass::GetNumberOfProcessedLights() const
 	return 0;
 }
 
+unsigned int const & ShadowPass::GetDrawCallsCount() const
+{
+	return m_drawCallsCount;
+}
+
+unsigned int const & ShadowPass::GetTrianglesCount() const
+{
+	return m_trianglesCount;
+}
+
+unsigned int const & ShadowPass::GetCulledCastersCount() const
+{
+	return m_culledCastersCount;
+}
+
+unsigned int const & ShadowPass::GetRenderedCascadesCount() const
+{
+	return m_renderedCascadesCount;
+}
+
+unsigned int const & ShadowPass::GetCascadesCount() const
+{
+	return m_cascadesCount;
+}
+
+unsigned int const & ShadowPass::GetShadowedLocalLightsCount() const
+{
+	return m_shadowedLocalLightsCount;
+}
+
+unsigned int const & ShadowPass::GetDroppedLocalLightsCount() const
+{
+	return m_droppedLocalLightsCount;
+}
+
+unsigned int const & ShadowPass::GetRenderedFacesCount() const
+{
+	return m_renderedFacesCount;
+}
+
+unsigned int const & ShadowPass::GetPendingFacesCount() const
+{
+	return m_pendingFacesCount;
+}
+
 #pragma endregion
\ No newline at end of file
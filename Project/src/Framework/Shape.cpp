@@ -2,65 +2,74 @@
 
 #include <GL/glew.h>
 
+#include <Framework/StateCache.h>
+
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <map>
+#include <algorithm>
 
 #pragma region "Constructor/Destructor"
 
 Shape::Shape(std::vector<struct Vertex> const & vertices, std::vector<struct Point> const & indices) : m_vao(0), m_vbo(0), m_ibo(0), m_indexCount(indices.size()), m_primitiveType(POINTS)
 {
 	CreateHandles();
-	glBindVertexArray(m_vao);
+	StateCache::BindVertexArray(m_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(struct Vertex)*vertices.size(), &vertices[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct Vertex), 0);
+	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(struct Point)*indices.size(), &indices[0], GL_STATIC_DRAW);
-	glBindVertexArray(0);
+	StateCache::BindVertexArray(0);
 }
 Shape::Shape(std::vector<struct Vertex> const & vertices, std::vector<struct Line> const & indices) : m_vao(0), m_vbo(0), m_ibo(0), m_indexCount(indices.size()*2), m_primitiveType(LINES)
 {
 	CreateHandles();
-	glBindVertexArray(m_vao);
+	StateCache::BindVertexArray(m_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(struct Vertex)*vertices.size(), &vertices[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct Vertex), 0);
+	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(struct Line)*indices.size(), &indices[0], GL_STATIC_DRAW);
-	glBindVertexArray(0);
+	StateCache::BindVertexArray(0);
 }
 Shape::Shape(std::vector<struct Vertex> const & vertices, std::vector<struct LineLoop> const & indices) : m_vao(0), m_vbo(0), m_ibo(0), m_indexCount(indices.size()), m_primitiveType(LINE_LOOP)
 {
 	CreateHandles();
-	glBindVertexArray(m_vao);
+	StateCache::BindVertexArray(m_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(struct Vertex)*vertices.size(), &vertices[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct Vertex), 0);
+	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(struct LineLoop) * indices.size(), &indices[0], GL_STATIC_DRAW);
-	glBindVertexArray(0);
+	StateCache::BindVertexArray(0);
 }
 Shape::Shape(std::vector<struct Vertex> const & vertices, std::vector<struct Triangle> const & indices) : m_vao(0), m_vbo(0), m_ibo(0), m_indexCount(indices.size()*3), m_primitiveType(TRIANGLES)
 {
 	CreateHandles();
-	glBindVertexArray(m_vao);
+	StateCache::BindVertexArray(m_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(struct Vertex)*vertices.size(), &vertices[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct Vertex), 0);
+	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(struct Triangle)*indices.size(), &indices[0], GL_STATIC_DRAW);
-	glBindVertexArray(0);
+	StateCache::BindVertexArray(0);
 }
 Shape::Shape(std::vector<struct Vertex> const & vertices, std::vector<struct Quad> const & indices) : m_vao(0), m_vbo(0), m_ibo(0), m_indexCount(indices.size()*4), m_primitiveType(QUADS)
 {
 	CreateHandles();
-	glBindVertexArray(m_vao);
+	StateCache::BindVertexArray(m_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(struct Vertex)*vertices.size(), &vertices[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct Vertex), 0);
+	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(struct Quad)*indices.size(), &indices[0], GL_STATIC_DRAW);
-	glBindVertexArray(0);
+	StateCache::BindVertexArray(0);
 }
 
 Shape::~Shape()
@@ -74,6 +83,7 @@ Shape::~Shape()
 
 static Shape * g_fsq = nullptr;
 static Shape * g_icosahedron = nullptr;
+static Shape * g_sphere = nullptr;
 static Shape * g_wireCircle = nullptr;
 
 Shape * Shape::GetFullScreenQuad()
@@ -90,6 +100,13 @@ Shape * Shape::GetIcosahedron()
 	return g_icosahedron;
 }
 
+Shape * Shape::GetSphere()
+{
+	if (!g_sphere)
+		GenerateSphere(g_sphere);
+	return g_sphere;
+}
+
 Shape * Shape::GetWireCircle()
 {
 	if (!g_wireCircle)
@@ -164,6 +181,76 @@ void Shape::GenerateIcosahedron(Shape * & shape)
 	shape = new Shape(std::vector<struct Vertex>(vertices, vertices + 12), std::vector<struct Triangle>(faces, faces + 20));
 }
 
+void Shape::GenerateSphere(Shape * & shape)
+{
+	float const t = (1.0f + sqrt(5.0f)) / 2.0f;
+	float const length = sqrt(1.0f + t * t);
+	float const a = 1.0f / length;
+	float const b = t / length;
+
+	std::vector<struct Vertex> vertices = {
+		{ -a, b, 0.0f }, { a, b, 0.0f }, { -a, -b, 0.0f }, { a, -b, 0.0f },
+		{ 0.0f, -a, b }, { 0.0f, a, b }, { 0.0f, -a, -b }, { 0.0f, a, -b },
+		{ b, 0.0f, -a }, { b, 0.0f, a }, { -b, 0.0f, -a }, { -b, 0.0f, a }
+	};
+
+	std::vector<struct Triangle> const icosahedron = {
+		{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+		{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+		{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+		{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+	};
+
+	//split every face into four, the new vertices are pushed onto the unit sphere
+	std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints;
+	auto midpoint = [&](unsigned int i, unsigned int j)
+	{
+		std::pair<unsigned int, unsigned int> const key(std::min(i, j), std::max(i, j));
+		auto const found = midpoints.find(key);
+		if (found != midpoints.end())
+			return found->second;
+
+		struct Vertex v = { vertices[i].x + vertices[j].x, vertices[i].y + vertices[j].y, vertices[i].z + vertices[j].z };
+		float const norm = sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+		vertices.push_back({ v.x / norm, v.y / norm, v.z / norm });
+		return midpoints[key] = vertices.size() - 1;
+	};
+
+	std::vector<struct Triangle> faces;
+	for (auto const & face : icosahedron)
+	{
+		unsigned int const ab = midpoint(face.a, face.b);
+		unsigned int const bc = midpoint(face.b, face.c);
+		unsigned int const ca = midpoint(face.c, face.a);
+		faces.push_back({ face.a, ab, ca });
+		faces.push_back({ face.b, bc, ab });
+		faces.push_back({ face.c, ca, bc });
+		faces.push_back({ ab, bc, ca });
+	}
+
+	//scale until the closest face touches the unit sphere, so the shape encloses it as tightly as possible
+	float inradius = 1.0f;
+	for (auto const & face : faces)
+	{
+		struct Vertex const & p = vertices[face.a];
+		struct Vertex const & q = vertices[face.b];
+		struct Vertex const & r = vertices[face.c];
+		float const nx = (q.y - p.y) * (r.z - p.z) - (q.z - p.z) * (r.y - p.y);
+		float const ny = (q.z - p.z) * (r.x - p.x) - (q.x - p.x) * (r.z - p.z);
+		float const nz = (q.x - p.x) * (r.y - p.y) - (q.y - p.y) * (r.x - p.x);
+		inradius = std::min(inradius, fabs(nx * p.x + ny * p.y + nz * p.z) / sqrt(nx * nx + ny * ny + nz * nz));
+	}
+
+	for (auto & vertex : vertices)
+	{
+		vertex.x /= inradius;
+		vertex.y /= inradius;
+		vertex.z /= inradius;
+	}
+
+	shape = new Shape(vertices, faces);
+}
+
 void Shape::GenerateWireCircle(Shape * & shape)
 {
 	int const slices = 25;
@@ -187,6 +274,8 @@ void Shape::FreeMemory()
 		delete g_fsq;
 	if (g_icosahedron)
 		delete g_icosahedron;
+	if (g_sphere)
+		delete g_sphere;
 	if (g_wireCircle)
 		delete g_wireCircle;
 }
@@ -225,6 +314,7 @@ void Shape::DestroyHandles()
 {
 	glDeleteBuffers(1, &m_ibo);
 	glDeleteBuffers(1, &m_vbo);
+	StateCache::ForgetVertexArray(m_vao);
 	glDeleteVertexArrays(1, &m_vao);
 }
 
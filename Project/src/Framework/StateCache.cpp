@@ -0,0 +1,202 @@
+#include <Framework/StateCache.h>
+#include <GL/glew.h>
+
+#include <unordered_map>
+
+//the shadowed state starts out unknown, so the first call of every kind reaches the driver
+static unsigned int const g_unknown = 0xFFFFFFFF;
+
+static struct State
+{
+	unsigned int program = g_unknown;
+	unsigned int vao = g_unknown;
+	unsigned int readFramebuffer = g_unknown;
+	unsigned int drawFramebuffer = g_unknown;
+	unsigned int activeUnit = g_unknown;
+	unsigned int depthFunc = g_unknown;
+	unsigned int cullFace = g_unknown;
+	unsigned int depthMask = g_unknown;
+	std::unordered_map<unsigned int, unsigned int> textures;
+	std::unordered_map<unsigned int, bool> capabilities;
+	unsigned int issuedCalls = 0;
+	unsigned int filteredCalls = 0;
+} g_state;
+
+static bool Filter(unsigned int & shadowed, unsigned int const & value)
+{
+	if (shadowed == value)
+	{
+		g_state.filteredCalls++;
+		return true;
+	}
+
+	shadowed = value;
+	g_state.issuedCalls++;
+	return false;
+}
+
+#pragma region "Static Methods"
+
+void StateCache::UseProgram(unsigned int const & program)
+{
+	if (!Filter(g_state.program, program))
+		glUseProgram(program);
+}
+
+void StateCache::BindVertexArray(unsigned int const & vao)
+{
+	if (!Filter(g_state.vao, vao))
+		glBindVertexArray(vao);
+}
+
+void StateCache::BindTexture(unsigned int const & unit, unsigned int const & texture)
+{
+	auto bound = g_state.textures.find(unit);
+	if (bound != g_state.textures.end() && bound->second == texture)
+	{
+		g_state.filteredCalls++;
+		return;
+	}
+
+	if (!Filter(g_state.activeUnit, unit))
+		glActiveTexture(unit);
+
+	g_state.textures[unit] = texture;
+	g_state.issuedCalls++;
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void StateCache::SelectTexture(unsigned int const & unit, unsigned int const & texture)
+{
+	//texture parameters and uploads go to the active unit, so it has to be the texture's own
+	if (!Filter(g_state.activeUnit, unit))
+		glActiveTexture(unit);
+
+	BindTexture(unit, texture);
+}
+
+void StateCache::BindFramebuffer(unsigned int const & framebuffer)
+{
+	//binding both targets at once is only filtered when both already hold the framebuffer
+	if (g_state.readFramebuffer == framebuffer && g_state.drawFramebuffer == framebuffer)
+	{
+		g_state.filteredCalls++;
+		return;
+	}
+
+	g_state.readFramebuffer = g_state.drawFramebuffer = framebuffer;
+	g_state.issuedCalls++;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void StateCache::BindReadFramebuffer(unsigned int const & framebuffer)
+{
+	if (!Filter(g_state.readFramebuffer, framebuffer))
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+}
+
+void StateCache::BindDrawFramebuffer(unsigned int const & framebuffer)
+{
+	if (!Filter(g_state.drawFramebuffer, framebuffer))
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+}
+
+void StateCache::Enable(unsigned int const & capability)
+{
+	auto enabled = g_state.capabilities.find(capability);
+	if (enabled != g_state.capabilities.end() && enabled->second)
+	{
+		g_state.filteredCalls++;
+		return;
+	}
+
+	g_state.capabilities[capability] = true;
+	g_state.issuedCalls++;
+	glEnable(capability);
+}
+
+void StateCache::Disable(unsigned int const & capability)
+{
+	auto enabled = g_state.capabilities.find(capability);
+	if (enabled != g_state.capabilities.end() && !enabled->second)
+	{
+		g_state.filteredCalls++;
+		return;
+	}
+
+	g_state.capabilities[capability] = false;
+	g_state.issuedCalls++;
+	glDisable(capability);
+}
+
+void StateCache::Disable(unsigned int const & capability, unsigned int const & index)
+{
+	//a single draw buffer leaves the capability neither on nor off, the next global call has to go through
+	g_state.capabilities.erase(capability);
+	g_state.issuedCalls++;
+	glDisablei(capability, index);
+}
+
+void StateCache::SetDepthMask(bool const & mask)
+{
+	if (!Filter(g_state.depthMask, mask ? GL_TRUE : GL_FALSE))
+		glDepthMask(mask ? GL_TRUE : GL_FALSE);
+}
+
+void StateCache::SetDepthFunc(unsigned int const & function)
+{
+	if (!Filter(g_state.depthFunc, function))
+		glDepthFunc(function);
+}
+
+void StateCache::SetCullFace(unsigned int const & face)
+{
+	if (!Filter(g_state.cullFace, face))
+		glCullFace(face);
+}
+
+void StateCache::ForgetProgram(unsigned int const & program)
+{
+	if (g_state.program == program)
+		g_state.program = g_unknown;
+}
+
+void StateCache::ForgetVertexArray(unsigned int const & vao)
+{
+	//deleting the bound vertex array binds the default one
+	if (g_state.vao == vao)
+		g_state.vao = 0;
+}
+
+void StateCache::ForgetTexture(unsigned int const & texture)
+{
+	for (auto & bound : g_state.textures)
+		if (bound.second == texture)
+			bound.second = 0;
+}
+
+void StateCache::ForgetFramebuffer(unsigned int const & framebuffer)
+{
+	if (g_state.readFramebuffer == framebuffer)
+		g_state.readFramebuffer = 0;
+	if (g_state.drawFramebuffer == framebuffer)
+		g_state.drawFramebuffer = 0;
+}
+
+void StateCache::ResetStatistics()
+{
+	g_state.issuedCalls = 0;
+	g_state.filteredCalls = 0;
+}
+
+unsigned int const & StateCache::GetIssuedCallsCount()
+{
+	return g_state.issuedCalls;
+}
+
+unsigned int const & StateCache::GetFilteredCallsCount()
+{
+	return g_state.filteredCalls;
+}
+
+#pragma endregion
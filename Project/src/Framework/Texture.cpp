@@ -1,6 +1,8 @@
 #include <Framework/Texture.h>
 #include <GL/glew.h>
 
+#include <Framework/StateCache.h>
+
 #pragma region "Constructors/Destructor"
 
 Texture::Texture(unsigned int unit, DebugCorrectionType correction) : m_handle(0), m_unit(unit), m_correction(correction), m_width(0), m_height(0)
@@ -20,27 +22,75 @@ Texture::~Texture()
 void Texture::Initialize(unsigned int width, unsigned int height, unsigned int internalFormat, unsigned int format, unsigned int type, void * pixels)
 {
 	if (m_handle)
+	{
+		StateCache::ForgetTexture(m_handle);
 		glDeleteTextures(1, &m_handle);
+	}
 
 	m_width = width;
 	m_height = height;
 
 	glGenTextures(1, &m_handle);
-	glActiveTexture(m_unit);
-	glBindTexture(GL_TEXTURE_2D, m_handle);
+	StateCache::SelectTexture(m_unit, m_handle);
 	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_width, m_height, 0, format, type, pixels);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
+void Texture::InitializeStorage(unsigned int width, unsigned int height, unsigned int internalFormat, unsigned int levels)
+{
+	if (m_handle)
+	{
+		StateCache::ForgetTexture(m_handle);
+		glDeleteTextures(1, &m_handle);
+	}
+
+	m_width = width;
+	m_height = height;
+
+	//immutable storage so regions can be exposed through texture views
+	glGenTextures(1, &m_handle);
+	StateCache::SelectTexture(m_unit, m_handle);
+	glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, m_width, m_height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void Texture::InitializeView(Texture const & source, unsigned int internalFormat)
+{
+	if (m_handle)
+	{
+		StateCache::ForgetTexture(m_handle);
+		glDeleteTextures(1, &m_handle);
+	}
+
+	m_width = source.m_width;
+	m_height = source.m_height;
+
+	//texture views need a fresh name that has never been bound
+	glGenTextures(1, &m_handle);
+	glTextureView(m_handle, GL_TEXTURE_2D, source.m_handle, internalFormat, 0, 1, 0, 1);
+	StateCache::SelectTexture(m_unit, m_handle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
 void Texture::Bind() const
 {
-	glActiveTexture(m_unit);
-	glBindTexture(GL_TEXTURE_2D, m_handle);
+	StateCache::BindTexture(m_unit, m_handle);
+}
+
+void Texture::GenerateMipmaps() const
+{
+	StateCache::SelectTexture(m_unit, m_handle);
+	glGenerateMipmap(GL_TEXTURE_2D);
 }
 
 void Texture::Free()
 {
+	StateCache::ForgetTexture(m_handle);
 	glDeleteTextures(1, &m_handle);
 	m_handle = 0;
 }
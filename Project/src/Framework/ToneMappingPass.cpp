@@ -1,8 +1,11 @@
 #include <Framework/ToneMappingPass.h>
 #include <Framework/DeferredRenderer.h>
 #include <Framework/Shape.h>
+#include <Framework/StateCache.h>
 
-ToneMappingPass::ToneMappingPass(IRenderer const * renderer) : m_renderer(renderer), m_toneMappingProgram(), m_method(REINHARD), m_gamma(2.2f), m_exposure(1.0f)
+#include <cmath>
+
+ToneMappingPass::ToneMappingPass(IRenderer const * renderer) : m_renderer(renderer), m_toneMappingProgram(), m_method(REINHARD), m_gamma(2.2f), m_exposure(1.0f), m_sharpness(0.3f), m_histogramBuffer(10, 256), m_exposureBuffer(11, 1), m_histogramProgram(), m_adaptationProgram(), m_autoExposure(true), m_exposureKey(0.18f), m_adaptationRate(1.5f), m_minLogLuminance(-10.0f), m_maxLogLuminance(6.0f), m_lastAdaptation(std::chrono::steady_clock::now())
 {
 }
 
@@ -24,34 +27,81 @@ void ToneMappingPass::Initialize()
 	m_toneMappingProgram.SetUniform("uGamma", m_gamma);
 	m_toneMappingProgram.SetUniform("uMethod", m_method);
 	m_toneMappingProgram.SetUniform("uExposure", m_exposure);
+
+	m_histogramProgram.CreateHandle();
+	m_histogramProgram.AttachShader(Program::COMPUTE_SHADER_TYPE, "src/Shaders/LuminanceHistogram.comp");
+	m_histogramProgram.Link();
+
+	m_histogramProgram.SetUniform("uFrameTexture", 6);
+
+	m_adaptationProgram.CreateHandle();
+	m_adaptationProgram.AttachShader(Program::COMPUTE_SHADER_TYPE, "src/Shaders/ExposureAdaptation.comp");
+	m_adaptationProgram.Link();
+
+	//both start out zeroed, a zero luminance makes the first frame adopt its own exposure
+	m_histogramBuffer.Initialize();
+	m_histogramBuffer.Upload();
+	m_exposureBuffer.Initialize();
+	m_exposureBuffer.Upload();
 }
 
-void ToneMappingPass::Prepare() const
+void ToneMappingPass::Prepare(glm::vec2 const & renderScale) const
 {
 	static DeferredRenderer const * renderer = dynamic_cast<DeferredRenderer const *>(m_renderer);
+
+	std::chrono::steady_clock::time_point const now = std::chrono::steady_clock::now();
+	float const elapsed = std::chrono::duration<float>(now - m_lastAdaptation).count();
+	m_lastAdaptation = now;
+
+	if (m_autoExposure)
+	{
+		float const range = glm::max(m_maxLogLuminance - m_minLogLuminance, 0.001f);
+
+		//one invocation per 2x2 block of the rendered frame
+		m_histogramProgram.Use();
+		m_histogramProgram.SetUniform("uRenderScale", renderScale);
+		m_histogramProgram.SetUniform("uMinLogLuminance", m_minLogLuminance);
+		m_histogramProgram.SetUniform("uInverseLogLuminanceRange", 1.0f / range);
+		glDispatchCompute((renderer->GetRenderWidth() + 31) / 32, (renderer->GetRenderHeight() + 31) / 32, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		//the average log luminance is approached exponentially over time
+		m_adaptationProgram.Use();
+		m_adaptationProgram.SetUniform("uMinLogLuminance", m_minLogLuminance);
+		m_adaptationProgram.SetUniform("uLogLuminanceRange", range);
+		m_adaptationProgram.SetUniform("uAdaptation", 1.0f - std::exp(-elapsed * m_adaptationRate));
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
 	renderer->BindDefaultFramebuffer();
 	glClear(GL_COLOR_BUFFER_BIT);
-	glDisable(GL_DEPTH_TEST);
+	StateCache::Disable(GL_DEPTH_TEST);
 
 	m_toneMappingProgram.Use();
 
 	m_toneMappingProgram.SetUniform("uGamma", m_gamma);
 	m_toneMappingProgram.SetUniform("uMethod", m_method);
 	m_toneMappingProgram.SetUniform("uExposure", m_exposure);
+	m_toneMappingProgram.SetUniform("uRenderScale", renderScale);
+	m_toneMappingProgram.SetUniform("uSharpness", renderScale.x < 1.0f || renderScale.y < 1.0f ? m_sharpness : 0.0f);
+	m_toneMappingProgram.SetUniform("uAutoExposure", m_autoExposure);
+	m_toneMappingProgram.SetUniform("uExposureKey", m_exposureKey);
 }
 
 void ToneMappingPass::ProcessFrame() const
 {
-	glBindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
-	glEnableVertexAttribArray(0);
+	StateCache::BindVertexArray(Shape::GetFullScreenQuad()->GetVAO());
 	glDrawElements(GL_TRIANGLES, Shape::GetFullScreenQuad()->GetIndexCount(), GL_UNSIGNED_INT, 0);
-	glDisableVertexAttribArray(0);
-	glBindVertexArray(0);
 }
 
 void ToneMappingPass::Finalize()
 {
 	m_toneMappingProgram.DestroyHandle();
+	m_histogramProgram.DestroyHandle();
+	m_adaptationProgram.DestroyHandle();
+	m_histogramBuffer.Free();
+	m_exposureBuffer.Free();
 }
 
 #pragma endregion
\ No newline at end of file
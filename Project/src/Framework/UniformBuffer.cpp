@@ -36,6 +36,14 @@ void UniformBuffer::SetUniform(std::string const & name, glm::mat4 const & matri
 void UniformBuffer::SetUniform(std::string const & name, glm::mat3 const & matrix) 
 {
 
+}
+void UniformBuffer::SetUniform(std::string const & name, glm::vec4 const & vector)
+{
+	if (m_uniforms.count(name))
+	{
+		Uniform const & uniform = m_uniforms[name];
+		CopyUniform(&vector[0], uniform.offset, MIN(uniform.size, sizeof(float) * 4));
+	}
 }
 void UniformBuffer::SetUniform(std::string const & name, glm::vec3 const & vector)
 {
@@ -47,6 +47,12 @@ void Window::MakeCurrent() const
 	wglMakeCurrent(m_device, m_context);
 }
 
+void Window::ReleaseCurrent() const
+{
+	//a context can only be deleted once no thread has it current
+	wglMakeCurrent(NULL, NULL);
+}
+
 void Window::SwapBuffers() const
 {
 	::SwapBuffers(m_device);
@@ -21,7 +21,7 @@ out vec4 fragColor;
 
 void main()
 {
-	vec2 uv = gl_FragCoord.xy / uScene.WindowSize;
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(uColor2, 0));
 
 	fragColor = vec4(uAmbientIntensity * texture(uColor2, uv).rgb, 1.0);
 }
@@ -0,0 +1,163 @@
+#version 440
+
+struct SceneInformation 
+{
+	mat4 ProjectionMatrix;
+	mat4 ViewMatrix;
+	vec2 WindowSize;
+	vec3 SceneSize;
+	vec3 EyePosition; 
+};
+
+layout(std140, binding = 0) uniform SceneBlock 
+{
+	SceneInformation uScene;
+};
+
+#define SHADOW_CASCADE_COUNT 4
+
+//std430 mirror of GlobalLightInformation
+struct LightInformation
+{
+	vec4 position;
+	vec4 intensity;
+	mat4 shadowMatrices[SHADOW_CASCADE_COUNT];
+	vec4 shadowTiles[SHADOW_CASCADE_COUNT];
+	vec4 cascadeSplits;
+};
+
+layout(std430, binding = 6) buffer GlobalLightBuffer
+{
+	LightInformation GlobalLights[];
+};
+
+uniform int uGlobalLightsCount;
+uniform vec3 uAmbientIntensity;
+
+uniform struct ShadowInformation
+{
+	sampler2DShadow map;
+	//exponential variance moments of the same tiles at half resolution, used when mode is 1
+	sampler2D moments;
+	int mode;
+	vec2 exponents;
+	float bleedingReduction;
+} uShadow;
+
+uniform sampler2D uColor0;
+uniform sampler2D uColor1;
+uniform sampler2D uColor2;
+uniform sampler2D uColor3;
+
+out vec4 fragColor;
+
+const float PI   = 3.14159265358979323846f;
+const float PI_2 = 1.57079632679489661923f;
+
+float D(vec3 N, vec3 H, float alpha)
+{
+	return ((alpha + 2.0f)/PI_2)*pow(max(dot(N,H),0.0f), alpha);
+}
+
+float G(vec3 L, vec3 H)
+{
+	return 1.0f / pow(max(dot(L,H),0.0), 2);
+}
+
+vec3 F(vec3 Ks, vec3 L, vec3 H)
+{
+	return Ks + (1.0f-Ks) * pow(1.0f - max(dot(L,H),0.0f), 5);
+}
+
+vec3 BRDF(vec3 L, vec3 N, vec3 H, vec3 Ks, vec3 Kd, float alpha)
+{
+	return (Kd / PI) + D(N, H, alpha) * F(Ks, L, H) * G(L, H) / 4.0f;
+}
+
+float Chebyshev(vec2 moments, float depth, float minVariance)
+{
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float difference = depth - moments.x;
+	float pMax = variance / (variance + difference * difference);
+
+	//cut off the tail of the upper bound that shows up as light bleeding
+	pMax = clamp((pMax - uShadow.bleedingReduction) / (1.0f - uShadow.bleedingReduction), 0.0f, 1.0f);
+	return depth <= moments.x ? 1.0f : pMax;
+}
+
+float EVSM(vec4 moments, float depth)
+{
+	//warp the depth the same way the moments were built
+	depth = 2.0f * depth - 1.0f;
+	float positive = exp(uShadow.exponents.x * depth);
+	float negative = -exp(-uShadow.exponents.y * depth);
+
+	float positiveVariance = 0.0001f * uShadow.exponents.x * positive;
+	float negativeVariance = 0.0001f * uShadow.exponents.y * negative;
+	return min(Chebyshev(moments.xy, positive, positiveVariance * positiveVariance), Chebyshev(moments.zw, negative, negativeVariance * negativeVariance));
+}
+
+void main()
+{
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(uColor0, 0));
+
+	//the g-buffer is read once for the ambient term and every global light
+	vec4 P = texture(uColor0, uv);
+	vec3 N = texture(uColor1, uv).rgb;
+	vec3 kd = texture(uColor2, uv).rgb;
+	vec4 ks = texture(uColor3, uv);
+
+	vec3 V = normalize(uScene.EyePosition - P.xyz);
+
+	//screen space derivatives have to be taken outside of the branches below
+	vec3 dPdx = dFdx(P.xyz);
+	vec3 dPdy = dFdy(P.xyz);
+
+	float viewDepth = -(uScene.ViewMatrix * vec4(P.xyz, 1)).z;
+	vec2 halfTexel = 0.5f / vec2(uShadow.mode == 1 ? textureSize(uShadow.moments, 0) : textureSize(uShadow.map, 0));
+
+	vec3 color = uAmbientIntensity * kd;
+
+	for(int i = 0; i < uGlobalLightsCount; ++i)
+	{
+		vec3 L = normalize(GlobalLights[i].position.xyz - P.xyz);
+		vec3 H = normalize(L + V);
+
+		float lambertian = max(dot(N,L),0.0f);
+		if(lambertian <= 0.0f)
+			continue;
+
+		//pick the first cascade whose far split lies beyond the pixel
+		int cascade = int(dot(vec4(greaterThan(vec4(viewDepth), GlobalLights[i].cascadeSplits)), vec4(1)));
+
+		float visibility = 1.0f;
+		//tiles have zero scale when the light casts no shadows
+		if(cascade < SHADOW_CASCADE_COUNT && GlobalLights[i].shadowTiles[cascade].z > 0)
+		{
+			mat4 shadowMatrix = GlobalLights[i].shadowMatrices[cascade];
+			vec3 shadowCoord = (shadowMatrix * vec4(P.xyz, 1)).xyz;
+
+			if((shadowCoord.x > 0 && shadowCoord.x < 1) && (shadowCoord.y > 0 && shadowCoord.y < 1))
+			{
+				//keep the filter footprint inside the tile so neighbouring tiles never bleed in
+				vec3 tile = GlobalLights[i].shadowTiles[cascade].xyz;
+				vec2 atlasCoord = clamp(tile.xy + shadowCoord.xy * tile.z, tile.xy + halfTexel, tile.xy + tile.z - halfTexel);
+
+				if(uShadow.mode == 1)
+				{
+					vec2 dx = (mat3(shadowMatrix) * dPdx).xy * tile.z;
+					vec2 dy = (mat3(shadowMatrix) * dPdy).xy * tile.z;
+					visibility = EVSM(textureGrad(uShadow.moments, atlasCoord, dx, dy), shadowCoord.z);
+				}
+				else
+				{
+					visibility = texture(uShadow.map, vec3(atlasCoord, shadowCoord.z));
+				}
+			}
+		}
+
+		color += visibility * GlobalLights[i].intensity.rgb * lambertian * BRDF(L, N, H, ks.rgb, kd, ks.w);
+	}
+
+	fragColor = vec4(color, 1);
+}
\ No newline at end of file
@@ -14,7 +14,12 @@ layout(std140, binding = 0) uniform SceneBlock
 	SceneInformation uScene;
 };
 
-uniform mat4 uModelMatrix;
+layout(std430, binding = 2) buffer InstanceBuffer
+{
+	mat4 ModelMatrices[];
+};
+
+uniform int uInstanceOffset;
 
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_normal;
@@ -31,9 +36,11 @@ out DeferredData
 
 void main()
 {
-	vec4 worldPosition = uModelMatrix * vec4(in_position, 1.0);
-	vec4 worldNormal = uModelMatrix * vec4(in_normal, 0.0);
-	vec4 worldTangent = uModelMatrix * vec4(in_tangent, 0.0);
+	mat4 modelMatrix = ModelMatrices[uInstanceOffset + gl_InstanceID];
+
+	vec4 worldPosition = modelMatrix * vec4(in_position, 1.0);
+	vec4 worldNormal = modelMatrix * vec4(in_normal, 0.0);
+	vec4 worldTangent = modelMatrix * vec4(in_tangent, 0.0);
 
 	outData.position = worldPosition.xyz;
 	outData.normal = worldNormal.xyz;
@@ -20,10 +20,19 @@ uniform struct LightInformation
 	vec3 intensity;
 } uLight;
 
+#define SHADOW_CASCADE_COUNT 4
+
 uniform struct ShadowInformation
 {
-	mat4 matrix;
-	sampler2D map;
+	mat4 matrices[SHADOW_CASCADE_COUNT];
+	vec3 tiles[SHADOW_CASCADE_COUNT];
+	vec4 splits;
+	sampler2DShadow map;
+	//exponential variance moments of the same tiles at half resolution, used when mode is 1
+	sampler2D moments;
+	int mode;
+	vec2 exponents;
+	float bleedingReduction;
 } uShadow;
 
 uniform sampler2D uColor0;
@@ -57,9 +66,32 @@ vec3 BRDF(vec3 L, vec3 N, vec3 H, vec3 Ks, vec3 Kd, float alpha)
 	return (Kd / PI) + D(N, H, alpha) * F(Ks, L, H) * G(L, H) / 4.0f;
 }
 
+float Chebyshev(vec2 moments, float depth, float minVariance)
+{
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float difference = depth - moments.x;
+	float pMax = variance / (variance + difference * difference);
+
+	//cut off the tail of the upper bound that shows up as light bleeding
+	pMax = clamp((pMax - uShadow.bleedingReduction) / (1.0f - uShadow.bleedingReduction), 0.0f, 1.0f);
+	return depth <= moments.x ? 1.0f : pMax;
+}
+
+float EVSM(vec4 moments, float depth)
+{
+	//warp the depth the same way the moments were built
+	depth = 2.0f * depth - 1.0f;
+	float positive = exp(uShadow.exponents.x * depth);
+	float negative = -exp(-uShadow.exponents.y * depth);
+
+	float positiveVariance = 0.0001f * uShadow.exponents.x * positive;
+	float negativeVariance = 0.0001f * uShadow.exponents.y * negative;
+	return min(Chebyshev(moments.xy, positive, positiveVariance * positiveVariance), Chebyshev(moments.zw, negative, negativeVariance * negativeVariance));
+}
+
 void main()
 {
-	vec2 uv = gl_FragCoord.xy / uScene.WindowSize;
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(uColor0, 0));
 
 	vec4 P = texture(uColor0, uv);
 	vec3 N = texture(uColor1, uv).rgb;
@@ -72,21 +104,41 @@ void main()
 
 	float lambertian = max(dot(N,L),0.0f);
 
-	vec4 shadowCoord = uShadow.matrix * P;
-	vec2 shadowIndex = shadowCoord.xy / shadowCoord.w;
-		
-	if(shadowCoord.w > 0 && (shadowIndex.x > 0 && shadowIndex.x < 1) && (shadowIndex.y > 0 && shadowIndex.y < 1))
-	{
-		float lightDepth = texture(uShadow.map, shadowIndex).w;
-		float pixelDepth = shadowCoord.w;
+	//screen space derivatives have to be taken outside of the branches below
+	vec3 dPdx = dFdx(P.xyz);
+	vec3 dPdy = dFdy(P.xyz);
 
-		if(lightDepth + 0.0025f > pixelDepth)
-			fragColor = vec4(uLight.intensity * lambertian * BRDF(L, N, H, ks.rgb, kd, ks.w), 1);
-		else
-			fragColor = vec4(0, 0, 0, 1);
-	}
-	else
+	//pick the first cascade whose far split lies beyond the pixel
+	float viewDepth = -(uScene.ViewMatrix * vec4(P.xyz, 1)).z;
+	int cascade = int(dot(vec4(greaterThan(vec4(viewDepth), uShadow.splits)), vec4(1)));
+
+	float visibility = 1.0f;
+	//tiles have zero scale when the light casts no shadows
+	if(cascade < SHADOW_CASCADE_COUNT && uShadow.tiles[cascade].z > 0)
 	{
-		fragColor = vec4(uLight.intensity * lambertian * BRDF(L, N, H, ks.rgb, kd, ks.w), 1);
+		vec3 shadowCoord = (uShadow.matrices[cascade] * vec4(P.xyz, 1)).xyz;
+
+		if((shadowCoord.x > 0 && shadowCoord.x < 1) && (shadowCoord.y > 0 && shadowCoord.y < 1))
+		{
+			//keep the filter footprint inside the tile so neighbouring tiles never bleed in
+			vec3 tile = uShadow.tiles[cascade];
+			vec2 halfTexel = 0.5f / vec2(uShadow.mode == 1 ? textureSize(uShadow.moments, 0) : textureSize(uShadow.map, 0));
+			vec2 atlasCoord = clamp(tile.xy + shadowCoord.xy * tile.z, tile.xy + halfTexel, tile.xy + tile.z - halfTexel);
+
+			if(uShadow.mode == 1)
+			{
+				//one trilinear, anisotropic lookup of the prefiltered moments, the gradients follow the cascade of the pixel
+				vec2 dx = (mat3(uShadow.matrices[cascade]) * dPdx).xy * tile.z;
+				vec2 dy = (mat3(uShadow.matrices[cascade]) * dPdy).xy * tile.z;
+				visibility = EVSM(textureGrad(uShadow.moments, atlasCoord, dx, dy), shadowCoord.z);
+			}
+			else
+			{
+				//hardware comparison with linear filtering gives 2x2 percentage closer filtering
+				visibility = texture(uShadow.map, vec3(atlasCoord, shadowCoord.z));
+			}
+		}
 	}
+
+	fragColor = vec4(visibility * uLight.intensity * lambertian * BRDF(L, N, H, ks.rgb, kd, ks.w), 1);
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#version 440
+
+uniform sampler2D uColor0;
+uniform sampler2D uColor1;
+uniform sampler2D uColor2;
+uniform sampler2D uColor3;
+uniform sampler2D uDepth;
+
+//full resolution pixels per reduced pixel along each axis, and the rendered part of the g-buffer
+uniform int uScale;
+uniform vec2 uRenderSize;
+
+layout(location = 0) out vec4 outColor0;
+layout(location = 1) out vec4 outColor1;
+layout(location = 2) out vec4 outColor2;
+layout(location = 3) out vec4 outColor3;
+
+void main()
+{
+	ivec2 base = ivec2(gl_FragCoord.xy) * uScale;
+	ivec2 last = ivec2(uRenderSize) - 1;
+
+	//keep the closest sample of the block so thin foreground geometry is never lost
+	ivec2 closest = min(base, last);
+	float closestDepth = texelFetch(uDepth, closest, 0).r;
+	for(int y = 0; y < uScale; ++y)
+	{
+		for(int x = 0; x < uScale; ++x)
+		{
+			ivec2 texel = min(base + ivec2(x, y), last);
+			float depth = texelFetch(uDepth, texel, 0).r;
+			if(depth < closestDepth)
+			{
+				closest = texel;
+				closestDepth = depth;
+			}
+		}
+	}
+
+	outColor0 = texelFetch(uColor0, closest, 0);
+	outColor1 = texelFetch(uColor1, closest, 0);
+	outColor2 = texelFetch(uColor2, closest, 0);
+	outColor3 = texelFetch(uColor3, closest, 0);
+	gl_FragDepth = closestDepth;
+}
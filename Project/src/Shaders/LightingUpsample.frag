@@ -0,0 +1,75 @@
+#version 440
+
+struct SceneInformation 
+{
+	mat4 ProjectionMatrix;
+	mat4 ViewMatrix;
+	vec2 WindowSize;
+	vec3 SceneSize;
+	vec3 EyePosition;
+};
+
+layout(std140, binding = 0) uniform SceneBlock 
+{
+	SceneInformation uScene;
+};
+
+uniform sampler2D uColor0;
+uniform sampler2D uColor1;
+uniform sampler2D uReducedColor0;
+uniform sampler2D uReducedColor1;
+uniform sampler2D uReducedLighting;
+
+//full resolution pixels per reduced pixel along each axis, and the rendered part of the g-buffer
+uniform int uScale;
+uniform vec2 uRenderSize;
+
+out vec4 fragColor;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec3 P = texelFetch(uColor0, texel, 0).xyz;
+	vec3 N = texelFetch(uColor1, texel, 0).xyz;
+	float depth = -(uScene.ViewMatrix * vec4(P, 1.0f)).z;
+
+	//the four reduced pixels around this one, as for bilinear filtering
+	vec2 coord = gl_FragCoord.xy / float(uScale) - 0.5f;
+	ivec2 base = ivec2(floor(coord));
+	vec2 f = coord - vec2(base);
+	ivec2 last = (ivec2(uRenderSize) + uScale - 1) / uScale - 1;
+
+	vec3 lighting = vec3(0);
+	float weights = 0.0f;
+	vec3 nearestLighting = vec3(0);
+	float nearestDifference = 1e30f;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 sampleTexel = clamp(base + offset, ivec2(0), last);
+
+		vec3 sampleP = texelFetch(uReducedColor0, sampleTexel, 0).xyz;
+		vec3 sampleN = texelFetch(uReducedColor1, sampleTexel, 0).xyz;
+		vec3 sampleLighting = texelFetch(uReducedLighting, sampleTexel, 0).rgb;
+		float difference = abs(depth + (uScene.ViewMatrix * vec4(sampleP, 1.0f)).z);
+
+		//samples across depth or orientation discontinuities lose their weight
+		float bilinear = (offset.x == 1 ? f.x : 1.0f - f.x) * (offset.y == 1 ? f.y : 1.0f - f.y);
+		float depthWeight = 1.0f / (1e-4f + difference / max(depth, 1e-4f));
+		float normalWeight = pow(max(dot(N, sampleN), 0.0f), 16.0f);
+		float weight = bilinear * depthWeight * normalWeight;
+
+		lighting += weight * sampleLighting;
+		weights += weight;
+
+		if(difference < nearestDifference)
+		{
+			nearestDifference = difference;
+			nearestLighting = sampleLighting;
+		}
+	}
+
+	//fall back to the sample closest in depth when no sample matches the surface
+	fragColor = vec4(weights > 1e-3f ? lighting / weights : nearestLighting, 1.0f);
+}
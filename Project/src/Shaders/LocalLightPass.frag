@@ -19,6 +19,7 @@ uniform struct LightInformation
 	vec3 position;
 	vec3 intensity;
 	float radius;
+	int shadowIndex;
 } uLight;
 
 layout(std140, binding = 1) buffer LightInformationBuffer
@@ -26,12 +27,29 @@ layout(std140, binding = 1) buffer LightInformationBuffer
 	LightInformation Lights[];
 };
 
+//one atlas tile per cube face, +x -x +y -y +z -z
+struct LocalShadowInformation
+{
+	mat4 matrices[6];
+	vec4 tiles[6];
+};
+
+layout(std430, binding = 5) buffer LocalShadowBuffer
+{
+	LocalShadowInformation LocalShadows[];
+};
+
 flat in int instanceId;
 
 uniform sampler2D uColor0;
 uniform sampler2D uColor1;
 uniform sampler2D uColor2;
 uniform sampler2D uColor3;
+uniform sampler2DShadow uShadowAtlas;
+
+//only every other pixel is shaded on a checkerboard that alternates every frame, the rest is taken from history
+uniform bool uCheckerboard;
+uniform int uFrameParity;
 
 out vec4 fragColor;
 
@@ -60,7 +78,11 @@ vec3 BRDF(vec3 L, vec3 N, vec3 H, vec3 Ks, vec3 Kd, float alpha)
 
 void main()
 {
-	vec2 uv = gl_FragCoord.xy / uScene.WindowSize;
+	if(uCheckerboard && ((int(gl_FragCoord.x) + int(gl_FragCoord.y) + uFrameParity) & 1) != 0)
+		discard;
+
+	//the g-buffer may be a reduced resolution copy, so the target size comes from the texture
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(uColor0, 0));
 
 	vec4 P = texture(uColor0, uv);
 	vec3 N = texture(uColor1, uv).rgb;
@@ -70,6 +92,7 @@ void main()
 	vec3 lightPosition = Lights[instanceId].position;
 	vec3 lightIntensity = Lights[instanceId].intensity;
 	float lightRadius = Lights[instanceId].radius;
+	int shadowIndex = Lights[instanceId].shadowIndex;
 
 	vec3 V = normalize(uScene.EyePosition - P.xyz);
 	vec3 L = normalize(lightPosition - P.xyz);
@@ -83,7 +106,33 @@ void main()
 	if(distanceSquared < radiusSquared)
 	{
 		float attenuation = ((radiusSquared - distanceSquared)/lightRadius);
-		fragColor =  vec4(attenuation * lightIntensity * lambertian * BRDF(L, N, H, ks.rgb, kd, ks.w), 1);
+
+		float visibility = 1.0f;
+		//lights without a complete set of faces are unshadowed
+		if(shadowIndex >= 0)
+		{
+			//the major axis of the direction from the light selects the cube face
+			vec3 axis = abs(distance);
+			int face;
+			if(axis.x >= axis.y && axis.x >= axis.z)
+				face = distance.x > 0 ? 0 : 1;
+			else if(axis.y >= axis.z)
+				face = distance.y > 0 ? 2 : 3;
+			else
+				face = distance.z > 0 ? 4 : 5;
+
+			vec4 shadowCoord = LocalShadows[shadowIndex].matrices[face] * vec4(P.xyz, 1);
+			shadowCoord.xyz /= shadowCoord.w;
+
+			//keep the filter footprint inside the tile so neighbouring tiles never bleed in
+			vec3 tile = LocalShadows[shadowIndex].tiles[face].xyz;
+			vec2 halfTexel = 0.5f / vec2(textureSize(uShadowAtlas, 0));
+			vec2 atlasCoord = clamp(tile.xy + shadowCoord.xy * tile.z, tile.xy + halfTexel, tile.xy + tile.z - halfTexel);
+
+			visibility = texture(uShadowAtlas, vec3(atlasCoord, shadowCoord.z));
+		}
+
+		fragColor =  vec4(visibility * attenuation * lightIntensity * lambertian * BRDF(L, N, H, ks.rgb, kd, ks.w), 1);
 	}
 	else
 	{
@@ -19,6 +19,7 @@ struct LightInformation
 	vec3 position;
 	vec3 intensity;
 	float radius;
+	int shadowIndex;
 };
 
 layout(std140, binding=1) buffer LightInformationBuffer
@@ -27,17 +28,58 @@ layout(std140, binding=1) buffer LightInformationBuffer
 };
 
 
+//indices of the lights that survived culling, sphere and quad proxies use separate ranges
+layout(std430, binding = 7) buffer VisibleLightBuffer
+{
+	uint VisibleLights[];
+};
+
+//first light of the draw, lights are drawn one at a time when they are stencil masked
+uniform int uLightOffset;
+//small lights are drawn as a quad around their projected sphere instead of a sphere
+uniform bool uScreenQuad;
+//instances go through the visible lights when the draw was culled on the gpu
+uniform bool uCompacted;
+
 layout(location = 0) in vec3 in_position;
 
 flat out int instanceId;
 
+vec4 ProjectSphere(vec3 center, float radius)
+{
+	//the tangents from the eye in the xz and yz planes give the tight bounds, depth is positive along the view
+	vec2 cx = vec2(center.x, -center.z);
+	vec2 cy = vec2(center.y, -center.z);
+	float tx = sqrt(dot(cx, cx) - radius * radius);
+	float ty = sqrt(dot(cy, cy) - radius * radius);
+
+	vec2 minX = mat2(tx, radius, -radius, tx) * cx;
+	vec2 maxX = mat2(tx, -radius, radius, tx) * cx;
+	vec2 minY = mat2(ty, radius, -radius, ty) * cy;
+	vec2 maxY = mat2(ty, -radius, radius, ty) * cy;
+
+	return vec4(minX.x / minX.y * uScene.ProjectionMatrix[0][0], minY.x / minY.y * uScene.ProjectionMatrix[1][1],
+				maxX.x / maxX.y * uScene.ProjectionMatrix[0][0], maxY.x / maxY.y * uScene.ProjectionMatrix[1][1]);
+}
+
 void main()
 {
-	instanceId = gl_InstanceID;
+	instanceId = uCompacted ? int(VisibleLights[uLightOffset + gl_InstanceID]) : uLightOffset + gl_InstanceID;
 
 	vec3 lightPosition = Lights[instanceId].position;
 	float lightRadius = Lights[instanceId].radius;
 
-	mat4 modelMatrix = mat4(vec4(lightRadius, 0, 0, 0), vec4(0, lightRadius, 0, 0), vec4(0, 0, lightRadius, 0), vec4(lightPosition, 1.0));
-	gl_Position = uScene.ProjectionMatrix * uScene.ViewMatrix * modelMatrix * vec4(in_position, 1.0f);
+	if(uScreenQuad)
+	{
+		//the lights drawn as quads lie entirely in front of the near plane
+		vec3 center = (uScene.ViewMatrix * vec4(lightPosition, 1.0f)).xyz;
+		vec4 bounds = ProjectSphere(center, lightRadius);
+		vec4 front = uScene.ProjectionMatrix * vec4(0, 0, center.z + lightRadius, 1.0f);
+		gl_Position = vec4(mix(bounds.xy, bounds.zw, in_position.xy * 0.5f + 0.5f), front.z / front.w, 1.0f);
+	}
+	else
+	{
+		mat4 modelMatrix = mat4(vec4(lightRadius, 0, 0, 0), vec4(0, lightRadius, 0, 0), vec4(0, 0, lightRadius, 0), vec4(lightPosition, 1.0));
+		gl_Position = uScene.ProjectionMatrix * uScene.ViewMatrix * modelMatrix * vec4(in_position, 1.0f);
+	}
 }
\ No newline at end of file
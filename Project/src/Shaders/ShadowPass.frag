@@ -1,10 +0,0 @@
-#version 440
-
-in vec4 position;
-
-layout(location = 0) out vec4 fragColor;
-
-void main()
-{
-	fragColor = vec4(position.w, position.w, position.w, position.w);
-}
\ No newline at end of file
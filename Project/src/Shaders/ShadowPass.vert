@@ -1,14 +1,41 @@
 #version 440
 
-uniform mat4 uShadowMatrix;
-uniform mat4 uModelMatrix;
+#define MAX_SHADOW_VIEWS 56
 
-layout(location = 0) in vec3 in_position;
+//tiles hold the scale (x) and offset (yz) mapping clip space onto the atlas
+layout(std140, binding = 4) uniform ShadowViewBlock
+{
+	mat4 Matrices[MAX_SHADOW_VIEWS];
+	vec4 Tiles[MAX_SHADOW_VIEWS];
+} uShadowViews;
+
+layout(std430, binding = 2) buffer InstanceBuffer
+{
+	mat4 ModelMatrices[];
+};
+
+//x: instance transform, y: shadow view
+layout(std430, binding = 3) buffer CasterBuffer
+{
+	uvec2 Casters[];
+};
 
-out vec4 position;
+uniform int uCasterOffset;
+
+layout(location = 0) in vec3 in_position;
 
 void main()
 {
-	gl_Position = uShadowMatrix * uModelMatrix * vec4(in_position, 1.0);
-	position = gl_Position;
+	uvec2 caster = Casters[uCasterOffset + gl_InstanceID];
+
+	vec4 position = uShadowViews.Matrices[caster.y] * ModelMatrices[caster.x] * vec4(in_position, 1.0);
+
+	//clip against the view before it is squeezed into its tile
+	gl_ClipDistance[0] = position.w + position.x;
+	gl_ClipDistance[1] = position.w - position.x;
+	gl_ClipDistance[2] = position.w + position.y;
+	gl_ClipDistance[3] = position.w - position.y;
+
+	vec4 tile = uShadowViews.Tiles[caster.y];
+	gl_Position = vec4(position.xy * tile.x + tile.yz * position.w, position.zw);
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#version 440
+
+struct SceneInformation 
+{
+	mat4 ProjectionMatrix;
+	mat4 ViewMatrix;
+	vec2 WindowSize;
+	vec3 SceneSize;
+	vec3 EyePosition;
+};
+
+layout(std140, binding = 0) uniform SceneBlock 
+{
+	SceneInformation uScene;
+};
+
+uniform sampler2D uColor0;
+uniform sampler2D uColor1;
+uniform sampler2D uLocalLighting;
+
+//resolved local lighting and view depth of the previous frame, and its normals
+uniform sampler2D uHistory;
+uniform sampler2D uHistoryNormals;
+uniform bool uHistoryValid;
+uniform mat4 uPreviousViewMatrix;
+uniform mat4 uPreviousProjectionMatrix;
+uniform vec2 uPreviousRenderSize;
+
+uniform vec2 uRenderSize;
+uniform int uFrameParity;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec4 outHistory;
+layout(location = 2) out vec4 outHistoryNormal;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 last = ivec2(uRenderSize) - 1;
+
+	vec3 P = texelFetch(uColor0, texel, 0).xyz;
+	vec3 N = texelFetch(uColor1, texel, 0).xyz;
+	float depth = -(uScene.ViewMatrix * vec4(P, 1.0f)).z;
+
+	vec3 result;
+	if(((texel.x + texel.y + uFrameParity) & 1) == 0)
+	{
+		//shaded this frame
+		result = texelFetch(uLocalLighting, texel, 0).rgb;
+	}
+	else
+	{
+		//the pixel was shaded last frame, look it up where the surface was then
+		vec4 previousClip = uPreviousProjectionMatrix * uPreviousViewMatrix * vec4(P, 1.0f);
+		vec2 previousUV = previousClip.xy / previousClip.w * 0.5f + 0.5f;
+		bool valid = uHistoryValid && previousClip.w > 0.0f && all(greaterThanEqual(previousUV, vec2(0))) && all(lessThan(previousUV, vec2(1)));
+
+		vec4 history = vec4(0);
+		if(valid)
+		{
+			ivec2 previousTexel = ivec2(previousUV * uPreviousRenderSize);
+			history = texelFetch(uHistory, previousTexel, 0);
+			vec3 historyNormal = texelFetch(uHistoryNormals, previousTexel, 0).xyz;
+
+			//reject history that belonged to another surface, the pixel was disoccluded
+			float previousDepth = -(uPreviousViewMatrix * vec4(P, 1.0f)).z;
+			valid = abs(history.a - previousDepth) < 0.02f * previousDepth && dot(N, historyNormal) > 0.9f;
+		}
+
+		if(valid)
+			result = history.rgb;
+		else
+		{
+			//without history the four neighbours shaded this frame fill the hole
+			result = texelFetch(uLocalLighting, clamp(texel + ivec2(1, 0), ivec2(0), last), 0).rgb
+				   + texelFetch(uLocalLighting, clamp(texel - ivec2(1, 0), ivec2(0), last), 0).rgb
+				   + texelFetch(uLocalLighting, clamp(texel + ivec2(0, 1), ivec2(0), last), 0).rgb
+				   + texelFetch(uLocalLighting, clamp(texel - ivec2(0, 1), ivec2(0), last), 0).rgb;
+			result *= 0.25f;
+		}
+	}
+
+	outColor = vec4(result, 1.0f);
+	outHistory = vec4(result, depth);
+	outHistoryNormal = vec4(N, 0.0f);
+}
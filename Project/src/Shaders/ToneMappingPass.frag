@@ -19,29 +19,63 @@ uniform float uGamma;
 uniform float uExposure;
 uniform int uMethod;
 
-out vec4 fragColor;
+//part of the frame texture covered by the rendered image, and the strength of the sharpening after upscaling
+uniform vec2 uRenderScale;
+uniform float uSharpness;
 
-void main()
+//with auto exposure the key value is divided by the luminance the histogram pass adapted to
+uniform bool uAutoExposure;
+uniform float uExposureKey;
+
+layout(std430, binding = 11) readonly buffer ExposureBuffer
 {
-	vec2 uv = gl_FragCoord.xy / uScene.WindowSize;
+	float AdaptedLuminance;
+};
 
-	vec3 hdrColor = texture(uFrameTexture, uv).rgb;
+out vec4 fragColor;
 
+vec3 ToneMap(vec3 hdrColor)
+{
 	vec3 mapped = vec3(0, 0, 0);
+	float exposure = uAutoExposure ? uExposureKey / max(AdaptedLuminance, 1e-4f) : uExposure;
 	
 	//apply tone-mapping
 	if(uMethod == 0)
 	{
+		if(uAutoExposure)
+			hdrColor *= exposure;
+
 		mapped = hdrColor * uExposure/(1.0 + hdrColor / uExposure);
 		mapped = hdrColor / (hdrColor + vec3(1.0));
 	}
 	else if(uMethod == 1)
 	{
-		mapped = vec3(1.0) - exp(-hdrColor * uExposure);
+		mapped = vec3(1.0) - exp(-hdrColor * exposure);
 	}
 
 	//apply gamma correction
-	mapped = pow(mapped, vec3(1.0/uGamma));
+	return pow(mapped, vec3(1.0/uGamma));
+}
+
+void main()
+{
+	//bilinear upscale of the rendered corner, never filtering in texels outside of it
+	vec2 texelSize = 1.0f / vec2(textureSize(uFrameTexture, 0));
+	vec2 minimum = 0.5f * texelSize;
+	vec2 maximum = uRenderScale - 0.5f * texelSize;
+	vec2 uv = clamp(gl_FragCoord.xy / uScene.WindowSize * uRenderScale, minimum, maximum);
+
+	vec3 mapped = ToneMap(texture(uFrameTexture, uv).rgb);
+
+	//unsharp mask on the tone mapped neighbours restores some of the detail lost in upscaling
+	if(uSharpness > 0.0f)
+	{
+		vec3 neighbours = ToneMap(texture(uFrameTexture, clamp(uv + vec2(texelSize.x, 0), minimum, maximum)).rgb)
+						+ ToneMap(texture(uFrameTexture, clamp(uv - vec2(texelSize.x, 0), minimum, maximum)).rgb)
+						+ ToneMap(texture(uFrameTexture, clamp(uv + vec2(0, texelSize.y), minimum, maximum)).rgb)
+						+ ToneMap(texture(uFrameTexture, clamp(uv - vec2(0, texelSize.y), minimum, maximum)).rgb);
+		mapped = max(mapped + uSharpness * (mapped - 0.25f * neighbours), vec3(0));
+	}
 
 	fragColor = vec4(mapped, 1.0);
 }
\ No newline at end of file